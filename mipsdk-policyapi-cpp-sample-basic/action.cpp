@@ -30,6 +30,9 @@
 #include "mip/mip_context.h"
 #include "mip/common_types.h"
 #include "mip/upe/action.h"
+#include "mip/upe/add_content_footer_action.h"
+#include "mip/upe/add_content_header_action.h"
+#include "mip/upe/add_watermark_action.h"
 #include "mip/upe/protect_by_template_action.h"
 #include "mip/upe/execution_state.h"
 #include "mip/upe/policy_engine.h"
@@ -38,19 +41,65 @@
 
 
 #include "auth_delegate_impl.h"
+#include "content_hash.h"
+#include "logger_delegate_impl.h"
 #include "profile_observer_impl.h"
+#include "request_arena.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <future>
+#include <memory_resource>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
 
 using std::cout;
 using std::cin;
 using std::endl;
 
+using mip::LogLevel;
 using mip::PolicyProfile;
 using mip::PolicyEngine;
 
+namespace {
+	// Per-label bookkeeping not covered by its strings: the label object, its control block and vector slots.
+	const size_t kLabelOverheadBytes = 256;
+
+	// A ComputeActions call with a deadline, shared by the caller and the pool task running it.
+	struct TimedCompute {
+		enum State { Pending, Finished, Abandoned };
+
+		explicit TimedCompute(const sample::policy::ExecutionStateOptions& options) : options(options) {}
+
+		sample::policy::ExecutionStateOptions options;	// The task builds its execution state from these on its own thread
+		std::promise<std::vector<std::shared_ptr<mip::Action>>> promise;
+		std::atomic<int> state{ Pending };
+	};
+
+	// The SDK allocates its labels itself, so their size is estimated from what they hold.
+	size_t EstimateLabelBytes(const std::vector<std::shared_ptr<mip::Label>>& labels)
+	{
+		size_t bytes = 0;
+		for (const auto& label : labels)
+		{
+			bytes += kLabelOverheadBytes + label->GetId().capacity() + label->GetName().capacity() +
+				label->GetDescription().capacity() + label->GetColor().capacity() + label->GetTooltip().capacity();
+			for (const auto& setting : label->GetCustomSettings())
+			{
+				bytes += sizeof(setting) + setting.first.capacity() + setting.second.capacity();
+			}
+			bytes += EstimateLabelBytes(label->GetChildren());
+		}
+		return bytes;
+	}
+}
+
 namespace sample {
 	namespace policy {
 
@@ -60,19 +109,123 @@ namespace sample {
 			const std::string& username,
 			const std::string& password,
 			const bool generateAuditEvents)
-			: mAppInfo(appInfo),
+			: Action(appInfo, username, password, ActionOptions())
+		{
+			mOptions.generateAuditEvents = generateAuditEvents;
+		}
+
+		Action::Action(const mip::ApplicationInfo appInfo,
+			const std::string& username,
+			const std::string& password,
+			const ActionOptions& options)
+			: mEngineMemory(std::make_shared<utils::MemoryAccount>()),
+			mLocalPolicyMemory(std::make_shared<utils::MemoryAccount>()),
+			mNoOpMemory(std::make_shared<utils::MemoryAccount>()),
+			mClassificationMemory(std::make_shared<utils::MemoryAccount>()),
+			mAppInfo(appInfo),
+			mOptions(options),
 			mUsername(username),
-			mPassword(password),
-			mGenerateAuditEvents(generateAuditEvents) {
-			mAuthDelegate = std::make_shared<sample::auth::AuthDelegateImpl>(mAppInfo, mUsername, mPassword);
+			mPassword(password)
+		{
+			if (!mOptions.cancellation)
+			{
+				mOptions.cancellation = std::make_shared<utils::CancellationToken>();
+			}
+			mAuthDelegate = std::make_shared<sample::auth::AuthDelegateImpl>(mAppInfo, mUsername, mPassword, mOptions.tokenTimeout, mOptions.cancellation, mOptions.tracer);
+
+			mLog = mOptions.logSink;
+			if (!mLog)
+			{
+				utils::AsyncLogSink::Settings logSettings;
+				logSettings.level = mOptions.logLevel;
+				logSettings.filePath = mOptions.logFilePath;
+				mLog = std::make_shared<utils::AsyncLogSink>(logSettings);
+			}
+
+			if (!mOptions.justificationProvider)
+			{
+				mOptions.justificationProvider = std::make_shared<InteractiveJustificationProvider>(mLog);
+			}
+
+			if (!mOptions.classifierRulesPath.empty())
+			{
+				mClassifier = Classifier::LoadFromFile(mOptions.classifierRulesPath);
+				if (!mOptions.classificationCachePath.empty())
+				{
+					mClassificationCache = std::make_shared<ClassificationCache>(mOptions.classificationCachePath, mClassificationMemory);
+				}
+				mContentScanner = std::make_shared<ContentScanner>(mOptions.contentScanSettings, mClassificationCache);
+			}
+
+			if (!mOptions.labelPropertiesPath.empty())
+			{
+				mLabelProperties = LabelPropertyTable::LoadFromFile(mOptions.labelPropertiesPath);
+			}
+
+			// A snapshot from a previous run lets label lookups be answered before the engine is loaded.
+			if (!mOptions.labelSnapshotPath.empty())
+			{
+				mLabelSnapshot = LabelSnapshot::Open(mOptions.labelSnapshotPath, GetSnapshotOwner(), mOptions.labelSnapshotMaxAge);
+			}
+
+			// Classification results can change the outcome for identical metadata, so no-ops aren't skipped with a classifier.
+			if (mOptions.skipNoOpEvaluations && !mClassifier)
+			{
+				mNoOpFilter.reset(new NoOpFilter(4096, mNoOpMemory));
+			}
+
+			// Evictable consumers go first, cheapest to rebuild first. Engines are reported but never evicted.
+			mMemoryBudget.reset(new utils::MemoryBudget(mOptions.memoryBudgetBytes, mLog));
+			mMemoryBudget->Register("No-op signatures", mNoOpMemory.get(), [this]() {
+				if (mNoOpFilter)
+				{
+					mNoOpFilter->Clear();
+				}
+			});
+			mMemoryBudget->Register("Classification results", mClassificationMemory.get(), [this]() {
+				if (mClassificationCache)
+				{
+					mClassificationCache->ReleaseMemory();
+				}
+			});
+			mMemoryBudget->Register("SDK engine labels", mEngineMemory.get());
+			mMemoryBudget->Register("Local policy labels", mLocalPolicyMemory.get());
+
+			if (mOptions.shadowVerification.sampleRate > 0)
+			{
+				mShadowVerifier.reset(new ShadowVerifier([this](const ExecutionStateOptions& stateOptions) {
+					return ComputeReferenceActions(stateOptions);
+				}, mOptions.shadowVerification, mLog));
+			}
+
+			if (mOptions.computeTimeout.count() > 0)
+			{
+				unsigned int computeThreads = mOptions.computeThreads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : mOptions.computeThreads;
+				mComputePool.reset(new utils::WorkerPool(computeThreads, computeThreads * 4));
+			}
 		}
 
 		Action::~Action()
-		{			
+		{
+			// Samples still queued are checked first, since they need the engine and context.
+			mShadowVerifier.reset();
+
+			// Calls abandoned at their deadline may still be running on the engine. Those not started yet are skipped.
+			mComputePool.reset();
+
+			// Let a background engine load finish before tearing down the context it uses.
+			if (mEngineLoad.valid() && mEngineLoad.wait_for(std::chrono::seconds(0)) != std::future_status::deferred)
+			{
+				mEngineLoad.wait();
+			}
+
 			mEngine = nullptr;
 			mProfile = nullptr;
-			mMipContext->ShutDown();
-			mMipContext = nullptr;
+			if (mMipContext)
+			{
+				mMipContext->ShutDown();
+				mMipContext = nullptr;
+			}
 		}
 
 		// Method illustrates how to create a new mip::PolicyProfile using promise/future
@@ -80,19 +233,25 @@ namespace sample {
 		void sample::policy::Action::AddNewProfile()
 		{			
 
-			// Initialize MipConfiguration.
-			std::shared_ptr<mip::MipConfiguration> mipConfiguration = std::make_shared<mip::MipConfiguration>(mAppInfo,
-				"mip_data",
-				mip::LogLevel::Trace,
-				false);
-
-			// Initialize MipContext. MipContext can be set to null at shutdown and will automatically release all resources.
-			mMipContext = mip::MipContext::Create(mipConfiguration);
+			// The context is created once. A retry after a timed out load reuses it, since the abandoned load may still be using it.
+			if (!mMipContext)
+			{
+				// Initialize MipConfiguration. SDK log messages go to the asynchronous sink rather than being written on the calling thread.
+				// A local policy makes the context offline-only so no service calls are made.
+				std::shared_ptr<mip::MipConfiguration> mipConfiguration = std::make_shared<mip::MipConfiguration>(mAppInfo,
+					mOptions.cachePath,
+					mOptions.sdkLogLevel,
+					!mOptions.policyDataXmlPath.empty());
+				mipConfiguration->SetLoggerDelegate(std::make_shared<utils::LoggerDelegateImpl>(mLog));
+
+				// Initialize MipContext. MipContext can be set to null at shutdown and will automatically release all resources.
+				mMipContext = mip::MipContext::Create(mipConfiguration);
+			}
 
 			// Initialize the Profile::Settings Object.  
 			// and permits use license caching of protected content. Accepts AuthDelegate, new Profile::Observer, and ApplicationInfo object as last parameters.
 			PolicyProfile::Settings profileSettings(mMipContext, 
-				mip::CacheStorageType::OnDiskEncrypted,  
+				mOptions.cacheStorageType,
 				std::make_shared<ProfileObserverImpl>());
 
 			// Create promise and future for mip::PolicyProfile object.
@@ -103,11 +262,35 @@ namespace sample {
 			PolicyProfile::LoadAsync(profileSettings, profilePromise);
 
 			// Get the future value and store in mProfile. mProfile is used throughout Action for profile operations.
-			mProfile = profileFuture.get();
+			// The wait is bounded by engineLoadTimeout. An abandoned load completes into a promise nobody reads.
+			mProfile = WaitForLoad(profileFuture, "Profile load");
 		}
 
 		// Action::AddNewPolicyEngine adds an engine for a specific user. 		
 		void Action::AddNewPolicyEngine()
+		{
+			utils::TraceSpan span(mOptions.tracer.get(), "LoadEngine", true);
+
+			// A local policy is evaluated in-process. There is no profile or service to wait for.
+			if (!mOptions.localPolicyPath.empty())
+			{
+				mLocalEngine = LocalPolicyEngine::Load(mOptions.localPolicyPath);
+				mLocalPolicyMemory->Allocated(EstimateLabelBytes(mLocalEngine->ListSensitivityLabels()));
+			}
+			else
+			{
+				AddNewServiceEngine();
+			}
+
+			// Lookups move to the engine first, so the snapshot mapping can be released before its file is replaced.
+			mEngineReady = true;
+			if (!mOptions.labelSnapshotPath.empty())
+			{
+				WriteLabelSnapshot();
+			}
+		}
+
+		void Action::AddNewServiceEngine()
 		{
 			// If mProfile hasn't been set, use AddNewProfile() to set it.
 			if (!mProfile)
@@ -116,7 +299,20 @@ namespace sample {
 			}
 
 			// PolicyEngine requires a PolicyEngine::Settings object. The first parameter is the user identity or engine ID. 
-			PolicyEngine::Settings engineSettings(mip::Identity(mUsername), mAuthDelegate, "", "en-US", mGenerateAuditEvents);
+			PolicyEngine::Settings engineSettings(mip::Identity(mUsername), mAuthDelegate, "", "en-US", mOptions.generateAuditEvents);
+
+			// Policy data from a local file replaces the policy fetched from the service.
+			if (!mOptions.policyDataXmlPath.empty())
+			{
+				std::ifstream policyFile(mOptions.policyDataXmlPath);
+				if (!policyFile)
+				{
+					throw std::runtime_error("Unable to open policy file " + mOptions.policyDataXmlPath);
+				}
+				std::stringstream policyData;
+				policyData << policyFile.rdbuf();
+				engineSettings.SetPolicyDataXml(policyData.str());
+			}
 
 			// Create promise and future for mip::PolicyEngine object
 			auto enginePromise = std::make_shared<std::promise<std::shared_ptr<PolicyEngine>>>();
@@ -125,30 +321,416 @@ namespace sample {
 			// Engines are added to profiles. Call AddEngineAsync on mProfile, providing settings and promise
 			// then get the future value and set in mEngine. mEngine will be used throughout Action for engine operations.
 			mProfile->AddEngineAsync(engineSettings, enginePromise);
-			mEngine = engineFuture.get();
+			mEngine = WaitForLoad(engineFuture, "Engine load");
+			mEngineMemory->Allocated(EstimateLabelBytes(mEngine->ListSensitivityLabels()));
 		}
 
+		template<typename T>
+		T Action::WaitForLoad(std::future<T>& future, const char* operation)
+		{
+			try
+			{
+				return utils::WaitForFuture(future, mOptions.engineLoadTimeout, mOptions.cancellation.get(), operation);
+			}
+			catch (const utils::TimeoutError&)
+			{
+				++mEngineLoadTimeouts;
+				throw;
+			}
+			catch (const utils::CancelledError&)
+			{
+				++mCancellations;
+				throw;
+			}
+		}
 
-		std::shared_ptr<mip::Label> Action::GetLabelById(const std::string& labelId)
+		// Starts the engine load on a background thread so the caller can keep serving lookups from the snapshot.
+		void Action::StartEngineLoad()
+		{
+			std::lock_guard<std::mutex> lock(mEngineMutex);
+			if (!mEngineLoad.valid())
+			{
+				mEngineLoad = std::async(std::launch::async, [this]() {
+					AddNewPolicyEngine();
+				}).share();
+			}
+		}
+
+		void Action::LoadEngine()
+		{
+			EnsureEngine();
+		}
+
+		// Loads the engine on the calling thread, or waits for the load started by StartEngineLoad().
+		// A failed load is rethrown to every waiter and cleared so the next call retries.
+		void Action::EnsureEngine()
+		{
+			if (mEngineReady)
+			{
+				return;
+			}
+
+			std::shared_future<void> load;
+			{
+				std::lock_guard<std::mutex> lock(mEngineMutex);
+				if (!mEngineLoad.valid())
+				{
+					mEngineLoad = std::async(std::launch::deferred, [this]() {
+						AddNewPolicyEngine();
+					}).share();
+				}
+				load = mEngineLoad;
+			}
+
+			try
+			{
+				load.get();
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(mEngineMutex);
+				mEngineLoad = std::shared_future<void>();
+				throw;
+			}
+		}
+
+		// Writes the label table to disk. A failed write only costs the next process its fast start, so it is reported and ignored.
+		void Action::WriteLabelSnapshot()
+		{
+			try
+			{
+				const std::string& policyVersion = mLocalEngine ? mLocalEngine->GetPolicyFileId() : mEngine->GetPolicyFileId();
+				// Windows can't replace a file this process still has mapped. Lookups already in progress keep their own
+				// reference and release the mapping when they finish.
+				auto previous = std::atomic_exchange(&mLabelSnapshot, std::shared_ptr<LabelSnapshot>());
+				if (previous && previous->GetPolicyVersion() != policyVersion)
+				{
+					mLog->Log(LogLevel::Info, "Label snapshot replaced: policy %s is newer than the snapshot's %.*s", policyVersion.c_str(),
+						static_cast<int>(previous->GetPolicyVersion().size()), previous->GetPolicyVersion().data());
+				}
+				previous.reset();
+				LabelSnapshot::Write(mOptions.labelSnapshotPath, GetSnapshotOwner(), policyVersion, GetEngineLabels());
+			}
+			catch (const std::exception& ex)
+			{
+				mLog->Log(LogLevel::Warning, "Unable to write label snapshot: %s", ex.what());
+			}
+		}
+
+		// Labels differ per identity, and the identity's UPN carries its tenant. A policy file is identified by its path, size
+		// and modification time, so an edited file invalidates the snapshot immediately.
+		std::string Action::GetSnapshotOwner() const
+		{
+			const std::string& policyPath = !mOptions.localPolicyPath.empty() ? mOptions.localPolicyPath : mOptions.policyDataXmlPath;
+			if (policyPath.empty())
+			{
+				return mUsername + "|service";
+			}
+
+			utils::FileIdentity identity;
+			utils::GetFileIdentity(policyPath, identity);
+			return mUsername + "|" + policyPath + "|" + std::to_string(identity.size) + "|" + std::to_string(identity.modifiedTime);
+		}
+
+		bool Action::ResolveLabel(const std::string& labelId, LabelInfo& info)
+		{
+			auto snapshot = std::atomic_load(&mLabelSnapshot);
+			if (!mEngineReady && snapshot)
+			{
+				return snapshot->FindLabel(labelId, info);
+			}
+
+			auto label = GetLabelById(labelId);
+			if (!label)
+			{
+				return false;
+			}
+
+			info.id = label->GetId();
+			info.name = label->GetName();
+			auto parent = label->GetParent().lock();
+			info.parentId = parent ? parent->GetId() : std::string();
+			info.sensitivity = label->GetSensitivity();
+			info.isActive = label->IsActive();
+			return true;
+		}
+
+		std::vector<std::shared_ptr<mip::Label>> Action::GetEngineLabels()
+		{
+			return mLocalEngine ? mLocalEngine->ListSensitivityLabels() : mEngine->ListSensitivityLabels();
+		}
+
+		std::vector<LabelInfo> Action::GetLabels()
+		{
+			auto snapshot = std::atomic_load(&mLabelSnapshot);
+			if (!mEngineReady && snapshot)
+			{
+				return snapshot->ListLabels();
+			}
+
+			EnsureEngine();
+			std::vector<LabelInfo> labels;
+			std::function<void(const std::vector<std::shared_ptr<mip::Label>>&, const std::string&)> collect =
+				[&](const std::vector<std::shared_ptr<mip::Label>>& level, const std::string& parentId) {
+				for (const auto& label : level)
+				{
+					LabelInfo info;
+					info.id = label->GetId();
+					info.name = label->GetName();
+					info.parentId = parentId;
+					info.sensitivity = label->GetSensitivity();
+					info.isActive = label->IsActive();
+					labels.push_back(std::move(info));
+					collect(label->GetChildren(), label->GetId());
+				}
+			};
+			collect(GetEngineLabels(), std::string());
+			return labels;
+		}
+
+		bool Action::IsValidLabel(const std::string& labelId)
+		{
+			LabelInfo info;
+			return ResolveLabel(labelId, info) && info.isActive;
+		}
+
+		// Builds the execution state for options, filling in Action-wide defaults the caller left unset.
+		// On the calling thread's request arena. Timed evaluations create theirs inside the compute task, so it is never
+		// held past the scope of the thread that allocated it.
+		std::shared_ptr<ExecutionStateImpl> Action::CreateExecutionState(ExecutionStateOptions stateOptions) const
+		{
+			if (!stateOptions.classifier)
+			{
+				stateOptions.classifier = mClassifier;
+			}
+			if (!stateOptions.contentScanner)
+			{
+				stateOptions.contentScanner = mContentScanner;
+			}
+			if (!stateOptions.log)
+			{
+				stateOptions.log = mLog;
+			}
+			if (!stateOptions.newLabelExtendedProperties && stateOptions.newLabel && mLabelProperties)
+			{
+				stateOptions.newLabelExtendedProperties = mLabelProperties->Resolve(*stateOptions.newLabel);
+			}
+			return std::allocate_shared<ExecutionStateImpl>(std::pmr::polymorphic_allocator<ExecutionStateImpl>(utils::GetRequestResource()),
+				std::move(stateOptions));
+		}
+
+		// Without a compute timeout the call runs inline. Otherwise it runs on mComputePool, and the task keeps the handler and
+		// state alive, so a call that misses the deadline can be abandoned and finish in the background. An abandoned call
+		// that hasn't started is skipped. While maxAbandonedComputes abandoned calls are still running, new calls fail at once
+		// rather than tie up more of the pool.
+		template<typename Handler>
+		std::vector<std::shared_ptr<mip::Action>> Action::ComputeActionsWithDeadline(const std::shared_ptr<Handler>& handler,
+			const ExecutionStateOptions& options, std::shared_ptr<ExecutionStateImpl>& state)
+		{
+			if (mOptions.cancellation->IsCancelled())
+			{
+				++mCancellations;
+				throw utils::CancelledError("ComputeActions was cancelled");
+			}
+			utils::TraceSpan span(mOptions.tracer.get(), "ComputeActions");
+			if (mOptions.computeTimeout.count() <= 0)
+			{
+				state = CreateExecutionState(options);
+				return handler->ComputeActions(*state);
+			}
+			state.reset();
+
+			if (mAbandonedComputes.load() >= mOptions.maxAbandonedComputes)
+			{
+				++mComputeRejections;
+				throw utils::TimeoutError("ComputeActions refused: earlier calls past their deadline are still running");
+			}
+
+			// The state and everything its getters allocate live on the compute thread's arena, released when the task
+			// ends, even if the caller gave up on it long before.
+			auto call = std::make_shared<TimedCompute>(options);
+			auto future = call->promise.get_future();
+			std::function<void()> task = [this, handler, call]() {
+				if (call->state.load() != TimedCompute::Abandoned)
+				{
+					try
+					{
+						utils::RequestArenaScope arena;
+						auto taskState = CreateExecutionState(std::move(call->options));
+						call->promise.set_value(handler->ComputeActions(*taskState));
+					}
+					catch (...)
+					{
+						call->promise.set_exception(std::current_exception());
+					}
+				}
+				int pending = TimedCompute::Pending;
+				if (!call->state.compare_exchange_strong(pending, TimedCompute::Finished))
+				{
+					--mAbandonedComputes;
+				}
+			};
+			if (!mComputePool->TrySubmit(task))
+			{
+				++mComputeRejections;
+				throw utils::TimeoutError("ComputeActions refused: too many calls are waiting to run");
+			}
+
+			// Counted before the state changes, so the task can't release the call before it is counted.
+			auto abandon = [this, &call]() {
+				++mAbandonedComputes;
+				int pending = TimedCompute::Pending;
+				if (!call->state.compare_exchange_strong(pending, TimedCompute::Abandoned))
+				{
+					--mAbandonedComputes;
+				}
+			};
+			try
+			{
+				return utils::WaitForFuture(future, mOptions.computeTimeout, mOptions.cancellation.get(), "ComputeActions");
+			}
+			catch (const utils::TimeoutError&)
+			{
+				abandon();
+				++mComputeTimeouts;
+				throw;
+			}
+			catch (const utils::CancelledError&)
+			{
+				abandon();
+				++mCancellations;
+				throw;
+			}
+		}
+
+		ActionStats Action::GetStats() const
+		{
+			ActionStats stats;
+			stats.engineLoadTimeouts = mEngineLoadTimeouts;
+			stats.tokenTimeouts = mAuthDelegate->GetTimeoutCount();
+			stats.computeTimeouts = mComputeTimeouts;
+			stats.computeRejections = mComputeRejections;
+			stats.cancellations = mCancellations;
+			stats.noOpSkips = mNoOpSkips;
+			if (mShadowVerifier)
+			{
+				stats.shadow = mShadowVerifier->GetStats();
+			}
+			stats.memory = mMemoryBudget->GetUsage();
+			stats.memoryEvictions = mMemoryBudget->GetEvictionCount();
+			return stats;
+		}
+
+		void Action::FlushShadowVerification()
+		{
+			if (mShadowVerifier)
+			{
+				mShadowVerifier->Flush();
+			}
+		}
+
+		std::vector<ShadowMismatch> Action::GetShadowMismatches() const
+		{
+			return mShadowVerifier ? mShadowVerifier->GetMismatches() : std::vector<ShadowMismatch>();
+		}
+
+		// The template is compiled once per label. Rendering appends its pieces to a per-thread buffer.
+		const std::string& Action::RenderMarking(std::string_view text, mip::ActionType type, const ExecutionStateOptions& options)
+		{
+			thread_local std::string rendered;
+			auto compiled = mMarkingTemplates.Get(options.newLabel ? options.newLabel->GetId() : std::string(), type, text);
+
+			std::string_view location(options.contentIdentifier);
+			auto separator = location.find_last_of("/\\");
+			std::string_view itemName = separator == std::string_view::npos ? location : location.substr(separator + 1);
+			auto dot = itemName.rfind('.');
+
+			char eventDateTime[32];
+			std::time_t now = std::time(nullptr);
+			std::tm localTime = {};
+#if defined(_WIN32) || defined(_WIN64)
+			localtime_s(&localTime, &now);
+#else
+			localtime_r(&now, &localTime);
+#endif
+			std::strftime(eventDateTime, sizeof(eventDateTime), "%Y-%m-%d %H:%M:%S", &localTime);
+
+			MarkingContext context;
+			context.labelName = options.newLabel ? std::string_view(options.newLabel->GetName()) : std::string_view();
+			context.itemName = itemName;
+			context.itemLocation = location;
+			context.userName = mUsername;
+			context.userPrincipalName = mUsername;
+			context.eventDateTime = eventDateTime;
+			context.application = dot == std::string_view::npos ? 0 : GetMarkingApplication(itemName.substr(dot));
+			compiled->Render(context, rendered);
+			return rendered;
+		}
+
+		// Skipped evaluations are a fast path, so the shadow verifier samples them too. Requests that want an audit event
+		// are always evaluated, since the event is committed through the engine's handler.
+		bool Action::SkipNoOp(const ExecutionStateOptions& options)
+		{
+			if (!mNoOpFilter || options.generateAuditEvent || !mNoOpFilter->IsNoOp(options))
+			{
+				return false;
+			}
+
+			++mNoOpSkips;
+			if (mShadowVerifier)
+			{
+				mShadowVerifier->Submit(options, std::vector<std::shared_ptr<mip::Action>>());
+			}
+			return true;
+		}
+
+		// Evaluates options with the SDK engine on the shadow verifier's thread. With a local policy the SDK engine is loaded
+		// on first use, so shadow checks add nothing to startup. No audit events are sent for these evaluations.
+		std::vector<std::shared_ptr<mip::Action>> Action::ComputeReferenceActions(const ExecutionStateOptions& options)
 		{
 			if (!mEngine)
 			{
-				AddNewPolicyEngine();
+				AddNewServiceEngine();
 			}
 
-			return mEngine->GetLabelById(labelId);
+			ExecutionStateOptions referenceOptions = options;
+			referenceOptions.generateAuditEvent = false;
+			if (referenceOptions.newLabel)
+			{
+				// Labels are engine objects. Evaluate with the SDK engine's label of the same ID.
+				referenceOptions.newLabel = mEngine->GetLabelById(options.newLabel->GetId());
+				if (!referenceOptions.newLabel)
+				{
+					throw std::runtime_error("Label " + options.newLabel->GetId() + " isn't in the SDK engine's policy");
+				}
+			}
+
+			std::shared_ptr<ExecutionStateImpl> state = CreateExecutionState(referenceOptions);
+			return mEngine->CreatePolicyHandler("")->ComputeActions(*state);
+		}
+
+		// Messages below the SDK level set in ActionOptions are never generated, so only raising the level takes full effect for the SDK.
+		void Action::SetLogLevel(mip::LogLevel level)
+		{
+			mLog->SetLevel(level);
+		}
+
+
+		std::shared_ptr<mip::Label> Action::GetLabelById(const std::string& labelId)
+		{
+			EnsureEngine();
+
+			return mLocalEngine ? mLocalEngine->GetLabelById(labelId) : mEngine->GetLabelById(labelId);
 		}
 
 		// Function recursively lists all labels available for a user to	std::cout.
 		void Action::ListLabels() {
 
-			// If mEngine hasn't been set, call AddNewPolicyEngine() to load the engine.
-			if (!mEngine) {
-				AddNewPolicyEngine();
-			}
+			// If mEngine hasn't been set, call EnsureEngine() to load the engine.
+			EnsureEngine();
 
 			// Use mip::PolicyEngine to list all labels
-			auto labels = mEngine->ListSensitivityLabels();
+			auto labels = GetEngineLabels();
 
 			// Iterate through each label, first listing details
 			for (const auto& label : labels) {
@@ -164,21 +746,74 @@ namespace sample {
 
 		std::vector<std::shared_ptr<mip::Action>> Action::ComputeAction(const ExecutionStateOptions& options)
 		{
+			utils::TraceRequest request(mOptions.tracer.get());
+			utils::RequestArenaScope arena;
+			if (mOptions.workloadRecorder)
+			{
+				mOptions.workloadRecorder->Record(options, WorkloadCall::ComputeAction);
+			}
+			// Caches grow during evaluations. Bringing them back under budget here bounds the overshoot to one request per thread.
+			mMemoryBudget->Enforce();
+
+			// The content already carries the requested label in a state the engine has accepted before.
+			if (SkipNoOp(options))
+			{
+				return std::vector<std::shared_ptr<mip::Action>>();
+			}
+
 			// If an engine hasn't been added, add it.
-			if (!mEngine)
+			EnsureEngine();
+
+			if (mLocalEngine)
+			{
+				return ComputeActionWith(CreateLocalHandler(), options);
+			}
+			return ComputeActionWith(CreateServiceHandler(), options);
+		}
+
+		std::shared_ptr<LocalPolicyHandler> Action::CreateLocalHandler()
+		{
+			utils::TraceSpan span(mOptions.tracer.get(), "CreatePolicyHandler");
+			return mLocalEngine->CreatePolicyHandler();
+		}
+
+		std::shared_ptr<mip::PolicyHandler> Action::CreateServiceHandler()
+		{
+			utils::TraceSpan span(mOptions.tracer.get(), "CreatePolicyHandler");
+			return mEngine->CreatePolicyHandler("");
+		}
+
+		// Answers from the local policy are the fast path the shadow verifier samples.
+		template<typename Handler>
+		void Action::SampleFastPath(const ExecutionStateOptions& options, const std::vector<std::shared_ptr<mip::Action>>& actions)
+		{
+			if (mShadowVerifier && std::is_same<Handler, LocalPolicyHandler>::value)
 			{
-				AddNewPolicyEngine();
+				mShadowVerifier->Submit(options, actions);
 			}
+		}
 
+		template<typename Handler>
+		std::vector<std::shared_ptr<mip::Action>> Action::ComputeActionWith(const std::shared_ptr<Handler>& handler, const ExecutionStateOptions& options)
+		{
 			// ExecutionStateImpl is derived from mip::ExecutionState
-			std::unique_ptr<ExecutionStateImpl> state;
+			std::shared_ptr<ExecutionStateImpl> state;
+			auto actions = ComputeActionsWithDeadline(handler, options, state);
 
-			state.reset(new ExecutionStateImpl(options));
-			auto handler = mEngine->CreatePolicyHandler("");
-			auto actions = handler->ComputeActions(*state);
+			SampleFastPath<Handler>(options, actions);
+
+			if (mNoOpFilter && actions.empty())
+			{
+				mNoOpFilter->RecordNoOp(options);
+			}
 
 			if (options.generateAuditEvent && actions.size() == 0)
 			{
+				utils::TraceSpan span(mOptions.tracer.get(), "NotifyCommittedActions");
+				if (!state)
+				{
+					state = CreateExecutionState(options);
+				}
 				handler->NotifyCommittedActions(*state);
 			}
 			
@@ -186,71 +821,110 @@ namespace sample {
 		}
 
 
-		bool Action::ComputeActionLoop(ExecutionStateOptions& options)
+		bool Action::ComputeActionLoop(ExecutionStateOptions& options, MetadataPatch* patch)
 		{
+			utils::TraceRequest request(mOptions.tracer.get());
+			utils::RequestArenaScope arena;
+			if (mOptions.workloadRecorder)
+			{
+				mOptions.workloadRecorder->Record(options, WorkloadCall::ComputeActionLoop);
+			}
+			mMemoryBudget->Enforce();
+
+			// Nothing to write back: the content already carries the requested label.
+			if (SkipNoOp(options))
+			{
+				if (patch != nullptr)
+				{
+					patch->contentIdentifier = options.contentIdentifier;
+				}
+				return true;
+			}
+
 			// If an engine hasn't been added, add it.
-			if (!mEngine)
+			EnsureEngine();
+
+			if (mLocalEngine)
 			{
-				AddNewPolicyEngine();
+				return ComputeActionLoopWith(CreateLocalHandler(), options, patch);
 			}
+			return ComputeActionLoopWith(CreateServiceHandler(), options, patch);
+		}
 
+		template<typename Handler>
+		bool Action::ComputeActionLoopWith(const std::shared_ptr<Handler>& handler, ExecutionStateOptions& options, MetadataPatch* patch)
+		{
 			// ExecutionStateImpl is derived from mip::ExecutionState
-			std::unique_ptr<ExecutionStateImpl> state;
-			state.reset(new ExecutionStateImpl(options));
-			
-			auto handler = mEngine->CreatePolicyHandler("");
-			auto actions = handler->ComputeActions(*state);
+			std::shared_ptr<ExecutionStateImpl> state;
+			auto actions = ComputeActionsWithDeadline(handler, options, state);
+			SampleFastPath<Handler>(options, actions);
+
+			if (patch != nullptr)
+			{
+				patch->contentIdentifier = options.contentIdentifier;
+			}
 
 			while (actions.size() > 0)
 			{
-				cout << "Action Count: " << actions.size() << endl;
+				mLog->Log(LogLevel::Info, "Action Count: %zu", actions.size());
+				bool justificationMissing = false;
 
-				// Iterate through actions returned from ComputeActions()
-				for (const auto action : actions)
+				// Read every action once into plain values, then iterate those.
+				ActionResults results(actions);
+				for (const auto& result : results)
 				{
-					switch (action->GetType())
+					// Metadata and protection changes are collected for the write-back stage.
+					if (patch != nullptr)
+					{
+						patch->AddResult(result);
+					}
+
+					switch (GetResultType(result))
 					{
 					case mip::ActionType::METADATA: {
 
-						auto derivedAction = static_cast<mip::MetadataAction*>(action.get());
+						const auto& derivedAction = std::get<MetadataResult>(result);
 
-						if (derivedAction->GetMetadataToRemove().size() > 0)
+						if (!derivedAction.keysToRemove.empty())
 						{
-							cout << "*** Action: Remove Metadata" << endl;
+							mLog->Log(LogLevel::Info, "*** Action: Remove Metadata");
 
 							// Iterate through list of metadata to add and add to execution state.
-							for (const std::string oldMetadata : derivedAction->GetMetadataToRemove())
+							for (std::string_view oldMetadata : derivedAction.keysToRemove)
 							{
 								/******
 								*
 								* In this loop, your application should handle removing metadata from the file the user is labeling.
+								* Pass a MetadataPatch to have the removals applied by a MetadataWriter.
 								*
 								*******/
 
 								options.metadata.clear();
 
 								// Display metadata.
-								cout << oldMetadata << endl;
+								mLog->Log(LogLevel::Info, "%.*s", static_cast<int>(oldMetadata.size()), oldMetadata.data());
 							}
 						}
 
-						if (derivedAction->GetMetadataToAdd().size() > 0)
+						if (!derivedAction.entriesToAdd.empty())
 						{
-							cout << "*** Action Type: Apply Metadata" << endl;
+							mLog->Log(LogLevel::Info, "*** Action Type: Apply Metadata");
 
 							// Iterate through list of metadata to add and add to execution state.
-							for (const mip::MetadataEntry& prop : derivedAction->GetMetadataToAdd())
+							for (const MetadataResultEntry& prop : derivedAction.entriesToAdd)
 							{
 								/******
 								*
 								* In this loop, your application should handle adding metadata to the file the user is labeling.
+								* Pass a MetadataPatch to have the additions applied by a MetadataWriter.
 								*
 								*******/								
-								options.metadata.emplace(prop.GetKey(), prop.GetValue());
+								options.metadata.emplace(prop.key, prop.value);
 
 
 								// Display metadata.
-								cout << prop.GetKey() << " : " << prop.GetValue() << endl;
+								mLog->Log(LogLevel::Info, "%.*s : %.*s", static_cast<int>(prop.key.size()), prop.key.data(),
+									static_cast<int>(prop.value.size()), prop.value.data());
 							}
 						}
 						break;
@@ -265,11 +939,10 @@ namespace sample {
 						*
 						*******/
 
-						auto derivedAction = static_cast<mip::ProtectByTemplateAction*>(action.get());
-						options.templateId = derivedAction->GetTemplateId();
+						options.templateId = std::get<ProtectByTemplateResult>(result).templateId;
 
 						// Display Template ID.
-						cout << "*** Action Type: Protect By Template: " << options.templateId << endl;
+						mLog->Log(LogLevel::Info, "*** Action Type: Protect By Template: %s", options.templateId.c_str());
 						break;
 					}
 
@@ -281,7 +954,7 @@ namespace sample {
 						*
 						*******/
 
-						cout << "*** Action Type: Remove Protection." << endl;
+						mLog->Log(LogLevel::Info, "*** Action Type: Remove Protection.");
 
 						// Set template to empty.
 						options.templateId.resize(0);
@@ -294,16 +967,67 @@ namespace sample {
 						/******
 						*
 						* Here, your application would call display some prompt to the user to provide justification on downgrading.
+						* The justification provider decides whether to prompt, answer from rules or set the item aside.
 						*
 						*******/
 
-						cout << "*** Action Type: Justification Required" << endl;
+						mLog->Log(LogLevel::Info, "*** Action Type: Justification Required");
 
-						// Enter some string for justification.
-						cout << "Provide Justification: ";
-						cin >> options.downgradeJustification;
+						auto justification = mOptions.justificationProvider->GetJustification(options, options.downgradeJustification);
+						if (justification != JustificationResult::Provided)
+						{
+							mLog->Log(LogLevel::Info, "*** Justification %s for %s", justification == JustificationResult::Deferred ? "deferred" : "denied", options.contentIdentifier.c_str());
+							justificationMissing = true;
+							break;
+						}
 						options.isDowngradeJustified = true;
-						cout << endl;
+						break;
+					}
+
+					case mip::ActionType::ADD_CONTENT_HEADER: {
+
+						/******
+						*
+						* Here, your application would add the header to the document.
+						*
+						*******/
+
+						const auto& derivedAction = std::get<MarkingResult>(result);
+						const auto& text = RenderMarking(derivedAction.text, derivedAction.type, options);
+						mLog->Log(LogLevel::Info, "*** Action Type: Add Header (%.*s, %.*s %d): %s", static_cast<int>(derivedAction.uiElementName.size()),
+							derivedAction.uiElementName.data(), static_cast<int>(derivedAction.fontName.size()), derivedAction.fontName.data(),
+							derivedAction.fontSize, text.c_str());
+						break;
+					}
+
+					case mip::ActionType::ADD_CONTENT_FOOTER: {
+
+						/******
+						*
+						* Here, your application would add the footer to the document.
+						*
+						*******/
+
+						const auto& derivedAction = std::get<MarkingResult>(result);
+						const auto& text = RenderMarking(derivedAction.text, derivedAction.type, options);
+						mLog->Log(LogLevel::Info, "*** Action Type: Add Footer (%.*s, %.*s %d): %s", static_cast<int>(derivedAction.uiElementName.size()),
+							derivedAction.uiElementName.data(), static_cast<int>(derivedAction.fontName.size()), derivedAction.fontName.data(),
+							derivedAction.fontSize, text.c_str());
+						break;
+					}
+
+					case mip::ActionType::ADD_WATERMARK: {
+
+						/******
+						*
+						* Here, your application would add the watermark to the document.
+						*
+						*******/
+
+						const auto& derivedAction = std::get<MarkingResult>(result);
+						const auto& text = RenderMarking(derivedAction.text, derivedAction.type, options);
+						mLog->Log(LogLevel::Info, "*** Action Type: Add Watermark (%.*s, %s): %s", static_cast<int>(derivedAction.uiElementName.size()),
+							derivedAction.uiElementName.data(), derivedAction.layout == mip::WatermarkLayout::DIAGONAL ? "diagonal" : "horizontal", text.c_str());
 						break;
 					}
 
@@ -317,17 +1041,33 @@ namespace sample {
 					}
 				}
 
+				// Without the justification the downgrade can't go ahead. Leave the item unchanged.
+				if (justificationMissing)
+				{
+					return false;
+				}
+
 				// Compute actions based on new state information. 
 				// Update state
-				state.reset(new ExecutionStateImpl(options));
-
-				actions = handler->ComputeActions(*state);
+				actions = ComputeActionsWithDeadline(handler, options, state);
+				SampleFastPath<Handler>(options, actions);
 				
-				cout << "*** Remaining Action Count: " << actions.size() << endl;			
+				mLog->Log(LogLevel::Info, "*** Remaining Action Count: %zu", actions.size());			
+			}
+
+			// The loop ends in a state the engine has no further actions for.
+			if (mNoOpFilter)
+			{
+				mNoOpFilter->RecordNoOp(options);
 			}
 
 			if (options.generateAuditEvent && actions.size() == 0)
 			{
+				utils::TraceSpan span(mOptions.tracer.get(), "NotifyCommittedActions");
+				if (!state)
+				{
+					state = CreateExecutionState(options);
+				}
 				handler->NotifyCommittedActions(*state);
 			}
 
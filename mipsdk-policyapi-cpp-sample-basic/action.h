@@ -29,19 +29,82 @@
 #ifndef SAMPLES_BASICLABELING_ACTION_H_
 #define SAMPLES_BASICLABELING_ACTION_H_
 
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include "mip/common_types.h"
 #include "mip/upe/policy_profile.h"
 #include "mip/upe/policy_engine.h"
+#include "mip/upe/policy_handler.h"
 
+#include "async_log_sink.h"
+#include "cancellation.h"
+#include "action_results.h"
 #include "auth_delegate_impl.h"
 #include "profile_observer_impl.h"
 #include "execution_state_impl.h"
+#include "justification_provider.h"
+#include "label_properties.h"
+#include "label_snapshot.h"
+#include "local_policy_engine.h"
+#include "marking_template.h"
+#include "memory_accounting.h"
+#include "metadata_writer.h"
+#include "noop_filter.h"
+#include "shadow_verifier.h"
+#include "trace_recorder.h"
+#include "worker_pool.h"
+#include "workload_recorder.h"
 
 namespace sample {
-	namespace policy {		
+	namespace policy {
+
+		struct ActionOptions {
+			bool generateAuditEvents = true;		// Set if application should submit audit events to AIP Analytics
+			std::string labelSnapshotPath;			// Label snapshot written after each engine load. Empty disables snapshots.
+			std::chrono::seconds labelSnapshotMaxAge{ std::chrono::hours(24) };	// Older snapshots are ignored, as the policy may have changed. Zero accepts any age.
+			mip::CacheStorageType cacheStorageType = mip::CacheStorageType::OnDiskEncrypted;	// InMemory suits short-lived workers, on-disk caches suit daemons.
+			std::string cachePath = "mip_data";		// Directory for the SDK's cache and logs. Should be on a fast local disk.
+			std::string policyDataXmlPath;			// Optional local policy loaded instead of fetching from the service, e.g. for benchmarks.
+			std::string localPolicyPath;			// JSON policy evaluated in-process by LocalPolicyEngine. No MipContext, tenant or token is needed.
+			std::string classifierRulesPath;		// Sensitive information types used when ExecutionStateOptions has no classifier. Empty disables.
+			std::string labelPropertiesPath;		// JSON extended properties per label, used when ExecutionStateOptions has none. Empty disables.
+			ContentScanSettings contentScanSettings;	// How files named by contentIdentifier are read for classification
+			std::string classificationCachePath;	// Persistent classification results keyed by content hash. Empty disables caching.
+			mip::LogLevel sdkLogLevel = mip::LogLevel::Warning;	// Lowest level the SDK generates. Fixed once the MipContext exists.
+			mip::LogLevel logLevel = mip::LogLevel::Info;		// Level written by the log sink. Can be changed with SetLogLevel().
+			std::string logFilePath;				// Log file. Empty writes to stdout.
+			std::shared_ptr<utils::AsyncLogSink> logSink;	// Sink shared with other components. Created from the fields above if null.
+			std::shared_ptr<JustificationProvider> justificationProvider;	// Answers JUSTIFY actions. Prompts on the console if null.
+			std::chrono::milliseconds engineLoadTimeout{ std::chrono::minutes(2) };	// Limit for each of profile and engine creation. Zero waits forever.
+			std::chrono::milliseconds tokenTimeout{ std::chrono::seconds(30) };		// Limit for a single token fetch. Zero waits forever.
+			std::chrono::milliseconds computeTimeout{ 0 };		// Limit for each ComputeActions call. Zero runs it inline without a deadline.
+			unsigned int computeThreads = 0;		// Threads running ComputeActions calls that have a deadline. Zero uses one per core.
+			unsigned int maxAbandonedComputes = 8;	// Calls past their deadline that may still be running. Further calls fail at once.
+			std::shared_ptr<utils::CancellationToken> cancellation;	// Fired by Cancel(). Created if null.
+			bool skipNoOpEvaluations = false;		// Answer requests the content's label already satisfies without an evaluation, unless they ask for an audit event
+			std::shared_ptr<utils::TraceRecorder> tracer;	// Records spans of sampled requests for Chrome trace export. Null disables tracing.
+			std::shared_ptr<WorkloadRecorder> workloadRecorder;	// Captures each ComputeAction and ComputeActionLoop request for replay. Null disables recording.
+			ShadowVerifierSettings shadowVerification;	// Checks a sample of local policy answers against the SDK engine. Off unless sampleRate is set.
+			size_t memoryBudgetBytes = 0;			// Caches are evicted, cheapest to rebuild first, while accounted memory exceeds this. Zero only reports.
+		};
+
+		struct ActionStats {
+			uint64_t engineLoadTimeouts = 0;	// Profile or engine creations abandoned at the deadline
+			uint64_t tokenTimeouts = 0;			// Token fetches abandoned at the deadline
+			uint64_t computeTimeouts = 0;		// ComputeActions calls abandoned at the deadline
+			uint64_t computeRejections = 0;		// ComputeActions calls refused while maxAbandonedComputes calls were still running
+			uint64_t cancellations = 0;			// Waits abandoned because the cancellation token fired
+			uint64_t noOpSkips = 0;				// Evaluations skipped because the content already had the requested label
+			ShadowVerifierStats shadow;			// Fast-path answers checked against the SDK engine
+			std::vector<utils::MemoryUsage> memory;	// Bytes held by each engine, label table and cache
+			uint64_t memoryEvictions = 0;		// Caches cleared to stay within memoryBudgetBytes
+		};
+
 		class Action {
 		public:
 			
@@ -49,25 +112,92 @@ namespace sample {
 				const std::string& username,
 				const std::string& password,
 				const bool generateAuditEvents);
+
+			Action(const mip::ApplicationInfo appInfo,
+				const std::string& username,
+				const std::string& password,
+				const ActionOptions& options);
 			
 			~Action();
 					
 			void ListLabels();							// List all labels associated engine loaded for user			
 			std::vector<std::shared_ptr<mip::Action>> ComputeAction(const ExecutionStateOptions& options); // Calculate actions for new label			
-			bool ComputeActionLoop(ExecutionStateOptions& options); // Loop on provided execution state options, updating each iteration until zero actions are needed. 
+			bool ComputeActionLoop(ExecutionStateOptions& options, MetadataPatch* patch = nullptr); // Loop on provided execution state options, updating each iteration until zero actions are needed. Changes to make to the file are collected in patch. False if a required justification was deferred or denied.
 			std::shared_ptr<mip::Label> GetLabelById(const std::string& labelId);
 
+			void LoadEngine();							// Load the engine on the calling thread, or wait for the background load.
+			void StartEngineLoad();						// Begin loading the engine on a background thread. Lookups are served from the label snapshot meanwhile.
+			bool ResolveLabel(const std::string& labelId, LabelInfo& info); // Resolve label details from the engine if loaded, otherwise from the snapshot.
+			bool IsValidLabel(const std::string& labelId); // True if the label exists and is active.
+			std::vector<LabelInfo> GetLabels();		// All labels and their children, from the engine if loaded, otherwise from the snapshot.
+			bool IsEngineReady() const { return mEngineReady; }
+			void SetLogLevel(mip::LogLevel level);		// Change the application and SDK log level at runtime.
+			const std::shared_ptr<utils::AsyncLogSink>& GetLogSink() const { return mLog; }
+			const std::shared_ptr<utils::TraceRecorder>& GetTracer() const { return mOptions.tracer; }
+			const std::shared_ptr<JustificationProvider>& GetJustificationProvider() const { return mOptions.justificationProvider; }
+			void Cancel() { mOptions.cancellation->Cancel(); }	// Abandon pending and future waits. Waits throw utils::CancelledError.
+			ActionStats GetStats() const;
+			void FlushShadowVerification();				// Wait for sampled answers to be checked. Call before reading shadow stats.
+			std::vector<ShadowMismatch> GetShadowMismatches() const;
+
 		private:
 			void AddNewProfile();					// Private function for adding and loading mip::FileProfile
 			void AddNewPolicyEngine();					// Private function for adding/loading mip::FileEngine for specified user
+			void AddNewServiceEngine();					// Load mEngine through the SDK, even when a local policy is configured.
+			void EnsureEngine();						// Load the engine if needed, waiting for a background load already in progress.
+			void WriteLabelSnapshot();					// Persist the label table of mEngine to mOptions.labelSnapshotPath.
+			std::string GetSnapshotOwner() const;		// Identity and policy source a label snapshot is valid for
+			std::shared_ptr<LocalPolicyHandler> CreateLocalHandler();
+			std::shared_ptr<mip::PolicyHandler> CreateServiceHandler();
+			std::shared_ptr<ExecutionStateImpl> CreateExecutionState(ExecutionStateOptions options) const;	// On the calling thread's request arena
+			std::vector<std::shared_ptr<mip::Label>> GetEngineLabels();	// Top-level labels of whichever engine is loaded
+			// Handler is mip::PolicyHandler or LocalPolicyHandler, which share the same contract.
+			template<typename Handler> std::vector<std::shared_ptr<mip::Action>> ComputeActionWith(const std::shared_ptr<Handler>& handler,
+				const ExecutionStateOptions& options);
+			template<typename Handler> bool ComputeActionLoopWith(const std::shared_ptr<Handler>& handler, ExecutionStateOptions& options,
+				MetadataPatch* patch);
+			template<typename Handler> std::vector<std::shared_ptr<mip::Action>> ComputeActionsWithDeadline(const std::shared_ptr<Handler>& handler,
+				const ExecutionStateOptions& options, std::shared_ptr<ExecutionStateImpl>& state);	// Run ComputeActions, abandoning it after mOptions.computeTimeout. state is left null if it ran on a compute thread.
+			template<typename Handler> void SampleFastPath(const ExecutionStateOptions& options,
+				const std::vector<std::shared_ptr<mip::Action>>& actions);	// Hand answers from a fast path to the shadow verifier.
+			const std::string& RenderMarking(std::string_view text, mip::ActionType type, const ExecutionStateOptions& options);	// Fill in a header, footer or watermark. Valid until the next call on this thread.
+			bool SkipNoOp(const ExecutionStateOptions& options);	// True if options is a known no-op, answered without the engine.
+			std::vector<std::shared_ptr<mip::Action>> ComputeReferenceActions(const ExecutionStateOptions& options);	// SDK evaluation for shadow checks
+			template<typename T> T WaitForLoad(std::future<T>& future, const char* operation); // Wait for a profile or engine load, counting timeouts.
 			
 			std::shared_ptr<sample::auth::AuthDelegateImpl> mAuthDelegate;			// AuthDelegateImpl object that will be used throughout the sample to store auth details.
 			std::shared_ptr<mip::MipContext> mMipContext;
 			std::shared_ptr<mip::PolicyProfile> mProfile;								// mip::FileProfile object to store/load state information 
+			std::shared_ptr<utils::MemoryAccount> mEngineMemory;						// Estimated from mEngine's label table, which the SDK allocates
+			std::shared_ptr<utils::MemoryAccount> mLocalPolicyMemory;					// Estimated from mLocalEngine's label table
+			std::shared_ptr<utils::MemoryAccount> mNoOpMemory;							// Counted by mNoOpFilter's allocator
+			std::shared_ptr<utils::MemoryAccount> mClassificationMemory;				// Counted by mClassificationCache's allocator
 			std::shared_ptr<mip::PolicyEngine> mEngine;								// mip::FileEngine object to handle user-specific actions. 			
+			std::shared_ptr<LocalPolicyEngine> mLocalEngine;							// Used instead of mEngine when a local policy is configured
 			mip::ApplicationInfo mAppInfo;											// mip::ApplicationInfo object for storing client_id and friendlyname
 			std::shared_ptr<ProfileObserverImpl> mProfileObserver;
-			bool mGenerateAuditEvents;												// Set if application should submit audit events to AIP Analytics
+			ActionOptions mOptions;
+
+			std::mutex mEngineMutex;													// Guards mEngineLoad
+			std::shared_future<void> mEngineLoad;										// Pending or completed engine load
+			std::atomic<bool> mEngineReady{ false };									// Set once mEngine can be used without waiting
+			std::shared_ptr<LabelSnapshot> mLabelSnapshot;								// Snapshot from a previous run, used until the engine is ready. Accessed with std::atomic_load/store.
+			std::shared_ptr<utils::AsyncLogSink> mLog;									// Asynchronous sink for application and SDK log messages
+			std::shared_ptr<const Classifier> mClassifier;								// Default local classifier for execution states
+			std::shared_ptr<const LabelPropertyTable> mLabelProperties;					// Default extended properties for execution states
+			std::shared_ptr<const ContentScanner> mContentScanner;						// Default file reader for classification
+			std::shared_ptr<ClassificationCache> mClassificationCache;					// Results of previous scans, shared by mContentScanner
+			std::atomic<uint64_t> mEngineLoadTimeouts{ 0 };
+			std::atomic<uint64_t> mComputeTimeouts{ 0 };
+			std::atomic<uint64_t> mComputeRejections{ 0 };
+			std::atomic<unsigned int> mAbandonedComputes{ 0 };							// Calls past their deadline not yet finished or skipped
+			std::unique_ptr<utils::WorkerPool> mComputePool;							// Runs ComputeActions calls that have a deadline
+			std::atomic<uint64_t> mCancellations{ 0 };
+			MarkingTemplateCache mMarkingTemplates;										// Compiled header, footer and watermark text per label
+			std::unique_ptr<NoOpFilter> mNoOpFilter;									// Set when skipNoOpEvaluations is on and no classifier is configured
+			std::atomic<uint64_t> mNoOpSkips{ 0 };
+			std::unique_ptr<ShadowVerifier> mShadowVerifier;							// Set when shadowVerification.sampleRate is above zero
+			std::unique_ptr<utils::MemoryBudget> mMemoryBudget;							// Reports the accounts above and evicts caches over memoryBudgetBytes
 
 
 			std::string mUsername; // store username to pass to auth delegate and to generate Identity
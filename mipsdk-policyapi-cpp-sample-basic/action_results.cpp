@@ -0,0 +1,205 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+#include "action_results.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "mip/upe/add_content_footer_action.h"
+#include "mip/upe/metadata_action.h"
+#include "mip/upe/protect_by_template_action.h"
+
+using std::string;
+
+namespace {
+	const size_t kTextBlockBytes = 4096;	// Typical results fit in one block
+
+	// Where a metadata result's keys and entries start. Pointers are only taken once every action has been read.
+	struct MetadataRanges {
+		size_t result;
+		size_t firstKey;
+		size_t firstEntry;
+	};
+
+	template<typename ContentMark>
+	void ReadPlacement(const ContentMark& mark, sample::policy::MarkingResult& result)
+	{
+		result.alignment = mark.GetAlignment();
+		result.margin = mark.GetMargin();
+	}
+
+	void ReadPlacement(const mip::AddWatermarkAction& watermark, sample::policy::MarkingResult& result)
+	{
+		result.layout = watermark.GetLayout();
+	}
+
+	// Indexed by bit position. mip::ActionType values are single bits so they can be combined into masks.
+	const char* const kActionTypeNames[] = {
+		"ADD_CONTENT_FOOTER", "ADD_CONTENT_HEADER", "ADD_WATERMARK", "CUSTOM", "JUSTIFY", "METADATA", "PROTECT_ADHOC",
+		"PROTECT_BY_TEMPLATE", "PROTECT_DO_NOT_FORWARD", "REMOVE_CONTENT_FOOTER", "REMOVE_CONTENT_HEADER", "REMOVE_PROTECTION",
+		"REMOVE_WATERMARK", "APPLY_LABEL", "RECOMMEND_LABEL", "PROTECT_ADHOC_DK", "PROTECT_BY_ENCRYPT_ONLY"
+	};
+
+	struct ResultTypeVisitor {
+		mip::ActionType operator()(const sample::policy::MetadataResult&) const { return mip::ActionType::METADATA; }
+		mip::ActionType operator()(const sample::policy::ProtectByTemplateResult&) const { return mip::ActionType::PROTECT_BY_TEMPLATE; }
+		mip::ActionType operator()(const sample::policy::RemoveProtectionResult&) const { return mip::ActionType::REMOVE_PROTECTION; }
+		mip::ActionType operator()(const sample::policy::JustifyResult&) const { return mip::ActionType::JUSTIFY; }
+		mip::ActionType operator()(const sample::policy::MarkingResult& result) const { return result.type; }
+		mip::ActionType operator()(const sample::policy::OtherResult& result) const { return result.type; }
+	};
+}
+
+namespace sample {
+	namespace policy {
+
+		mip::ActionType GetResultType(const ActionResult& result)
+		{
+			return std::visit(ResultTypeVisitor(), result);
+		}
+
+		const char* GetActionTypeName(mip::ActionType type)
+		{
+			auto bits = static_cast<uint32_t>(type);
+			for (size_t i = 0; i < sizeof(kActionTypeNames) / sizeof(kActionTypeNames[0]); ++i)
+			{
+				if (bits == (1u << i))
+				{
+					return kActionTypeNames[i];
+				}
+			}
+			return nullptr;
+		}
+
+		template<typename Marking>
+		MarkingResult ActionResults::StoreMarking(const Marking& marking)
+		{
+			MarkingResult result;
+			result.type = marking.GetType();
+			result.uiElementName = Store(marking.GetUIElementName());
+			result.text = Store(marking.GetText());
+			result.fontName = Store(marking.GetFontName());
+			result.fontColor = Store(marking.GetFontColor());
+			result.fontSize = marking.GetFontSize();
+			ReadPlacement(marking, result);
+			return result;
+		}
+
+		ActionResults::ActionResults(const std::vector<std::shared_ptr<mip::Action>>& actions)
+		{
+			mResults.reserve(actions.size());
+
+			std::vector<MetadataRanges> metadataRanges;
+			unsigned int types = 0;
+			for (const auto& action : actions)
+			{
+				auto type = action->GetType();
+				types |= static_cast<unsigned int>(type);
+				switch (type)
+				{
+				case mip::ActionType::METADATA: {
+					const auto& metadata = static_cast<const mip::MetadataAction&>(*action);
+					const auto& toRemove = metadata.GetMetadataToRemove();
+					const auto& toAdd = metadata.GetMetadataToAdd();
+					metadataRanges.push_back(MetadataRanges{ mResults.size(), mKeys.size(), mEntries.size() });
+					for (const auto& key : toRemove)
+					{
+						mKeys.push_back(Store(key));
+					}
+					for (const auto& entry : toAdd)
+					{
+						mEntries.push_back(MetadataResultEntry{ Store(entry.GetKey()), Store(entry.GetValue()) });
+					}
+					MetadataResult result;
+					result.keysToRemove = ResultRange<std::string_view>(nullptr, toRemove.size());
+					result.entriesToAdd = ResultRange<MetadataResultEntry>(nullptr, toAdd.size());
+					mResults.emplace_back(result);
+					break;
+				}
+				case mip::ActionType::PROTECT_BY_TEMPLATE:
+					mResults.emplace_back(ProtectByTemplateResult{ Store(static_cast<const mip::ProtectByTemplateAction&>(*action).GetTemplateId()) });
+					break;
+				case mip::ActionType::REMOVE_PROTECTION:
+					mResults.emplace_back(RemoveProtectionResult());
+					break;
+				case mip::ActionType::JUSTIFY:
+					mResults.emplace_back(JustifyResult());
+					break;
+				case mip::ActionType::ADD_CONTENT_HEADER:
+					mResults.emplace_back(StoreMarking(static_cast<const mip::AddContentHeaderAction&>(*action)));
+					break;
+				case mip::ActionType::ADD_CONTENT_FOOTER:
+					mResults.emplace_back(StoreMarking(static_cast<const mip::AddContentFooterAction&>(*action)));
+					break;
+				case mip::ActionType::ADD_WATERMARK:
+					mResults.emplace_back(StoreMarking(static_cast<const mip::AddWatermarkAction&>(*action)));
+					break;
+				default:
+					mResults.emplace_back(OtherResult{ type });
+					break;
+				}
+			}
+			mTypes = static_cast<mip::ActionType>(types);
+
+			// mKeys and mEntries are complete and won't move again.
+			for (const auto& ranges : metadataRanges)
+			{
+				auto& result = std::get<MetadataResult>(mResults[ranges.result]);
+				result.keysToRemove = ResultRange<std::string_view>(mKeys.data() + ranges.firstKey, result.keysToRemove.size());
+				result.entriesToAdd = ResultRange<MetadataResultEntry>(mEntries.data() + ranges.firstEntry, result.entriesToAdd.size());
+			}
+		}
+
+		std::string_view ActionResults::Store(const string& value)
+		{
+			if (value.empty())
+			{
+				return std::string_view();
+			}
+			if (value.size() > mTextLeft)
+			{
+				mTextLeft = std::max(value.size(), kTextBlockBytes);
+				mTextBlocks.emplace_back(new char[mTextLeft]);
+				mTextNext = mTextBlocks.back().get();
+			}
+			char* target = mTextNext;
+			std::memcpy(target, value.data(), value.size());
+			mTextNext += value.size();
+			mTextLeft -= value.size();
+			return std::string_view(target, value.size());
+		}
+
+		bool ActionResults::Contains(mip::ActionType type) const
+		{
+			return (static_cast<unsigned int>(mTypes) & static_cast<unsigned int>(type)) != 0;
+		}
+
+	} //  namespace policy
+} //  namespace sample
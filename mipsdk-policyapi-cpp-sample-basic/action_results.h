@@ -0,0 +1,147 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+#ifndef SAMPLES_UPE_ACTION_RESULTS_H_
+#define SAMPLES_UPE_ACTION_RESULTS_H_
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "mip/upe/action.h"
+#include "mip/upe/add_content_header_action.h"
+#include "mip/upe/add_watermark_action.h"
+
+namespace sample {
+	namespace policy {
+
+		// View of consecutive elements stored by an ActionResults.
+		template<typename T>
+		class ResultRange {
+		public:
+			ResultRange() = default;
+			ResultRange(const T* first, size_t count) : mFirst(first), mCount(count) {}
+
+			const T* begin() const { return mFirst; }
+			const T* end() const { return mFirst + mCount; }
+			size_t size() const { return mCount; }
+			bool empty() const { return mCount == 0; }
+
+		private:
+			const T* mFirst = nullptr;
+			size_t mCount = 0;
+		};
+
+		struct MetadataResultEntry {
+			std::string_view key;
+			std::string_view value;
+		};
+
+		struct MetadataResult {
+			ResultRange<std::string_view> keysToRemove;
+			ResultRange<MetadataResultEntry> entriesToAdd;
+		};
+
+		struct ProtectByTemplateResult {
+			std::string_view templateId;
+		};
+
+		struct RemoveProtectionResult {};
+
+		struct JustifyResult {};
+
+		// ADD_CONTENT_HEADER, ADD_CONTENT_FOOTER or ADD_WATERMARK. alignment and margin only apply to headers and
+		// footers, layout only to watermarks.
+		struct MarkingResult {
+			mip::ActionType type = mip::ActionType::ADD_CONTENT_HEADER;
+			std::string_view uiElementName;
+			std::string_view text;
+			std::string_view fontName;
+			std::string_view fontColor;
+			int fontSize = 0;
+			mip::ContentMarkAlignment alignment = mip::ContentMarkAlignment::LEFT;
+			int margin = 0;
+			mip::WatermarkLayout layout = mip::WatermarkLayout::HORIZONTAL;
+		};
+
+		// Any other action type. Only the type is kept.
+		struct OtherResult {
+			mip::ActionType type = mip::ActionType::CUSTOM;
+		};
+
+		typedef std::variant<MetadataResult, ProtectByTemplateResult, RemoveProtectionResult, JustifyResult, MarkingResult, OtherResult> ActionResult;
+
+		mip::ActionType GetResultType(const ActionResult& result);
+		const char* GetActionTypeName(mip::ActionType type);	// Null for types this sample doesn't name
+
+		/**
+		 * @brief The actions returned by ComputeActions, read once into plain values.
+		 * Conversion is a single pass that calls each SDK getter once. Strings are copied into blocks that are never moved
+		 * or reallocated, and metadata keys and entries go into one array each, so consumers iterate contiguous memory
+		 * without touching shared_ptr reference counts or virtual getters. Results hold views into that storage. Moving
+		 * keeps them valid but a copy would not, so the type is move-only.
+		 */
+		class ActionResults final {
+		public:
+			ActionResults() = default;
+			explicit ActionResults(const std::vector<std::shared_ptr<mip::Action>>& actions);
+
+			ActionResults(ActionResults&&) noexcept = default;
+			ActionResults& operator=(ActionResults&&) noexcept = default;
+			ActionResults(const ActionResults&) = delete;
+			ActionResults& operator=(const ActionResults&) = delete;
+
+			std::vector<ActionResult>::const_iterator begin() const { return mResults.begin(); }
+			std::vector<ActionResult>::const_iterator end() const { return mResults.end(); }
+			size_t size() const { return mResults.size(); }
+			bool empty() const { return mResults.empty(); }
+			const ActionResult& operator[](size_t index) const { return mResults[index]; }
+
+			bool Contains(mip::ActionType type) const;
+			mip::ActionType GetTypes() const { return mTypes; }	// Every type present, combined
+
+		private:
+			std::string_view Store(const std::string& value);	// Copy into the current text block, starting a new one if it is full
+			template<typename Marking> MarkingResult StoreMarking(const Marking& marking);
+
+			std::vector<std::unique_ptr<char[]>> mTextBlocks;
+			char* mTextNext = nullptr;		// Free space in the last block
+			size_t mTextLeft = 0;
+			std::vector<std::string_view> mKeys;
+			std::vector<MetadataResultEntry> mEntries;
+			std::vector<ActionResult> mResults;
+			mip::ActionType mTypes = static_cast<mip::ActionType>(0);
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_ACTION_RESULTS_H_
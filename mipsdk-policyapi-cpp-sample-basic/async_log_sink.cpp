@@ -0,0 +1,249 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "async_log_sink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+using std::string_view;
+
+namespace {
+	const char* GetLevelName(mip::LogLevel level)
+	{
+		switch (level)
+		{
+		case mip::LogLevel::Trace: return "Trace";
+		case mip::LogLevel::Info: return "Info";
+		case mip::LogLevel::Warning: return "Warning";
+		case mip::LogLevel::Error: return "Error";
+		default: return "Unknown";
+		}
+	}
+
+	size_t RoundUpToPowerOfTwo(size_t value)
+	{
+		size_t result = 2;
+		while (result < value)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+}
+
+namespace sample {
+	namespace utils {
+
+		AsyncLogSink::AsyncLogSink(const Settings& settings)
+			: mMask(RoundUpToPowerOfTwo(settings.capacity) - 1),
+			mLevel(static_cast<int>(settings.level)),
+			mMaxMessagesPerSecond(settings.maxMessagesPerSecond),
+			mOutput(&std::cout)
+		{
+			mSlots.reset(new Slot[mMask + 1]);
+			for (size_t i = 0; i <= mMask; ++i)
+			{
+				mSlots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+			mSites.reset(new RateLimitSite[kRateLimitSites]);
+
+			if (!settings.filePath.empty())
+			{
+				mFile.open(settings.filePath, std::ios::app);
+				if (!mFile)
+				{
+					throw std::runtime_error("Unable to open log file " + settings.filePath);
+				}
+				mOutput = &mFile;
+			}
+
+			mDrainThread = std::thread(&AsyncLogSink::Drain, this);
+		}
+
+		AsyncLogSink::~AsyncLogSink()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mDrainMutex);
+				mStopping = true;
+			}
+			mDrainCondition.notify_one();
+			mDrainThread.join();
+		}
+
+		void AsyncLogSink::Log(mip::LogLevel level, const char* format, ...)
+		{
+			if (!IsEnabled(level))
+			{
+				return;
+			}
+
+			char buffer[kMaxMessageLength];
+			va_list args;
+			va_start(args, format);
+			int length = vsnprintf(buffer, sizeof(buffer), format, args);
+			va_end(args);
+			if (length < 0)
+			{
+				return;
+			}
+
+			Write(level, string_view(buffer, std::min(static_cast<size_t>(length), sizeof(buffer) - 1)), reinterpret_cast<uintptr_t>(format));
+		}
+
+		void AsyncLogSink::Write(mip::LogLevel level, string_view message, uint64_t siteKey)
+		{
+			if (!IsEnabled(level))
+			{
+				return;
+			}
+
+			auto now = std::chrono::system_clock::now().time_since_epoch();
+			auto nowMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+			if (!AllowSite(siteKey, nowMilliseconds / 1000))
+			{
+				mSuppressed.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			// Claim a slot. A slot is free when its sequence equals the position being claimed.
+			uint64_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+			Slot* slot;
+			for (;;)
+			{
+				slot = &mSlots[position & mMask];
+				uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+				int64_t difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+				if (difference == 0)
+				{
+					if (mEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (difference < 0)
+				{
+					// Buffer is full. Dropping keeps the request path from ever waiting on log I/O.
+					mDropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				else
+				{
+					position = mEnqueuePosition.load(std::memory_order_relaxed);
+				}
+			}
+
+			slot->level = level;
+			slot->timestamp = nowMilliseconds;
+			slot->length = static_cast<uint32_t>(std::min(message.size(), kMaxMessageLength));
+			std::memcpy(slot->text, message.data(), slot->length);
+			slot->sequence.store(position + 1, std::memory_order_release);
+		}
+
+		bool AsyncLogSink::AllowSite(uint64_t siteKey, int64_t nowSeconds)
+		{
+			if (mMaxMessagesPerSecond == 0)
+			{
+				return true;
+			}
+
+			auto& site = mSites[(siteKey ^ (siteKey >> 17)) & (kRateLimitSites - 1)];
+			int64_t window = site.window.load(std::memory_order_relaxed);
+			if (window != nowSeconds && site.window.compare_exchange_strong(window, nowSeconds, std::memory_order_relaxed))
+			{
+				site.count.store(0, std::memory_order_relaxed);
+			}
+
+			return site.count.fetch_add(1, std::memory_order_relaxed) < mMaxMessagesPerSecond;
+		}
+
+		void AsyncLogSink::Flush()
+		{
+			uint64_t target = mEnqueuePosition.load(std::memory_order_acquire);
+			std::unique_lock<std::mutex> lock(mDrainMutex);
+			mDrainCondition.notify_one();
+			mFlushCondition.wait(lock, [this, target]() {
+				return mDequeuePosition.load(std::memory_order_acquire) >= target || mStopping;
+			});
+		}
+
+		void AsyncLogSink::WriteSlot(const Slot& slot)
+		{
+			char prefix[48];
+			int length = snprintf(prefix, sizeof(prefix), "[%lld] %s: ", static_cast<long long>(slot.timestamp), GetLevelName(slot.level));
+			mOutput->write(prefix, length);
+			mOutput->write(slot.text, slot.length);
+			mOutput->put('\n');
+		}
+
+		void AsyncLogSink::Drain()
+		{
+			for (;;)
+			{
+				bool wroteAny = false;
+				uint64_t position = mDequeuePosition.load(std::memory_order_relaxed);
+				for (;;)
+				{
+					Slot& slot = mSlots[position & mMask];
+					if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+					{
+						break;
+					}
+
+					WriteSlot(slot);
+					slot.sequence.store(position + mMask + 1, std::memory_order_release);
+					mDequeuePosition.store(++position, std::memory_order_release);
+					wroteAny = true;
+				}
+
+				if (wroteAny)
+				{
+					mOutput->flush();
+					{
+						std::lock_guard<std::mutex> lock(mDrainMutex);
+					}
+					mFlushCondition.notify_all();
+				}
+
+				std::unique_lock<std::mutex> lock(mDrainMutex);
+				if (mStopping && mDequeuePosition.load(std::memory_order_relaxed) == mEnqueuePosition.load(std::memory_order_acquire))
+				{
+					mFlushCondition.notify_all();
+					return;
+				}
+				mDrainCondition.wait_for(lock, std::chrono::milliseconds(5));
+			}
+		}
+
+	} //  namespace utils
+} //  namespace sample
@@ -0,0 +1,127 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UTILS_ASYNC_LOG_SINK_H_
+#define SAMPLES_UTILS_ASYNC_LOG_SINK_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "mip/common_types.h"
+
+namespace sample {
+	namespace utils {
+
+		/**
+		 * @brief Application log sink that keeps I/O off the calling thread.
+		 * Messages are copied into a fixed-size, lock-free multi-producer ring buffer and written out by a background
+		 * thread. Writers never block: when the buffer is full the message is dropped and counted. Each call site is
+		 * rate limited so a hot message cannot flood the buffer.
+		 */
+		class AsyncLogSink final {
+		public:
+			struct Settings {
+				mip::LogLevel level = mip::LogLevel::Info;
+				size_t capacity = 8192;				// Number of messages the ring buffer holds, rounded up to a power of two
+				uint32_t maxMessagesPerSecond = 100;	// Per call site. Zero disables rate limiting.
+				std::string filePath;				// Log file. Empty writes to stdout.
+			};
+
+			explicit AsyncLogSink(const Settings& settings);
+			~AsyncLogSink();
+
+			AsyncLogSink(const AsyncLogSink&) = delete;
+			AsyncLogSink& operator=(const AsyncLogSink&) = delete;
+
+			void SetLevel(mip::LogLevel level) { mLevel.store(static_cast<int>(level), std::memory_order_relaxed); }
+			mip::LogLevel GetLevel() const { return static_cast<mip::LogLevel>(mLevel.load(std::memory_order_relaxed)); }
+			bool IsEnabled(mip::LogLevel level) const { return static_cast<int>(level) >= mLevel.load(std::memory_order_relaxed); }
+
+			// printf-style message. The format string's address identifies the call site for rate limiting.
+			void Log(mip::LogLevel level, const char* format, ...);
+
+			// Preformatted message. siteKey identifies the call site for rate limiting.
+			void Write(mip::LogLevel level, std::string_view message, uint64_t siteKey);
+
+			void Flush();	// Blocks until every message accepted so far has been written.
+
+			uint64_t GetDroppedCount() const { return mDropped.load(std::memory_order_relaxed); }
+			uint64_t GetSuppressedCount() const { return mSuppressed.load(std::memory_order_relaxed); }
+
+		private:
+			static constexpr size_t kMaxMessageLength = 512;
+			static constexpr size_t kRateLimitSites = 1024;
+
+			struct Slot {
+				std::atomic<uint64_t> sequence;
+				mip::LogLevel level;
+				uint32_t length;
+				int64_t timestamp;
+				char text[kMaxMessageLength];
+			};
+
+			struct RateLimitSite {
+				std::atomic<int64_t> window{ 0 };
+				std::atomic<uint32_t> count{ 0 };
+			};
+
+			bool AllowSite(uint64_t siteKey, int64_t nowSeconds);
+			void Drain();
+			void WriteSlot(const Slot& slot);
+
+			std::unique_ptr<Slot[]> mSlots;
+			size_t mMask;
+			alignas(64) std::atomic<uint64_t> mEnqueuePosition{ 0 };
+			alignas(64) std::atomic<uint64_t> mDequeuePosition{ 0 };
+			std::atomic<int> mLevel;
+			uint32_t mMaxMessagesPerSecond;
+			std::unique_ptr<RateLimitSite[]> mSites;
+			std::atomic<uint64_t> mDropped{ 0 };
+			std::atomic<uint64_t> mSuppressed{ 0 };
+
+			std::ofstream mFile;
+			std::ostream* mOutput;
+
+			std::mutex mDrainMutex;
+			std::condition_variable mDrainCondition;	// Signals the drain thread to wake up early
+			std::condition_variable mFlushCondition;	// Signals Flush() callers that the drain position advanced
+			bool mStopping = false;
+			std::thread mDrainThread;
+		};
+
+	} //  namespace utils
+} //  namespace sample
+
+#endif //  SAMPLES_UTILS_ASYNC_LOG_SINK_H_
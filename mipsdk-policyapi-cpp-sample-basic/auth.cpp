@@ -28,13 +28,16 @@
 #include "auth.h"
 #include "utils.h"
 
+#include <chrono>
 #include <fstream>
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 using std::string;
 using std::runtime_error;
+using std::vector;
 
 namespace sample {
 	namespace auth {
@@ -55,27 +58,38 @@ namespace sample {
 			const string& password,
 			const string& clientId,
 			const string& resource,
-			const string& authority) {
+			const string& authority,
+			std::chrono::milliseconds timeout,
+			const sample::utils::CancellationToken* cancellation) {
 
-			string cmd = "python";
+			string script;
 			if (sample::utils::FileExists("auth.py"))
-				cmd += " auth.py -u ";
+				script = "auth.py";
 			else if (sample::utils::FileExists("samples/auth/auth.py"))
-				cmd += " samples/auth/auth.py -u ";
+				script = "samples/auth/auth.py";
 			else
 				throw runtime_error("Unable to find auth script.");
 
-			cmd += username;
-			cmd += " -p ";
-			cmd += password;
-			cmd += " -a ";
-			cmd += authority;
-			cmd += " -r ";
-			cmd += resource;
-			cmd += " -c ";
-			cmd += clientId;
+			// Arguments are passed straight to the interpreter without a shell, so credentials need no quoting.
+			vector<string> args = {
+				"python", script,
+				"-u", username,
+				"-p", password,
+				"-a", authority,
+				"-r", resource,
+				"-c", clientId
+			};
 
-			string result = sample::utils::Execute(cmd.c_str());
+			// A hung auth script must not stall the caller indefinitely.
+			auto process = sample::utils::RunProcess(args, timeout, 4096, cancellation);
+			if (process.timedOut)
+				throw sample::utils::TimeoutError("Timed out acquiring token.");
+			if (process.cancelled)
+				throw sample::utils::CancelledError("Token acquisition was cancelled.");
+			if (process.exitCode != 0)
+				throw runtime_error("Failed to acquire token. Auth script exited with code " + std::to_string(process.exitCode) + ".");
+
+			string result = std::move(process.output);
 			if (result.empty())
 				throw runtime_error("Failed to acquire token. Ensure Python is installed correctly.");
 
@@ -83,8 +97,7 @@ namespace sample {
 			// The Python script uses print() which appends a newline. If this newline
 			// is included in the token string, WinHTTP will reject it with error 87
 			// (The parameter is incorrect) when setting the Authorization header.
-			auto lastNonWs = result.find_last_not_of(" 	
-");
+			auto lastNonWs = result.find_last_not_of(" \t\r\n");
 			result = (lastNonWs != std::string::npos) ? result.substr(0, lastNonWs + 1) : "";
 
 			return result;
@@ -26,8 +26,11 @@
 */
 
 
+#include <chrono>
 #include <string>
 
+#include "cancellation.h"
+
 namespace sample {
 	namespace auth {
 
@@ -38,6 +41,8 @@ namespace sample {
 			const std::string& password,
 			const std::string& clientId,
 			const std::string& resource,
-			const std::string& authority);
+			const std::string& authority,
+			std::chrono::milliseconds timeout = std::chrono::seconds(30),	// Throws utils::TimeoutError once passed
+			const utils::CancellationToken* cancellation = nullptr);		// Throws utils::CancelledError if fired
 	}
 }
@@ -45,10 +45,16 @@ namespace sample {
 		AuthDelegateImpl::AuthDelegateImpl(
 			const mip::ApplicationInfo& applicationInfo,
 			const std::string& username,
-			const std::string& password)
+			const std::string& password,
+			std::chrono::milliseconds tokenTimeout,
+			std::shared_ptr<const utils::CancellationToken> cancellation,
+			std::shared_ptr<utils::TraceRecorder> tracer)
 			: mApplicationInfo(applicationInfo),
 			  mUserName(username),
-			  mPassword(password) {
+			  mPassword(password),
+			  mTokenTimeout(tokenTimeout),
+			  mCancellation(std::move(cancellation)),
+			  mTracer(std::move(tracer)) {
 		}
 			
 		bool AuthDelegateImpl::AcquireOAuth2Token(
@@ -57,7 +63,20 @@ namespace sample {
 			OAuth2Token& token) {
 			
 			// call our AcquireToken function, passing in username, password, clientId, and getting the resource/authority from the OAuth2Challenge object
-			string accessToken = sample::auth::AcquireToken(mUserName, mPassword, mApplicationInfo.applicationId, challenge.GetResource(), challenge.GetAuthority());
+			// A fetch that misses its deadline or is cancelled fails the request instead of holding up the SDK.
+			string accessToken;
+			utils::TraceSpan span(mTracer.get(), "AcquireToken", true);
+			try {
+				accessToken = sample::auth::AcquireToken(mUserName, mPassword, mApplicationInfo.applicationId, challenge.GetResource(), challenge.GetAuthority(),
+					mTokenTimeout, mCancellation.get());
+			}
+			catch (const utils::TimeoutError&) {
+				++mTimeouts;
+				return false;
+			}
+			catch (const utils::CancelledError&) {
+				return false;
+			}
 
 			// string accessToken = sample::auth::AcquireToken();
 			token.SetAccessToken(accessToken);
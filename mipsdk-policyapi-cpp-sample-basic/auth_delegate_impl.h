@@ -29,9 +29,14 @@
 #ifndef SAMPLES_AUTH_AUTHDELEGATE_IMPL_H_
 #define SAMPLES_AUTH_AUTHDELEGATE_IMPL_H_
 
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
 
 #include "mip/common_types.h"
+#include "cancellation.h"
+#include "trace_recorder.h"
 
 namespace sample {
 	namespace auth {
@@ -46,15 +51,23 @@ namespace sample {
 			AuthDelegateImpl(
 				const mip::ApplicationInfo& applicationInfo,
 				const std::string& username,
-				const std::string& password);
+				const std::string& password,
+				std::chrono::milliseconds tokenTimeout = std::chrono::seconds(30),
+				std::shared_ptr<const utils::CancellationToken> cancellation = nullptr,
+				std::shared_ptr<utils::TraceRecorder> tracer = nullptr);
 						
 			bool AcquireOAuth2Token(const mip::Identity& identity, const OAuth2Challenge& challenge, OAuth2Token& token) override;
+			uint64_t GetTimeoutCount() const { return mTimeouts; }	// Token fetches abandoned at the deadline
 
 		private:
 			std::string mUserName;
 			std::string mPassword;
 			std::string mClientId;	
 			mip::ApplicationInfo mApplicationInfo;
+			std::chrono::milliseconds mTokenTimeout{ std::chrono::seconds(30) };
+			std::shared_ptr<const utils::CancellationToken> mCancellation;
+			std::shared_ptr<utils::TraceRecorder> mTracer;	// Token fetches are always traced, whichever request caused them
+			std::atomic<uint64_t> mTimeouts{ 0 };
 		};
 
 	} //  namespace sample
@@ -0,0 +1,125 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UTILS_BOUNDED_QUEUE_H_
+#define SAMPLES_UTILS_BOUNDED_QUEUE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace sample {
+	namespace utils {
+
+		/**
+		 * @brief Blocking multi-producer, multi-consumer queue with a fixed capacity.
+		 * Push blocks while the queue is full, which slows producers down to the rate consumers can sustain.
+		 * After Close, Push fails and Pop drains the remaining items before failing.
+		 */
+		template<typename T>
+		class BoundedQueue final {
+		public:
+			explicit BoundedQueue(size_t capacity) : mCapacity(capacity == 0 ? 1 : capacity) {}
+
+			BoundedQueue(const BoundedQueue&) = delete;
+			BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+			bool Push(T item)
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mNotFull.wait(lock, [this]() { return mClosed || mItems.size() < mCapacity; });
+				if (mClosed)
+				{
+					return false;
+				}
+				mItems.push_back(std::move(item));
+				lock.unlock();
+				mNotEmpty.notify_one();
+				return true;
+			}
+
+			// Non-blocking Push. Fails if the queue is full or closed, leaving item unchanged.
+			bool TryPush(T& item)
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				if (mClosed || mItems.size() >= mCapacity)
+				{
+					return false;
+				}
+				mItems.push_back(std::move(item));
+				lock.unlock();
+				mNotEmpty.notify_one();
+				return true;
+			}
+
+			bool Pop(T& item)
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mNotEmpty.wait(lock, [this]() { return mClosed || !mItems.empty(); });
+				if (mItems.empty())
+				{
+					return false;
+				}
+				item = std::move(mItems.front());
+				mItems.pop_front();
+				lock.unlock();
+				mNotFull.notify_one();
+				return true;
+			}
+
+			void Close()
+			{
+				{
+					std::lock_guard<std::mutex> lock(mMutex);
+					mClosed = true;
+				}
+				mNotFull.notify_all();
+				mNotEmpty.notify_all();
+			}
+
+			size_t Size() const
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				return mItems.size();
+			}
+
+		private:
+			const size_t mCapacity;
+			mutable std::mutex mMutex;
+			std::condition_variable mNotFull;
+			std::condition_variable mNotEmpty;
+			std::deque<T> mItems;
+			bool mClosed = false;
+		};
+
+	} //  namespace utils
+} //  namespace sample
+
+#endif //  SAMPLES_UTILS_BOUNDED_QUEUE_H_
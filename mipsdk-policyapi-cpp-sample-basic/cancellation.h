@@ -0,0 +1,109 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UTILS_CANCELLATION_H_
+#define SAMPLES_UTILS_CANCELLATION_H_
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <string>
+
+namespace sample {
+	namespace utils {
+
+		class TimeoutError final : public std::runtime_error {
+		public:
+			using std::runtime_error::runtime_error;
+		};
+
+		class CancelledError final : public std::runtime_error {
+		public:
+			using std::runtime_error::runtime_error;
+		};
+
+		/**
+		 * @brief Flag that callers set to abandon outstanding work.
+		 * Waits that take a token give up soon after Cancel() and throw CancelledError. Work that has already been handed
+		 * to the SDK keeps running in the background; only the wait for it is abandoned.
+		 */
+		class CancellationToken final {
+		public:
+			void Cancel() { mCancelled.store(true, std::memory_order_release); }
+			bool IsCancelled() const { return mCancelled.load(std::memory_order_acquire); }
+
+		private:
+			std::atomic<bool> mCancelled{ false };
+		};
+
+		// How often waits check the cancellation token.
+		const std::chrono::milliseconds kCancellationPollInterval(50);
+
+		// Waits for future to become ready and returns its value. A zero timeout waits without a deadline.
+		// Throws TimeoutError once timeout has passed and CancelledError if cancellation fires first.
+		template<typename T>
+		T WaitForFuture(std::future<T>& future, std::chrono::milliseconds timeout, const CancellationToken* cancellation, const char* operation)
+		{
+			if (timeout.count() <= 0 && cancellation == nullptr)
+			{
+				return future.get();
+			}
+
+			auto deadline = std::chrono::steady_clock::now() + timeout;
+			for (;;)
+			{
+				if (cancellation != nullptr && cancellation->IsCancelled())
+				{
+					throw CancelledError(std::string(operation) + " was cancelled");
+				}
+
+				auto wait = cancellation != nullptr ? kCancellationPollInterval : timeout;
+				if (timeout.count() > 0)
+				{
+					auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+					if (remaining.count() <= 0)
+					{
+						throw TimeoutError(std::string(operation) + " timed out after " + std::to_string(timeout.count()) + " ms");
+					}
+					if (remaining < wait)
+					{
+						wait = remaining;
+					}
+				}
+				if (future.wait_for(wait) == std::future_status::ready)
+				{
+					return future.get();
+				}
+			}
+		}
+
+	} //  namespace utils
+} //  namespace sample
+
+#endif //  SAMPLES_UTILS_CANCELLATION_H_
@@ -0,0 +1,391 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "classification_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <tuple>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+	const char kCacheMagic[8] = { 'M', 'I', 'P', 'C', 'L', 'C', '1', '\0' };
+	const char kFileRecord = 'F';
+	const char kContentRecord = 'C';
+	const size_t kFlushThreshold = 64 * 1024;
+	const uint64_t kMinCompactRecords = 4096;	// Smaller logs aren't checked for compaction
+
+	template<typename T>
+	void Append(string& buffer, const T& value)
+	{
+		buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	template<typename T>
+	bool Read(const char*& cursor, const char* end, T& value)
+	{
+		if (static_cast<size_t>(end - cursor) < sizeof(value))
+		{
+			return false;
+		}
+		std::memcpy(&value, cursor, sizeof(value));
+		cursor += sizeof(value);
+		return true;
+	}
+
+	bool TruncateFile(const string& path, uint64_t size)
+	{
+#if defined(_WIN32) || defined(_WIN64)
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		LARGE_INTEGER position;
+		position.QuadPart = static_cast<LONGLONG>(size);
+		bool truncated = SetFilePointerEx(file, position, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+		CloseHandle(file);
+		return truncated;
+#else
+		return truncate(path.c_str(), static_cast<off_t>(size)) == 0;
+#endif
+	}
+
+	bool ReplaceFile(const string& from, const string& to)
+	{
+#if defined(_WIN32) || defined(_WIN64)
+		return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+	}
+}
+
+namespace sample {
+	namespace policy {
+
+		ClassificationCache::ClassificationCache(const string& path, std::shared_ptr<utils::MemoryAccount> memory)
+			: mPath(path),
+			mMemory(std::move(memory)),
+			mFiles(0, FileKeyHash(), std::equal_to<FileKey>(), FileTable::allocator_type(mMemory.get())),
+			mContent(0, ContentKeyHash(), std::equal_to<ContentKey>(), ContentTable::allocator_type(mMemory.get())),
+			mCompactCheckAt(kMinCompactRecords)
+		{
+			Load();
+		}
+
+		ClassificationCache::~ClassificationCache()
+		{
+			try
+			{
+				Flush();
+			}
+			catch (...)
+			{
+			}
+		}
+
+		// Replays the log. A torn trailing record (for example after a crash) ends the replay; everything before it is
+		// kept and the file is cut back to the last complete record, so later appends follow it. A file with the wrong
+		// header is discarded and rewritten on the next flush.
+		void ClassificationCache::Load()
+		{
+			utils::MappedFile file;
+			try
+			{
+				file = utils::MappedFile(mPath);
+			}
+			catch (const std::exception&)
+			{
+				mPending.assign(kCacheMagic, sizeof(kCacheMagic));
+				return;
+			}
+
+			const char* cursor = file.GetData();
+			const char* end = cursor + file.GetSize();
+			if (file.GetSize() < sizeof(kCacheMagic) || std::memcmp(cursor, kCacheMagic, sizeof(kCacheMagic)) != 0)
+			{
+				std::remove(mPath.c_str());
+				mPending.assign(kCacheMagic, sizeof(kCacheMagic));
+				return;
+			}
+			cursor += sizeof(kCacheMagic);
+
+			const char* recordEnd = cursor;
+			while (cursor < end)
+			{
+				char tag = *cursor++;
+				if (tag == kFileRecord)
+				{
+					FileKey key;
+					FileEntry entry;
+					if (!Read(cursor, end, key) || !Read(cursor, end, entry))
+					{
+						break;
+					}
+					mFiles[key] = entry;
+				}
+				else if (tag == kContentRecord)
+				{
+					ContentKey key;
+					uint32_t count;
+					if (!Read(cursor, end, key) || !Read(cursor, end, count) || static_cast<size_t>(end - cursor) < count * sizeof(uint32_t))
+					{
+						break;
+					}
+					auto& counts = mContent[key];
+					counts.resize(count);
+					std::memcpy(counts.data(), cursor, count * sizeof(uint32_t));
+					cursor += count * sizeof(uint32_t);
+				}
+				else
+				{
+					break;
+				}
+				recordEnd = cursor;
+				++mLogRecords;
+			}
+
+			auto validSize = static_cast<uint64_t>(recordEnd - file.GetData());
+			bool torn = recordEnd != end;
+			file = utils::MappedFile();
+
+			if (CompactIfSparse())
+			{
+				return;
+			}
+			if (torn && !TruncateFile(mPath, validSize))
+			{
+				// Appending after the torn record would hide every later record from the next replay.
+				std::remove(mPath.c_str());
+				mPending.assign(kCacheMagic, sizeof(kCacheMagic));
+				mLogRecords = 0;
+			}
+		}
+
+		bool ClassificationCache::FindContent(const ContentKey& key, vector<uint32_t>& counts) const
+		{
+			auto it = mContent.find(key);
+			if (it == mContent.end())
+			{
+				return false;
+			}
+			counts.assign(it->second.begin(), it->second.end());
+			return true;
+		}
+
+		bool ClassificationCache::LookupFile(const utils::FileIdentity& identity, uint64_t ruleSetVersion, vector<uint32_t>& counts)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			auto file = mFiles.find({ identity.device, identity.inode });
+			if (file == mFiles.end() || file->second.size != identity.size || file->second.modifiedTime != identity.modifiedTime)
+			{
+				return false;
+			}
+			if (!FindContent({ file->second.contentHash, ruleSetVersion }, counts))
+			{
+				return false;
+			}
+			mFileHits.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		bool ClassificationCache::LookupContent(uint64_t contentHash, uint64_t ruleSetVersion, vector<uint32_t>& counts)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (!FindContent({ contentHash, ruleSetVersion }, counts))
+			{
+				return false;
+			}
+			mContentHits.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		void ClassificationCache::StoreFile(const utils::FileIdentity& identity, uint64_t contentHash)
+		{
+			FileKey key = { identity.device, identity.inode };
+			FileEntry entry = { identity.size, identity.modifiedTime, contentHash };
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			mFiles[key] = entry;
+			mPending += kFileRecord;
+			Append(mPending, key);
+			Append(mPending, entry);
+			++mLogRecords;
+			if (mPending.size() >= kFlushThreshold)
+			{
+				WritePending();
+			}
+		}
+
+		void ClassificationCache::StoreContent(uint64_t contentHash, uint64_t ruleSetVersion, const vector<uint32_t>& counts)
+		{
+			ContentKey key = { contentHash, ruleSetVersion };
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (!mContent.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(counts.begin(), counts.end())).second)
+			{
+				return;
+			}
+			mPending += kContentRecord;
+			Append(mPending, key);
+			Append(mPending, static_cast<uint32_t>(counts.size()));
+			mPending.append(reinterpret_cast<const char*>(counts.data()), counts.size() * sizeof(uint32_t));
+			++mLogRecords;
+			if (mPending.size() >= kFlushThreshold)
+			{
+				WritePending();
+			}
+		}
+
+		void ClassificationCache::Flush()
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (!mPending.empty())
+			{
+				WritePending();
+			}
+		}
+
+		void ClassificationCache::ReleaseMemory()
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			FileTable(0, FileKeyHash(), std::equal_to<FileKey>(), mFiles.get_allocator()).swap(mFiles);
+			ContentTable(0, ContentKeyHash(), std::equal_to<ContentKey>(), mContent.get_allocator()).swap(mContent);
+			mReleased = true;
+		}
+
+		// Caller holds mMutex. Records stay pending if the write fails and are retried on the next flush.
+		void ClassificationCache::WritePending()
+		{
+			if (CompactIfSparse())
+			{
+				return;
+			}
+
+			std::ofstream file(mPath, std::ios::binary | std::ios::app);
+			file.write(mPending.data(), mPending.size());
+			if (file)
+			{
+				mPending.clear();
+			}
+		}
+
+		// Caller holds mMutex, or is Load. Counting the records in use is linear, so it is only repeated once the log has
+		// doubled since the last count.
+		bool ClassificationCache::CompactIfSparse()
+		{
+			if (mReleased || mLogRecords < mCompactCheckAt)
+			{
+				return false;
+			}
+
+			std::unordered_set<uint64_t> referenced;
+			for (const auto& file : mFiles)
+			{
+				referenced.insert(file.second.contentHash);
+			}
+			uint64_t liveRecords = mFiles.size();
+			for (const auto& content : mContent)
+			{
+				liveRecords += referenced.count(content.first.contentHash);
+			}
+
+			mCompactCheckAt = std::max(kMinCompactRecords, 2 * liveRecords);
+			return mLogRecords > 2 * liveRecords && Compact(referenced);
+		}
+
+		// Caller holds mMutex, or is Load. Writes the tables to a temporary file that replaces the log, so a crash leaves
+		// one complete log or the other. Pending records are part of the tables, so they are written too.
+		bool ClassificationCache::Compact(const std::unordered_set<uint64_t>& referenced)
+		{
+			string records(kCacheMagic, sizeof(kCacheMagic));
+			uint64_t recordCount = 0;
+			for (const auto& file : mFiles)
+			{
+				records += kFileRecord;
+				Append(records, file.first);
+				Append(records, file.second);
+				++recordCount;
+			}
+			for (const auto& content : mContent)
+			{
+				if (referenced.count(content.first.contentHash) == 0)
+				{
+					continue;
+				}
+				records += kContentRecord;
+				Append(records, content.first);
+				Append(records, static_cast<uint32_t>(content.second.size()));
+				records.append(reinterpret_cast<const char*>(content.second.data()), content.second.size() * sizeof(uint32_t));
+				++recordCount;
+			}
+
+			string tempPath = mPath + ".tmp";
+			{
+				std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+				file.write(records.data(), records.size());
+				if (!file)
+				{
+					file.close();
+					std::remove(tempPath.c_str());
+					return false;
+				}
+			}
+			if (!ReplaceFile(tempPath, mPath))
+			{
+				std::remove(tempPath.c_str());
+				return false;
+			}
+			mPending.clear();
+			mLogRecords = recordCount;
+			return true;
+		}
+
+		ClassificationCache::Stats ClassificationCache::GetStats() const
+		{
+			return {
+				mFileHits.load(std::memory_order_relaxed),
+				mContentHits.load(std::memory_order_relaxed),
+				mMisses.load(std::memory_order_relaxed)
+			};
+		}
+
+	} //  namespace policy
+} //  namespace sample
@@ -0,0 +1,139 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_CLASSIFICATION_CACHE_H_
+#define SAMPLES_UPE_CLASSIFICATION_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <scoped_allocator>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "content_hash.h"
+#include "memory_accounting.h"
+
+namespace sample {
+	namespace policy {
+
+		/**
+		 * @brief Persistent cache of classifier results.
+		 * Results are keyed by content hash and classifier rule-set version, so identical copies of a file share one
+		 * entry and a rule change invalidates everything. A second table maps file identity (device, inode, size,
+		 * modification time) to the content hash, so an unchanged file is recognized without reading it.
+		 * The file is an append-only log of both tables, replayed on construction. A torn trailing record is cut off
+		 * before anything is appended. Once the log holds more than twice the records still in use, it is rewritten from
+		 * the tables, leaving out superseded file records and results no remembered file refers to. Thread safe.
+		 */
+		class ClassificationCache final {
+		public:
+			struct Stats {
+				uint64_t fileHits;		// Answered from file identity, no content read
+				uint64_t contentHits;	// Content hashed and found
+				uint64_t misses;		// Content had to be scanned
+			};
+
+			explicit ClassificationCache(const std::string& path, std::shared_ptr<utils::MemoryAccount> memory = nullptr);	// Tables are charged to memory
+			~ClassificationCache();
+
+			ClassificationCache(const ClassificationCache&) = delete;
+			ClassificationCache& operator=(const ClassificationCache&) = delete;
+
+			bool LookupFile(const utils::FileIdentity& identity, uint64_t ruleSetVersion, std::vector<uint32_t>& counts);
+			bool LookupContent(uint64_t contentHash, uint64_t ruleSetVersion, std::vector<uint32_t>& counts);
+			void StoreFile(const utils::FileIdentity& identity, uint64_t contentHash);
+			void StoreContent(uint64_t contentHash, uint64_t ruleSetVersion, const std::vector<uint32_t>& counts);
+			void RecordMiss() { mMisses.fetch_add(1, std::memory_order_relaxed); }
+
+			void Flush();	// Appends new entries to the cache file
+			void ReleaseMemory();	// Drop the in-memory tables. Entries stay in the file for the next process.
+			Stats GetStats() const;
+
+		private:
+			struct FileKey {
+				uint64_t device;
+				uint64_t inode;
+				bool operator==(const FileKey& other) const { return device == other.device && inode == other.inode; }
+			};
+
+			struct FileKeyHash {
+				size_t operator()(const FileKey& key) const { return static_cast<size_t>(key.device * 0x9E3779B97F4A7C15ULL ^ key.inode); }
+			};
+
+			struct FileEntry {
+				uint64_t size;
+				int64_t modifiedTime;
+				uint64_t contentHash;
+			};
+
+			struct ContentKey {
+				uint64_t contentHash;
+				uint64_t ruleSetVersion;
+				bool operator==(const ContentKey& other) const { return contentHash == other.contentHash && ruleSetVersion == other.ruleSetVersion; }
+			};
+
+			struct ContentKeyHash {
+				size_t operator()(const ContentKey& key) const { return static_cast<size_t>(key.contentHash ^ (key.ruleSetVersion * 0x9E3779B97F4A7C15ULL)); }
+			};
+
+			void Load();
+			void WritePending();
+			bool CompactIfSparse();
+			bool Compact(const std::unordered_set<uint64_t>& referenced);
+			bool FindContent(const ContentKey& key, std::vector<uint32_t>& counts) const;
+
+			std::string mPath;
+			std::shared_ptr<utils::MemoryAccount> mMemory;	// Declared before the tables, which release into it
+			mutable std::mutex mMutex;
+			typedef std::vector<uint32_t, utils::CountingAllocator<uint32_t>> Counts;
+			typedef std::unordered_map<FileKey, FileEntry, FileKeyHash, std::equal_to<FileKey>,
+				utils::CountingAllocator<std::pair<const FileKey, FileEntry>>> FileTable;
+			typedef std::unordered_map<ContentKey, Counts, ContentKeyHash, std::equal_to<ContentKey>,
+				std::scoped_allocator_adaptor<utils::CountingAllocator<std::pair<const ContentKey, Counts>>>> ContentTable;
+
+			FileTable mFiles;
+			ContentTable mContent;
+			std::string mPending;	// Serialized records not yet appended to the file
+			uint64_t mLogRecords = 0;	// Records in the file and in mPending
+			uint64_t mCompactCheckAt;	// mLogRecords at which the log is next checked for compaction
+			bool mReleased = false;		// Tables were dropped, so they can't be used to compact the log
+
+			std::atomic<uint64_t> mFileHits{ 0 };
+			std::atomic<uint64_t> mContentHits{ 0 };
+			std::atomic<uint64_t> mMisses{ 0 };
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_CLASSIFICATION_CACHE_H_
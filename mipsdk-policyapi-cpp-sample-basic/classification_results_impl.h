@@ -0,0 +1,75 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_CLASSIFICATION_RESULTS_IMPL_H_
+#define SAMPLES_UPE_CLASSIFICATION_RESULTS_IMPL_H_
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "mip/upe/classification_result.h"
+
+namespace sample {
+	namespace policy {
+
+		class ClassificationResultImpl final : public mip::ClassificationResult {
+		public:
+			ClassificationResultImpl(const std::string& id, int count, int confidenceLevel)
+				: mId(id), mCount(count), mConfidenceLevel(confidenceLevel) {}
+
+			std::string GetId() const override { return mId; }
+			int GetCount() const override { return mCount; }
+			int GetConfidenceLevel() const override { return mConfidenceLevel; }
+
+		private:
+			std::string mId;
+			int mCount;
+			int mConfidenceLevel;
+		};
+
+		/**
+		 * @brief Holds the results of the local classifier for the classification IDs the SDK requested.
+		 */
+		class ClassificationResultsImpl final : public mip::ClassificationResults {
+		public:
+			void AddResult(const std::string& id, int count, int confidenceLevel) override
+			{
+				mResults[id] = std::make_shared<ClassificationResultImpl>(id, count, confidenceLevel);
+			}
+
+			std::map<std::string, std::shared_ptr<mip::ClassificationResult>> GetResults() const override { return mResults; }
+
+		private:
+			std::map<std::string, std::shared_ptr<mip::ClassificationResult>> mResults;
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_CLASSIFICATION_RESULTS_IMPL_H_
@@ -0,0 +1,657 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "classifier.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+
+#include "content_hash.h"
+
+using std::runtime_error;
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace {
+	const uint32_t kNoState = UINT32_MAX;
+	const uint32_t kHasMatches = 0x80000000u;
+
+	unsigned char FoldCase(unsigned char c)
+	{
+		return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+	}
+
+	bool IsWordByte(unsigned char c)
+	{
+		return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+	}
+
+	string Trim(const string& value)
+	{
+		auto first = value.find_first_not_of(" \t\r\n");
+		if (first == string::npos)
+		{
+			return string();
+		}
+		auto last = value.find_last_not_of(" \t\r\n");
+		return value.substr(first, last - first + 1);
+	}
+
+	// Longest run of characters that every match of an ECMAScript pattern contains, or empty if there is none that is
+	// easy to prove: the pattern has a top-level alternation, or only classes, groups and optional characters.
+	string RequiredLiteral(const string& pattern)
+	{
+		string best;
+		string run;
+		bool lastWasLiteral = false;
+		auto endRun = [&]() {
+			if (run.size() > best.size())
+			{
+				best = run;
+			}
+			run.clear();
+			lastWasLiteral = false;
+		};
+
+		for (size_t i = 0; i < pattern.size(); ++i)
+		{
+			char c = pattern[i];
+			if (c == '|' || c == ')')
+			{
+				return string();
+			}
+			else if (c == '?' || c == '*' || c == '+' || c == '{')
+			{
+				// A quantifier ends the run. The character it applies to is dropped when it may occur zero times.
+				bool optional = c == '?' || c == '*' || (c == '{' && i + 1 < pattern.size() && pattern[i + 1] == '0');
+				if (c == '{')
+				{
+					i = pattern.find('}', i);
+					if (i == string::npos)
+					{
+						return string();
+					}
+				}
+				if (optional && lastWasLiteral)
+				{
+					run.pop_back();
+				}
+				endRun();
+				if (i + 1 < pattern.size() && pattern[i + 1] == '?')
+				{
+					++i;
+				}
+			}
+			else if (c == '\\' && i + 1 < pattern.size())
+			{
+				// Escaped punctuation is literal. Escaped letters and digits are classes, assertions, character codes or
+				// back references. The operands of \xHH, \uHHHH and \cX, and the digits of a back reference, aren't
+				// literal text either.
+				char escaped = pattern[++i];
+				if (std::isalnum(static_cast<unsigned char>(escaped)))
+				{
+					size_t operands = escaped == 'x' ? 2 : escaped == 'u' ? 4 : escaped == 'c' ? 1 : 0;
+					i = std::min(i + operands, pattern.size() - 1);
+					if (std::isdigit(static_cast<unsigned char>(escaped)))
+					{
+						while (i + 1 < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[i + 1])))
+						{
+							++i;
+						}
+					}
+					endRun();
+				}
+				else
+				{
+					run += escaped;
+					lastWasLiteral = true;
+				}
+			}
+			else if (c == '[' || c == '(')
+			{
+				// Skip the class or group, including nested groups and escaped brackets.
+				int depth = 0;
+				bool inClass = false;
+				for (; i < pattern.size(); ++i)
+				{
+					if (pattern[i] == '\\')
+					{
+						++i;
+					}
+					else if (inClass)
+					{
+						inClass = pattern[i] != ']';
+					}
+					else if (pattern[i] == '[')
+					{
+						inClass = true;
+						if (i + 1 < pattern.size() && pattern[i + 1] == '^')
+						{
+							++i;
+						}
+						if (i + 1 < pattern.size() && pattern[i + 1] == ']')
+						{
+							++i;
+						}
+					}
+					else if (pattern[i] == '(')
+					{
+						++depth;
+					}
+					else if (pattern[i] == ')')
+					{
+						--depth;
+					}
+					if (!inClass && depth == 0)
+					{
+						break;
+					}
+				}
+				if (i >= pattern.size())
+				{
+					return string();
+				}
+				endRun();
+			}
+			else if (c == '.' || c == '^' || c == '$')
+			{
+				endRun();
+			}
+			else
+			{
+				run += c;
+				lastWasLiteral = true;
+			}
+		}
+		endRun();
+		return best;
+	}
+}
+
+namespace sample {
+	namespace policy {
+
+		Classifier::Classifier(vector<SensitiveInfoType> types) : mTypes(std::move(types))
+		{
+			Compile();
+		}
+
+		std::shared_ptr<Classifier> Classifier::LoadFromFile(const string& path)
+		{
+			std::ifstream file(path);
+			if (!file)
+			{
+				throw runtime_error("Unable to open classifier rules " + path);
+			}
+
+			vector<SensitiveInfoType> types;
+			string line;
+			int lineNumber = 0;
+			while (std::getline(file, line))
+			{
+				++lineNumber;
+				line = Trim(line);
+				if (line.empty() || line[0] == '#')
+				{
+					continue;
+				}
+
+				auto separator = line.find_first_of(" \t");
+				string directive = line.substr(0, separator);
+				string argument = separator == string::npos ? string() : Trim(line.substr(separator));
+				if (argument.empty())
+				{
+					throw runtime_error(path + ":" + std::to_string(lineNumber) + ": missing argument");
+				}
+
+				if (directive == "type")
+				{
+					SensitiveInfoType type;
+					std::istringstream fields(argument);
+					fields >> type.id;
+					if (!(fields >> type.confidenceLevel))
+					{
+						type.confidenceLevel = 75;
+					}
+					types.push_back(std::move(type));
+				}
+				else if (types.empty())
+				{
+					throw runtime_error(path + ":" + std::to_string(lineNumber) + ": " + directive + " before first type");
+				}
+				else if (directive == "keyword")
+				{
+					types.back().keywords.push_back(argument);
+				}
+				else if (directive == "pattern")
+				{
+					types.back().patterns.push_back(argument);
+				}
+				else
+				{
+					throw runtime_error(path + ":" + std::to_string(lineNumber) + ": unknown directive " + directive);
+				}
+			}
+
+			return std::make_shared<Classifier>(std::move(types));
+		}
+
+		void Classifier::Compile()
+		{
+			// Keywords and the required literals of patterns share one automaton. A literal only marks where its
+			// pattern's regular expression has to run.
+			vector<Match> entries;
+			vector<const string*> entryText;
+			for (uint32_t typeIndex = 0; typeIndex < mTypes.size(); ++typeIndex)
+			{
+				for (const auto& keyword : mTypes[typeIndex].keywords)
+				{
+					entries.push_back({ typeIndex, static_cast<uint32_t>(keyword.size()), -1 });
+					entryText.push_back(&keyword);
+				}
+			}
+
+			mPatterns.clear();
+			vector<string> literals;
+			for (uint32_t typeIndex = 0; typeIndex < mTypes.size(); ++typeIndex)
+			{
+				for (const auto& pattern : mTypes[typeIndex].patterns)
+				{
+					literals.push_back(RequiredLiteral(pattern));
+					mPatterns.push_back({ typeIndex, std::regex(pattern, std::regex::ECMAScript | std::regex::optimize), !literals.back().empty() });
+				}
+			}
+			for (size_t patternIndex = 0; patternIndex < mPatterns.size(); ++patternIndex)
+			{
+				if (mPatterns[patternIndex].hasLiteral)
+				{
+					entries.push_back({ mPatterns[patternIndex].typeIndex, static_cast<uint32_t>(literals[patternIndex].size()), static_cast<int32_t>(patternIndex) });
+					entryText.push_back(&literals[patternIndex]);
+				}
+			}
+
+			// Assign an alphabet index to each (case folded) byte used by an entry. Every other byte shares class 0,
+			// which keeps the transition table small enough to stay in cache.
+			std::memset(mByteClass, 0, sizeof(mByteClass));
+			std::memset(mStartByte, 0, sizeof(mStartByte));
+			for (const string* text : entryText)
+			{
+				for (unsigned char c : *text)
+				{
+					unsigned char folded = FoldCase(c);
+					if (mByteClass[folded] == 0)
+					{
+						if (mClassCount == 256)
+						{
+							throw runtime_error("Classifier keywords use too many distinct bytes");
+						}
+						mByteClass[folded] = static_cast<uint8_t>(mClassCount++);
+					}
+				}
+			}
+			for (int c = 'A'; c <= 'Z'; ++c)
+			{
+				mByteClass[c] = mByteClass[FoldCase(static_cast<unsigned char>(c))];
+			}
+
+			// Build the trie.
+			mTransitions.assign(mClassCount, kNoState);
+			vector<vector<Match>> outputs(1);
+			for (size_t entry = 0; entry < entries.size(); ++entry)
+			{
+				if (entryText[entry]->empty())
+				{
+					continue;
+				}
+
+				uint32_t state = 0;
+				for (unsigned char c : *entryText[entry])
+				{
+					uint32_t& next = mTransitions[state * mClassCount + mByteClass[c]];
+					if (next == kNoState)
+					{
+						next = static_cast<uint32_t>(outputs.size());
+						outputs.emplace_back();
+						mTransitions.resize(mTransitions.size() + mClassCount, kNoState);
+					}
+					state = mTransitions[state * mClassCount + mByteClass[c]];
+				}
+				outputs[state].push_back(entries[entry]);
+			}
+
+			// Breadth-first pass computes failure links and turns the trie into a complete DFA.
+			vector<uint32_t> failure(outputs.size(), 0);
+			std::queue<uint32_t> pending;
+			for (uint32_t c = 0; c < mClassCount; ++c)
+			{
+				uint32_t& next = mTransitions[c];
+				if (next == kNoState)
+				{
+					next = 0;
+				}
+				else
+				{
+					failure[next] = 0;
+					pending.push(next);
+				}
+			}
+			while (!pending.empty())
+			{
+				uint32_t state = pending.front();
+				pending.pop();
+				for (uint32_t c = 0; c < mClassCount; ++c)
+				{
+					uint32_t next = mTransitions[state * mClassCount + c];
+					uint32_t fallback = mTransitions[failure[state] * mClassCount + c];
+					if (next == kNoState)
+					{
+						mTransitions[state * mClassCount + c] = fallback;
+					}
+					else
+					{
+						failure[next] = fallback;
+						outputs[next].insert(outputs[next].end(), outputs[fallback].begin(), outputs[fallback].end());
+						pending.push(next);
+					}
+				}
+			}
+
+			mMatchOffsets.clear();
+			mMatches.clear();
+			for (const auto& output : outputs)
+			{
+				mMatchOffsets.push_back(static_cast<uint32_t>(mMatches.size()));
+				mMatches.insert(mMatches.end(), output.begin(), output.end());
+			}
+			mMatchOffsets.push_back(static_cast<uint32_t>(mMatches.size()));
+
+			if (static_cast<uint64_t>(outputs.size()) * mClassCount >= kHasMatches)
+			{
+				throw runtime_error("Classifier keyword set is too large");
+			}
+
+			// Store transitions as row offsets with a flag on states that report matches, so the scan loop needs
+			// neither a multiply nor a match table lookup for most bytes.
+			for (auto& next : mTransitions)
+			{
+				uint32_t target = next;
+				next = target * mClassCount;
+				if (mMatchOffsets[target] != mMatchOffsets[target + 1])
+				{
+					next |= kHasMatches;
+				}
+			}
+
+			int startByteCount = 0;
+			for (int c = 0; c < 256; ++c)
+			{
+				if (mByteClass[c] != 0 && (mTransitions[mByteClass[c]] & ~kHasMatches) != 0)
+				{
+					mStartByte[c] = true;
+					mSingleStartByte = c;
+					++startByteCount;
+				}
+			}
+			if (startByteCount != 1)
+			{
+				mSingleStartByte = -1;
+			}
+
+			// Rule-set version: hash of a canonical serialization of every type, in order. The leading tag changes when
+			// the way rules are applied changes, so cached results from an older classifier aren't reused.
+			string serialized = "classifier 2\n";
+			for (const auto& type : mTypes)
+			{
+				serialized += "type\n" + type.id + "\n" + std::to_string(type.confidenceLevel) + "\n";
+				for (const auto& keyword : type.keywords)
+				{
+					serialized += "keyword\n" + keyword + "\n";
+				}
+				for (const auto& pattern : type.patterns)
+				{
+					serialized += "pattern\n" + pattern + "\n";
+				}
+			}
+			mRuleSetVersion = utils::HashContent(serialized.data(), serialized.size());
+		}
+
+		void Classifier::ScanKeywords(const unsigned char* data, size_t size, size_t countFrom, size_t countTo, vector<uint32_t>& counts,
+			vector<PatternHit>& hits) const
+		{
+			if (mMatches.empty())
+			{
+				return;
+			}
+
+			uint32_t row = 0;
+			size_t i = 0;
+			size_t end = std::min(size, countTo);
+			while (i < end)
+			{
+				if (row == 0)
+				{
+					// Prefilter: at the root, jump straight to the next byte that can begin a keyword.
+					if (mSingleStartByte >= 0)
+					{
+						auto next = static_cast<const unsigned char*>(std::memchr(data + i, mSingleStartByte, end - i));
+						if (next == nullptr)
+						{
+							return;
+						}
+						i = static_cast<size_t>(next - data);
+					}
+					else
+					{
+						while (i < end && !mStartByte[data[i]])
+						{
+							++i;
+						}
+						if (i == end)
+						{
+							return;
+						}
+					}
+				}
+
+				uint32_t next = mTransitions[row + mByteClass[data[i]]];
+				row = next & ~kHasMatches;
+				if (next & kHasMatches)
+				{
+					uint32_t state = row / mClassCount;
+					for (uint32_t m = mMatchOffsets[state]; m < mMatchOffsets[state + 1]; ++m)
+					{
+						// A pattern's match may end after countFrom even if its literal doesn't, so every literal is reported.
+						if (mMatches[m].patternIndex >= 0)
+						{
+							hits.push_back({ static_cast<uint32_t>(mMatches[m].patternIndex), i + 1, mMatches[m].length });
+							continue;
+						}
+						if (i + 1 <= countFrom)
+						{
+							continue;
+						}
+
+						// Keywords only count as whole words, so "ssn" does not match inside "lessness".
+						size_t start = i + 1 - mMatches[m].length;
+						bool boundedLeft = start == 0 || !IsWordByte(data[start]) || !IsWordByte(data[start - 1]);
+						bool boundedRight = i + 1 == size || !IsWordByte(data[i]) || !IsWordByte(data[i + 1]);
+						if (boundedLeft && boundedRight)
+						{
+							++counts[mMatches[m].typeIndex];
+						}
+					}
+				}
+				++i;
+			}
+		}
+
+		void Classifier::Scan(const char* data, size_t size, vector<uint32_t>& counts) const
+		{
+			Scan(data, size, 0, size, counts);
+		}
+
+		void Classifier::Scan(const char* data, size_t size, size_t countFrom, size_t countTo, vector<uint32_t>& counts) const
+		{
+			if (counts.size() < mTypes.size())
+			{
+				counts.resize(mTypes.size(), 0);
+			}
+
+			vector<PatternHit> hits;
+			ScanKeywords(reinterpret_cast<const unsigned char*>(data), size, countFrom, countTo, counts, hits);
+			if (!mPatterns.empty())
+			{
+				ScanPatterns(data, size, countFrom, countTo, hits, counts);
+			}
+		}
+
+		void Classifier::ScanPatterns(const char* data, size_t size, size_t countFrom, size_t countTo, vector<PatternHit>& hits,
+			vector<uint32_t>& counts) const
+		{
+			// Only matches ending in (countFrom, countTo] are counted, and none is longer than kMaxPatternMatchLength.
+			size_t low = countFrom > kMaxPatternMatchLength ? countFrom - kMaxPatternMatchLength : 0;
+			size_t high = std::min(size, countTo);
+
+			// Hits arrive in order of their end; the stable sort keeps that order within each pattern.
+			std::stable_sort(hits.begin(), hits.end(), [](const PatternHit& left, const PatternHit& right) {
+				return left.patternIndex < right.patternIndex;
+			});
+
+			auto hit = hits.begin();
+			for (uint32_t patternIndex = 0; patternIndex < mPatterns.size(); ++patternIndex)
+			{
+				const auto& pattern = mPatterns[patternIndex];
+				size_t searchFrom = 0;
+				if (!pattern.hasLiteral)
+				{
+					SearchPattern(pattern, data, size, low, high, countFrom, searchFrom, counts);
+					continue;
+				}
+
+				// A match contains the literal, so it lies within kMaxPatternMatchLength of the hit on either side.
+				// Overlapping ranges are merged, so dense hits don't search the same bytes again.
+				size_t rangeFrom = 0;
+				size_t rangeTo = 0;
+				for (; hit != hits.end() && hit->patternIndex == patternIndex; ++hit)
+				{
+					size_t from = std::max(low, hit->end > kMaxPatternMatchLength ? hit->end - kMaxPatternMatchLength : 0);
+					size_t to = std::min(high, hit->end - hit->length + kMaxPatternMatchLength);
+					if (from >= to)
+					{
+						continue;
+					}
+					if (rangeTo > rangeFrom && from <= rangeTo)
+					{
+						rangeTo = std::max(rangeTo, to);
+						continue;
+					}
+					if (rangeTo > rangeFrom)
+					{
+						SearchPattern(pattern, data, size, rangeFrom, rangeTo, countFrom, searchFrom, counts);
+					}
+					rangeFrom = from;
+					rangeTo = to;
+				}
+				if (rangeTo > rangeFrom)
+				{
+					SearchPattern(pattern, data, size, rangeFrom, rangeTo, countFrom, searchFrom, counts);
+				}
+			}
+		}
+
+		// Searches [from, to) in windows of 2 * kMaxPatternMatchLength bytes that overlap by kMaxPatternMatchLength, so no
+		// match up to that length is cut. searchFrom is the end of the last match, so a match seen by two windows counts once.
+		void Classifier::SearchPattern(const CompiledPattern& pattern, const char* data, size_t size, size_t from, size_t to,
+			size_t countFrom, size_t& searchFrom, vector<uint32_t>& counts) const
+		{
+			for (size_t windowStart = from; windowStart < to; windowStart += kMaxPatternMatchLength)
+			{
+				size_t windowEnd = std::min(to, windowStart + 2 * kMaxPatternMatchLength);
+				size_t begin = std::max(windowStart, searchFrom);
+				if (begin < windowEnd)
+				{
+					// Anchors and word boundaries at the window edges see the real neighbouring bytes.
+					auto flags = std::regex_constants::match_default;
+					if (begin > 0)
+					{
+						flags |= std::regex_constants::match_prev_avail;
+					}
+					if (windowEnd < size)
+					{
+						flags |= std::regex_constants::match_not_eol;
+						if (IsWordByte(static_cast<unsigned char>(data[windowEnd])))
+						{
+							flags |= std::regex_constants::match_not_eow;
+						}
+					}
+
+					for (std::cregex_iterator it(data + begin, data + windowEnd, pattern.expression, flags), last; it != last; ++it)
+					{
+						size_t matchStart = begin + static_cast<size_t>(it->position());
+						size_t matchEnd = matchStart + static_cast<size_t>(it->length());
+						if (matchEnd > countFrom)
+						{
+							++counts[pattern.typeIndex];
+						}
+						searchFrom = std::max(matchEnd, matchStart + 1);
+					}
+				}
+				if (windowEnd == to)
+				{
+					break;
+				}
+			}
+		}
+
+		vector<uint32_t> Classifier::Scan(string_view content) const
+		{
+			vector<uint32_t> counts(mTypes.size(), 0);
+			Scan(content.data(), content.size(), counts);
+			return counts;
+		}
+
+		int Classifier::FindType(string_view classificationId) const
+		{
+			for (size_t i = 0; i < mTypes.size(); ++i)
+			{
+				if (mTypes[i].id == classificationId)
+				{
+					return static_cast<int>(i);
+				}
+			}
+			return -1;
+		}
+
+	} //  namespace policy
+} //  namespace sample
@@ -0,0 +1,129 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_CLASSIFIER_H_
+#define SAMPLES_UPE_CLASSIFIER_H_
+
+#include <cstdint>
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sample {
+	namespace policy {
+
+		// A sensitive information type. Content matches if it contains any keyword (whole word, case-insensitive)
+		// or any pattern (ECMAScript regular expression).
+		struct SensitiveInfoType {
+			std::string id;					// Classification ID requested by the policy
+			int confidenceLevel = 75;		// Reported for every match of this type
+			std::vector<std::string> keywords;
+			std::vector<std::string> patterns;
+		};
+
+		/**
+		 * @brief Local content classifier used to answer mip::ExecutionState::GetClassificationResults.
+		 * All keywords of all types are compiled into a single Aho-Corasick automaton, flattened into a DFA over the
+		 * byte classes that appear in the keywords, so content is scanned once regardless of the number of types.
+		 * While the automaton is at its root, bytes that cannot start a keyword are skipped without a transition.
+		 * Each pattern's longest required literal is added to the same automaton, and the pattern's regular expression
+		 * only runs around the places that literal occurs. Patterns without a literal run over the whole range. Either way
+		 * the regular expression is only given windows of 2 * kMaxPatternMatchLength bytes, which bounds the recursion
+		 * of std::regex; longer pattern matches are not found.
+		 */
+		class Classifier final {
+		public:
+			static constexpr size_t kMaxPatternMatchLength = 256;
+
+			explicit Classifier(std::vector<SensitiveInfoType> types);
+
+			// Loads types from a text file with one directive per line:
+			//   type <classification id> [confidence]
+			//   keyword <text>
+			//   pattern <regular expression>
+			// keyword and pattern lines apply to the preceding type. Lines starting with '#' are ignored.
+			static std::shared_ptr<Classifier> LoadFromFile(const std::string& path);
+
+			// Adds the number of matches per type found in data to counts, which must hold GetTypeCount() entries.
+			void Scan(const char* data, size_t size, std::vector<uint32_t>& counts) const;
+			// As above, but only counts matches that end within (countFrom, countTo]. Bytes outside that range are
+			// context: they let matches straddling a chunk boundary be found and word boundaries be checked.
+			void Scan(const char* data, size_t size, size_t countFrom, size_t countTo, std::vector<uint32_t>& counts) const;
+			std::vector<uint32_t> Scan(std::string_view content) const;
+
+			int FindType(std::string_view classificationId) const;	// Index of the type, or -1
+			uint64_t GetRuleSetVersion() const { return mRuleSetVersion; }	// Hash of all types; changes whenever a rule changes
+			const SensitiveInfoType& GetType(size_t index) const { return mTypes[index]; }
+			size_t GetTypeCount() const { return mTypes.size(); }
+
+		private:
+			struct Match {
+				uint32_t typeIndex;
+				uint32_t length;
+				int32_t patternIndex;	// Required literal of mPatterns[patternIndex], or -1 for a keyword
+			};
+
+			struct CompiledPattern {
+				uint32_t typeIndex;
+				std::regex expression;
+				bool hasLiteral;		// False if no literal is required, so the pattern runs over the whole range
+			};
+
+			struct PatternHit {
+				uint32_t patternIndex;
+				size_t end;				// Offset just past the literal
+				uint32_t length;
+			};
+
+			void Compile();
+			void ScanKeywords(const unsigned char* data, size_t size, size_t countFrom, size_t countTo, std::vector<uint32_t>& counts,
+				std::vector<PatternHit>& hits) const;
+			void ScanPatterns(const char* data, size_t size, size_t countFrom, size_t countTo, std::vector<PatternHit>& hits,
+				std::vector<uint32_t>& counts) const;
+			void SearchPattern(const CompiledPattern& pattern, const char* data, size_t size, size_t from, size_t to, size_t countFrom,
+				size_t& searchFrom, std::vector<uint32_t>& counts) const;
+
+			std::vector<SensitiveInfoType> mTypes;
+			std::vector<CompiledPattern> mPatterns;
+
+			uint8_t mByteClass[256];				// Byte (case folded) to alphabet index. 0 is every byte no keyword uses.
+			bool mStartByte[256];					// Bytes that leave the root state
+			uint32_t mClassCount = 1;
+			std::vector<uint32_t> mTransitions;	// Row of state (state * mClassCount) + class -> row of next state, high bit set if it reports matches
+			std::vector<uint32_t> mMatchOffsets;	// state -> first entry in mMatches; state + 1 -> end
+			std::vector<Match> mMatches;
+			int mSingleStartByte = -1;				// Set when only one byte can leave the root, so memchr can find it
+			uint64_t mRuleSetVersion = 0;
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_CLASSIFIER_H_
@@ -0,0 +1,189 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "content_hash.h"
+
+#include <cstring>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+	const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+	const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+	const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+	const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+	const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+	inline uint64_t RotateLeft(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	inline uint64_t Read64(const unsigned char* p)
+	{
+		uint64_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t Read32(const unsigned char* p)
+	{
+		uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline uint64_t Round(uint64_t accumulator, uint64_t input)
+	{
+		accumulator += input * kPrime2;
+		accumulator = RotateLeft(accumulator, 31);
+		return accumulator * kPrime1;
+	}
+
+	inline uint64_t MergeRound(uint64_t accumulator, uint64_t value)
+	{
+		accumulator ^= Round(0, value);
+		return accumulator * kPrime1 + kPrime4;
+	}
+}
+
+namespace sample {
+	namespace utils {
+
+		uint64_t HashContent(const void* data, size_t size, uint64_t seed)
+		{
+			auto p = static_cast<const unsigned char*>(data);
+			const unsigned char* end = p + size;
+			uint64_t hash;
+
+			if (size >= 32)
+			{
+				const unsigned char* limit = end - 32;
+				uint64_t v1 = seed + kPrime1 + kPrime2;
+				uint64_t v2 = seed + kPrime2;
+				uint64_t v3 = seed;
+				uint64_t v4 = seed - kPrime1;
+				do
+				{
+					v1 = Round(v1, Read64(p));
+					v2 = Round(v2, Read64(p + 8));
+					v3 = Round(v3, Read64(p + 16));
+					v4 = Round(v4, Read64(p + 24));
+					p += 32;
+				} while (p <= limit);
+
+				hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+				hash = MergeRound(hash, v1);
+				hash = MergeRound(hash, v2);
+				hash = MergeRound(hash, v3);
+				hash = MergeRound(hash, v4);
+			}
+			else
+			{
+				hash = seed + kPrime5;
+			}
+
+			hash += static_cast<uint64_t>(size);
+
+			while (p + 8 <= end)
+			{
+				hash ^= Round(0, Read64(p));
+				hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+				p += 8;
+			}
+			if (p + 4 <= end)
+			{
+				hash ^= static_cast<uint64_t>(Read32(p)) * kPrime1;
+				hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+				p += 4;
+			}
+			while (p < end)
+			{
+				hash ^= (*p) * kPrime5;
+				hash = RotateLeft(hash, 11) * kPrime1;
+				++p;
+			}
+
+			hash ^= hash >> 33;
+			hash *= kPrime2;
+			hash ^= hash >> 29;
+			hash *= kPrime3;
+			hash ^= hash >> 32;
+			return hash;
+		}
+
+#if defined(_WIN32) || defined(_WIN64)
+		bool GetFileIdentity(const std::string& path, FileIdentity& identity)
+		{
+			HANDLE file = CreateFileA(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+
+			BY_HANDLE_FILE_INFORMATION info;
+			bool result = GetFileInformationByHandle(file, &info) != 0;
+			CloseHandle(file);
+			if (!result)
+			{
+				return false;
+			}
+
+			identity.device = info.dwVolumeSerialNumber;
+			identity.inode = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+			identity.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+			identity.modifiedTime = static_cast<int64_t>((static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime);
+			return true;
+		}
+#else
+		bool GetFileIdentity(const std::string& path, FileIdentity& identity)
+		{
+			struct stat info;
+			if (stat(path.c_str(), &info) != 0)
+			{
+				return false;
+			}
+
+			identity.device = static_cast<uint64_t>(info.st_dev);
+			identity.inode = static_cast<uint64_t>(info.st_ino);
+			identity.size = static_cast<uint64_t>(info.st_size);
+#if defined(__APPLE__)
+			identity.modifiedTime = static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+			identity.modifiedTime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+			return true;
+		}
+#endif
+
+	} //  namespace utils
+} //  namespace sample
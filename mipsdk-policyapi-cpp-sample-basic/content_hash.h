@@ -0,0 +1,55 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UTILS_CONTENT_HASH_H_
+#define SAMPLES_UTILS_CONTENT_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace sample {
+	namespace utils {
+
+		// 64-bit xxHash (XXH64) of data. Fast enough that hashing is bounded by memory bandwidth, not by the hash.
+		uint64_t HashContent(const void* data, size_t size, uint64_t seed = 0);
+
+		// File identity used to recognize an unchanged file without reading it.
+		struct FileIdentity {
+			uint64_t device = 0;
+			uint64_t inode = 0;
+			uint64_t size = 0;
+			int64_t modifiedTime = 0;	// Platform specific resolution; only compared for equality
+		};
+
+		bool GetFileIdentity(const std::string& path, FileIdentity& identity);
+
+	} //  namespace utils
+} //  namespace sample
+
+#endif //  SAMPLES_UTILS_CONTENT_HASH_H_
@@ -0,0 +1,192 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+#include "content_profiles.h"
+
+#include <array>
+#include <cstdint>
+
+using sample::policy::ActionBits;
+using sample::policy::ContentProfile;
+
+namespace {
+	constexpr unsigned int kProtection =
+		ActionBits(mip::ActionType::METADATA) |
+		ActionBits(mip::ActionType::CUSTOM) |
+		ActionBits(mip::ActionType::JUSTIFY) |
+		ActionBits(mip::ActionType::PROTECT_ADHOC) |
+		ActionBits(mip::ActionType::PROTECT_BY_TEMPLATE) |
+		ActionBits(mip::ActionType::REMOVE_PROTECTION);
+	constexpr unsigned int kHeaderFooter = ActionBits(mip::ActionType::ADD_CONTENT_HEADER) | ActionBits(mip::ActionType::ADD_CONTENT_FOOTER);
+	constexpr unsigned int kWatermark = ActionBits(mip::ActionType::ADD_WATERMARK);
+	constexpr unsigned int kDoNotForward = ActionBits(mip::ActionType::PROTECT_DO_NOT_FORWARD);
+
+	// Office and email formats carry visual markings. PDF and the formats protected as .pfile only carry labels and protection.
+	const ContentProfile kProfiles[] = {
+		{ "Other", false, sample::policy::kAllContentActions },
+		{ "Word", false, static_cast<mip::ActionType>(kProtection | kHeaderFooter | kWatermark) },
+		{ "Excel", false, static_cast<mip::ActionType>(kProtection | kHeaderFooter) },
+		{ "PowerPoint", false, static_cast<mip::ActionType>(kProtection | kHeaderFooter | kWatermark) },
+		{ "Email", true, static_cast<mip::ActionType>(kProtection | kHeaderFooter | kDoNotForward) },
+		{ "PDF", false, static_cast<mip::ActionType>(kProtection) },
+		{ "Protected file", false, static_cast<mip::ActionType>(kProtection) },
+	};
+	enum ProfileIndex : uint8_t { kOther, kWord, kExcel, kPowerPoint, kEmail, kPdf, kPFile };
+
+	struct ExtensionEntry {
+		std::string_view extension;		// Lower case, without the dot
+		ProfileIndex profile;
+	};
+
+	constexpr ExtensionEntry kExtensions[] = {
+		{ "doc", kWord }, { "docx", kWord }, { "docm", kWord }, { "dot", kWord }, { "dotx", kWord }, { "dotm", kWord },
+		{ "xls", kExcel }, { "xlsx", kExcel }, { "xlsm", kExcel }, { "xlsb", kExcel }, { "xltx", kExcel }, { "xltm", kExcel },
+		{ "ppt", kPowerPoint }, { "pptx", kPowerPoint }, { "pptm", kPowerPoint }, { "pps", kPowerPoint }, { "ppsx", kPowerPoint },
+		{ "ppsm", kPowerPoint }, { "potx", kPowerPoint }, { "potm", kPowerPoint },
+		{ "msg", kEmail }, { "eml", kEmail },
+		{ "pdf", kPdf },
+		{ "txt", kPFile }, { "xml", kPFile }, { "csv", kPFile }, { "jpg", kPFile }, { "jpeg", kPFile }, { "jpe", kPFile },
+		{ "jfif", kPFile }, { "png", kPFile }, { "tif", kPFile }, { "tiff", kPFile }, { "bmp", kPFile }, { "gif", kPFile },
+	};
+	constexpr size_t kExtensionCount = sizeof(kExtensions) / sizeof(kExtensions[0]);
+	constexpr size_t kMaxExtensionLength = 4;
+	constexpr int kSlotBits = 7;
+	constexpr size_t kSlotCount = size_t(1) << kSlotBits;
+	constexpr uint8_t kEmptySlot = 0xFF;
+
+	constexpr char ToLower(char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; }
+
+	// Seeded FNV-1a over the lower-cased extension. The top bits pick the slot.
+	constexpr size_t Slot(std::string_view extension, uint32_t seed)
+	{
+		uint32_t hash = seed;
+		for (char c : extension)
+		{
+			hash = (hash ^ static_cast<uint8_t>(ToLower(c))) * 16777619u;
+		}
+		return hash >> (32 - kSlotBits);
+	}
+
+	constexpr bool IsCollisionFree(uint32_t seed)
+	{
+		bool used[kSlotCount] = {};
+		for (const auto& entry : kExtensions)
+		{
+			size_t slot = Slot(entry.extension, seed);
+			if (used[slot])
+			{
+				return false;
+			}
+			used[slot] = true;
+		}
+		return true;
+	}
+
+	// The first seed from 1 up that gives every extension its own slot. Searching for it at compile time takes more
+	// steps than MSVC allows by default, so it is fixed here and only checked. After changing kExtensions, find a new one.
+	constexpr uint32_t kSeed = 572;
+	static_assert(IsCollisionFree(kSeed), "Extensions collide with kSeed. Find a new seed or increase kSlotBits.");
+
+	constexpr std::array<uint8_t, kSlotCount> BuildSlots()
+	{
+		std::array<uint8_t, kSlotCount> slots{};
+		for (auto& slot : slots)
+		{
+			slot = kEmptySlot;
+		}
+		for (size_t i = 0; i < kExtensionCount; ++i)
+		{
+			slots[Slot(kExtensions[i].extension, kSeed)] = static_cast<uint8_t>(i);
+		}
+		return slots;
+	}
+
+	constexpr std::array<uint8_t, kSlotCount> kSlots = BuildSlots();
+
+	constexpr bool EqualsIgnoringCase(std::string_view extension, std::string_view lowerCase)
+	{
+		if (extension.size() != lowerCase.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < extension.size(); ++i)
+		{
+			if (ToLower(extension[i]) != lowerCase[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	constexpr ProfileIndex FindProfile(std::string_view extension)
+	{
+		if (extension.empty() || extension.size() > kMaxExtensionLength)
+		{
+			return kOther;
+		}
+		uint8_t index = kSlots[Slot(extension, kSeed)];
+		if (index == kEmptySlot || !EqualsIgnoringCase(extension, kExtensions[index].extension))
+		{
+			return kOther;
+		}
+		return kExtensions[index].profile;
+	}
+
+	constexpr bool AllExtensionsFit()
+	{
+		for (const auto& entry : kExtensions)
+		{
+			if (entry.extension.size() > kMaxExtensionLength || FindProfile(entry.extension) != entry.profile)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static_assert(AllExtensionsFit(), "Every extension must be lower case, at most kMaxExtensionLength long, and found by FindProfile");
+	static_assert(FindProfile("DOCX") == kWord && FindProfile("xyz") == kOther, "Lookups ignore case and miss unknown extensions");
+}
+
+namespace sample {
+	namespace policy {
+
+		const ContentProfile& GetContentProfile(std::string_view path)
+		{
+			size_t dot = path.find_last_of("./\\");
+			if (dot == std::string_view::npos || path[dot] != '.')
+			{
+				return kProfiles[kOther];
+			}
+			return kProfiles[FindProfile(path.substr(dot + 1))];
+		}
+
+	} //  namespace policy
+} //  namespace sample
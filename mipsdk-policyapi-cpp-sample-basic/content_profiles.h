@@ -0,0 +1,74 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+#ifndef SAMPLES_UPE_CONTENT_PROFILES_H_
+#define SAMPLES_UPE_CONTENT_PROFILES_H_
+
+#include <string>
+#include <string_view>
+
+#include "mip/common_types.h"
+#include "mip/upe/action.h"
+
+namespace sample {
+	namespace policy {
+
+		constexpr unsigned int ActionBits(mip::ActionType type) { return static_cast<unsigned int>(type); }
+
+		// Every action this sample can apply. Used for content whose format isn't known.
+		constexpr mip::ActionType kAllContentActions = static_cast<mip::ActionType>(
+			ActionBits(mip::ActionType::ADD_CONTENT_FOOTER) |
+			ActionBits(mip::ActionType::ADD_CONTENT_HEADER) |
+			ActionBits(mip::ActionType::ADD_WATERMARK) |
+			ActionBits(mip::ActionType::METADATA) |
+			ActionBits(mip::ActionType::CUSTOM) |
+			ActionBits(mip::ActionType::PROTECT_ADHOC) |
+			ActionBits(mip::ActionType::PROTECT_BY_TEMPLATE) |
+			ActionBits(mip::ActionType::PROTECT_DO_NOT_FORWARD) |
+			ActionBits(mip::ActionType::REMOVE_PROTECTION) |
+			ActionBits(mip::ActionType::JUSTIFY));
+
+		// What a family of formats can carry. Passed to the engine as the supported actions, so it doesn't build
+		// markings or protection the content would have to discard.
+		struct ContentProfile {
+			const char* name;
+			bool isEmail;					// Evaluated with the email content format instead of the file format
+			mip::ActionType supportedActions;
+
+			const std::string& GetContentFormat() const { return isEmail ? mip::GetEmailContentFormat() : mip::GetFileContentFormat(); }
+		};
+
+		// Profile for the extension of path, ignoring case. Content without a known extension gets a profile that supports
+		// every action. The table is built and checked for collisions at compile time, and the lookup doesn't allocate.
+		const ContentProfile& GetContentProfile(std::string_view path);
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_CONTENT_PROFILES_H_
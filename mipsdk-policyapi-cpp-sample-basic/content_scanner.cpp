@@ -0,0 +1,266 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "content_scanner.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "mapped_file.h"
+
+using sample::policy::Classifier;
+using sample::policy::ContentScanSettings;
+using std::runtime_error;
+using std::string;
+using std::vector;
+
+namespace {
+	// Bytes read past the end of a chunk so word boundaries and pattern anchors at the edge see the real next bytes.
+	const size_t kChunkLookahead = 64;
+
+	// Chunks of one file, handed out to whichever threads join the scan.
+	struct ChunkScan {
+		ChunkScan(uint64_t size, uint64_t chunkCount, size_t typeCount)
+			: size(size),
+			chunkCount(chunkCount),
+			counts(typeCount, 0),
+			chunkHashes(static_cast<size_t>(chunkCount), 0)
+		{
+		}
+
+		const uint64_t size;
+		const uint64_t chunkCount;
+		std::mutex mutex;
+		std::condition_variable finished;
+		uint64_t nextChunk = 0;
+		unsigned int scanning = 0;	// Chunks taken and not yet merged
+		std::exception_ptr error;
+		vector<uint32_t> counts;
+		vector<uint64_t> chunkHashes;
+	};
+
+	// Scans chunks until none are left. The classifier is only used while a chunk is taken, and the caller of ScanChunks
+	// waits for those, so a pool thread that starts after the scan has ended touches nothing but scan.
+	void ScanChunkRange(const std::shared_ptr<ChunkScan>& scan, const Classifier& classifier, const string& path,
+		const ContentScanSettings& settings)
+	{
+		std::ifstream file;
+		string buffer;
+		vector<uint32_t> counts;
+		for (;;)
+		{
+			uint64_t chunk;
+			{
+				std::lock_guard<std::mutex> lock(scan->mutex);
+				if (scan->error || scan->nextChunk >= scan->chunkCount)
+				{
+					return;
+				}
+				chunk = scan->nextChunk++;
+				++scan->scanning;
+			}
+
+			std::exception_ptr error;
+			uint64_t chunkHash = 0;
+			try
+			{
+				if (!file.is_open())
+				{
+					file.open(path, std::ios::binary);
+					if (!file)
+					{
+						throw runtime_error("Unable to open " + path);
+					}
+					buffer.resize(settings.chunkOverlap + settings.chunkSize + kChunkLookahead);
+				}
+
+				uint64_t chunkStart = chunk * settings.chunkSize;
+				uint64_t chunkEnd = std::min<uint64_t>(chunkStart + settings.chunkSize, scan->size);
+				uint64_t readStart = chunkStart - std::min<uint64_t>(chunkStart, settings.chunkOverlap);
+				uint64_t readEnd = std::min<uint64_t>(chunkEnd + kChunkLookahead, scan->size);
+
+				file.clear();
+				file.seekg(static_cast<std::streamoff>(readStart));
+				file.read(&buffer[0], static_cast<std::streamsize>(readEnd - readStart));
+				if (static_cast<uint64_t>(file.gcount()) != readEnd - readStart)
+				{
+					throw runtime_error("Unable to read " + path);
+				}
+
+				counts.assign(classifier.GetTypeCount(), 0);
+				classifier.Scan(buffer.data(), static_cast<size_t>(readEnd - readStart),
+					static_cast<size_t>(chunkStart - readStart), static_cast<size_t>(chunkEnd - readStart), counts);
+				chunkHash = sample::utils::HashContent(buffer.data() + (chunkStart - readStart),
+					static_cast<size_t>(chunkEnd - chunkStart));
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			bool done;
+			{
+				std::lock_guard<std::mutex> lock(scan->mutex);
+				if (error)
+				{
+					if (!scan->error)
+					{
+						scan->error = error;
+					}
+				}
+				else
+				{
+					for (size_t i = 0; i < counts.size(); ++i)
+					{
+						scan->counts[i] += counts[i];
+					}
+					scan->chunkHashes[static_cast<size_t>(chunk)] = chunkHash;
+				}
+				--scan->scanning;
+				done = scan->scanning == 0 && (scan->error || scan->nextChunk >= scan->chunkCount);
+			}
+			if (done)
+			{
+				scan->finished.notify_all();
+			}
+		}
+	}
+}
+
+namespace sample {
+	namespace policy {
+
+		ContentScanner::ContentScanner(const ContentScanSettings& settings, const std::shared_ptr<ClassificationCache>& cache)
+			: mSettings(settings),
+			mCache(cache)
+		{
+			if (mSettings.chunkSize == 0)
+			{
+				throw runtime_error("Content scan chunk size must be greater than zero");
+			}
+			if (mSettings.threadCount == 0)
+			{
+				mSettings.threadCount = std::max(1u, std::thread::hardware_concurrency());
+			}
+			if (mSettings.threadCount > 1)
+			{
+				// Each scan queues at most threadCount - 1 helpers; when the queue is full the caller scans alone.
+				mPool.reset(new utils::WorkerPool(mSettings.threadCount - 1, mSettings.threadCount * 4));
+			}
+		}
+
+		vector<uint32_t> ContentScanner::ScanFile(const Classifier& classifier, const string& path) const
+		{
+			// Identity is read before the content, so a file modified while being scanned is simply rescanned next time.
+			// It also gives the size, so a large file is never mapped whole.
+			vector<uint32_t> counts;
+			uint64_t ruleSetVersion = classifier.GetRuleSetVersion();
+			utils::FileIdentity identity;
+			if (!utils::GetFileIdentity(path, identity))
+			{
+				throw runtime_error("Unable to open " + path);
+			}
+			if (mCache && mCache->LookupFile(identity, ruleSetVersion, counts))
+			{
+				return counts;
+			}
+
+			uint64_t contentHash;
+			if (identity.size <= mSettings.mapThreshold)
+			{
+				utils::MappedFile file(path);
+				if (mCache)
+				{
+					contentHash = utils::HashContent(file.GetData(), file.GetSize());
+					if (mCache->LookupContent(contentHash, ruleSetVersion, counts))
+					{
+						mCache->StoreFile(identity, contentHash);
+						return counts;
+					}
+				}
+				counts.assign(classifier.GetTypeCount(), 0);
+				classifier.Scan(file.GetData(), file.GetSize(), counts);
+			}
+			else
+			{
+				// Large files are read in chunks rather than mapped, so resident memory and address space stay bounded.
+				counts = ScanChunks(classifier, path, identity.size, contentHash);
+			}
+
+			if (mCache)
+			{
+				mCache->RecordMiss();
+				mCache->StoreContent(contentHash, ruleSetVersion, counts);
+				mCache->StoreFile(identity, contentHash);
+			}
+			return counts;
+		}
+
+		vector<uint32_t> ContentScanner::ScanChunks(const Classifier& classifier, const string& path, uint64_t size,
+			uint64_t& contentHash) const
+		{
+			const uint64_t chunkCount = (size + mSettings.chunkSize - 1) / mSettings.chunkSize;
+			auto scan = std::make_shared<ChunkScan>(size, chunkCount, classifier.GetTypeCount());
+
+			if (mPool)
+			{
+				const uint64_t helperCount = std::min<uint64_t>(mPool->GetThreadCount(), chunkCount - 1);
+				const ContentScanSettings& settings = mSettings;
+				for (uint64_t i = 0; i < helperCount; ++i)
+				{
+					std::function<void()> helper = [scan, &classifier, path, settings]() {
+						ScanChunkRange(scan, classifier, path, settings);
+					};
+					if (!mPool->TrySubmit(helper))
+					{
+						break;
+					}
+				}
+			}
+			ScanChunkRange(scan, classifier, path, mSettings);
+
+			{
+				std::unique_lock<std::mutex> lock(scan->mutex);
+				scan->finished.wait(lock, [&scan]() { return scan->scanning == 0; });
+			}
+			if (scan->error)
+			{
+				std::rethrow_exception(scan->error);
+			}
+
+			contentHash = utils::HashContent(scan->chunkHashes.data(), scan->chunkHashes.size() * sizeof(uint64_t), size);
+			return std::move(scan->counts);
+		}
+
+	} //  namespace policy
+} //  namespace sample
@@ -0,0 +1,86 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_CONTENT_SCANNER_H_
+#define SAMPLES_UPE_CONTENT_SCANNER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "classification_cache.h"
+#include "classifier.h"
+#include "worker_pool.h"
+
+namespace sample {
+	namespace policy {
+
+		struct ContentScanSettings {
+			size_t mapThreshold = 64 * 1024 * 1024;	// Files up to this size are memory mapped and scanned in place
+			size_t chunkSize = 8 * 1024 * 1024;		// Bytes per chunk for larger files
+			size_t chunkOverlap = 4096;				// Bytes re-read from the previous chunk so boundary matches aren't lost
+			unsigned int threadCount = 0;			// Threads scanning chunks of one file, including the caller. Zero uses all cores.
+		};
+
+		/**
+		 * @brief Classifies the content of a file.
+		 * Small files are memory mapped and scanned in one pass. Larger files are split into fixed-size chunks that are
+		 * read and scanned in parallel by the caller and a pool of threadCount - 1 threads shared by every scan, so a busy
+		 * pool leaves the caller scanning alone rather than adding threads. Each thread holds one chunkSize + chunkOverlap
+		 * buffer while it scans a file.
+		 * Each chunk starts chunkOverlap bytes early; a match is only counted by the chunk in which it ends, so matches
+		 * shorter than the overlap are counted exactly once.
+		 * With a cache, unchanged files are answered from their identity. Mapped files are hashed before the scan, so
+		 * identical content is answered from its hash. Chunked files are hashed chunk by chunk as they are scanned, so
+		 * their content is read once; identical large copies are each scanned once and then known by identity.
+		 */
+		class ContentScanner final {
+		public:
+			explicit ContentScanner(
+				const ContentScanSettings& settings = ContentScanSettings(),
+				const std::shared_ptr<ClassificationCache>& cache = nullptr);
+
+			// Returns the number of matches per classifier type.
+			std::vector<uint32_t> ScanFile(const Classifier& classifier, const std::string& path) const;
+
+		private:
+			// Sets contentHash to a hash of the chunk hashes in order.
+			std::vector<uint32_t> ScanChunks(const Classifier& classifier, const std::string& path, uint64_t size,
+				uint64_t& contentHash) const;
+
+			ContentScanSettings mSettings;
+			std::shared_ptr<ClassificationCache> mCache;
+			std::unique_ptr<utils::WorkerPool> mPool;	// Null when threadCount is one
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_CONTENT_SCANNER_H_
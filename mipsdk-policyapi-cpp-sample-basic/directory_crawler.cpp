@@ -0,0 +1,424 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "directory_crawler.h"
+
+#include <algorithm>
+#include <thread>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#elif defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+using std::string;
+
+namespace {
+	const size_t kListingBufferSize = 64 * 1024;
+
+	bool IsDotOrDotDot(const char* name)
+	{
+		return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+	}
+
+#if defined(__linux__)
+	// Layout returned by the getdents64 system call.
+	struct LinuxDirent64 {
+		uint64_t inode;
+		int64_t offset;
+		unsigned short recordLength;
+		unsigned char type;
+		char name[1];
+	};
+#endif
+}
+
+namespace sample {
+	namespace utils {
+
+		DirectoryCrawler::DirectoryCrawler(unsigned int threadCount)
+			: mThreadCount(threadCount == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threadCount)
+		{
+		}
+
+		CrawlStats DirectoryCrawler::Crawl(const string& root, const FileCallback& onFile)
+		{
+			mQueues.clear();
+			for (unsigned int i = 0; i < mThreadCount; ++i)
+			{
+				mQueues.emplace_back(new WorkerQueue());
+			}
+			mDirectories = 0;
+			mFiles = 0;
+			mErrors = 0;
+			mSteals = 0;
+			mFailed = false;
+			mError = nullptr;
+
+			mPendingDirectories = 1;
+			mQueuedDirectories = 1;
+			mQueues[0]->directories.push_back(root);
+
+			std::vector<std::thread> threads;
+			for (unsigned int i = 1; i < mThreadCount; ++i)
+			{
+				threads.emplace_back(&DirectoryCrawler::Work, this, i, std::cref(onFile));
+			}
+			Work(0, onFile);
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+			if (mError)
+			{
+				std::rethrow_exception(mError);
+			}
+
+			CrawlStats stats;
+			stats.directories = mDirectories;
+			stats.files = mFiles;
+			stats.errors = mErrors;
+			stats.steals = mSteals;
+			return stats;
+		}
+
+		void DirectoryCrawler::Work(size_t workerIndex, const FileCallback& onFile)
+		{
+			string directory;
+			while (!mFailed)
+			{
+				if (TakeDirectory(workerIndex, directory))
+				{
+					try
+					{
+						ListDirectory(workerIndex, directory, onFile);
+					}
+					catch (...)
+					{
+						{
+							std::lock_guard<std::mutex> lock(mIdleMutex);
+							if (!mError)
+							{
+								mError = std::current_exception();
+							}
+						}
+						mFailed = true;
+						WakeAll();
+						return;
+					}
+					if (mPendingDirectories.fetch_sub(1) == 1)
+					{
+						WakeAll();
+					}
+					continue;
+				}
+
+				// Directories are only queued while others are pending, so once none are pending the crawl is over.
+				// mIdleWorkers is raised before the queue is checked again and AddDirectory queues before reading it,
+				// so either the worker sees the new directory or AddDirectory sees the worker and wakes it.
+				std::unique_lock<std::mutex> lock(mIdleMutex);
+				++mIdleWorkers;
+				mWorkAvailable.wait(lock, [this]() {
+					return mQueuedDirectories.load() > 0 || mPendingDirectories.load() == 0 || mFailed.load();
+				});
+				--mIdleWorkers;
+				if (mPendingDirectories.load() == 0)
+				{
+					return;
+				}
+			}
+		}
+
+		void DirectoryCrawler::WakeAll()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mIdleMutex);
+			}
+			mWorkAvailable.notify_all();
+		}
+
+		// Own work is taken newest first (depth first, good locality); stolen work oldest first (largest subtrees).
+		bool DirectoryCrawler::TakeDirectory(size_t workerIndex, string& directory)
+		{
+			{
+				auto& own = *mQueues[workerIndex];
+				std::lock_guard<std::mutex> lock(own.mutex);
+				if (!own.directories.empty())
+				{
+					directory = std::move(own.directories.back());
+					own.directories.pop_back();
+					mQueuedDirectories.fetch_sub(1);
+					return true;
+				}
+			}
+
+			for (size_t offset = 1; offset < mQueues.size(); ++offset)
+			{
+				auto& victim = *mQueues[(workerIndex + offset) % mQueues.size()];
+				std::lock_guard<std::mutex> lock(victim.mutex);
+				if (!victim.directories.empty())
+				{
+					directory = std::move(victim.directories.front());
+					victim.directories.pop_front();
+					mQueuedDirectories.fetch_sub(1);
+					mSteals.fetch_add(1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void DirectoryCrawler::AddDirectory(size_t workerIndex, string directory)
+		{
+			mPendingDirectories.fetch_add(1);
+			{
+				auto& own = *mQueues[workerIndex];
+				std::lock_guard<std::mutex> lock(own.mutex);
+				own.directories.push_back(std::move(directory));
+			}
+			mQueuedDirectories.fetch_add(1);
+			if (mIdleWorkers.load() > 0)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mIdleMutex);
+				}
+				mWorkAvailable.notify_one();
+			}
+		}
+
+#if defined(_WIN32) || defined(_WIN64)
+		void DirectoryCrawler::ListDirectory(size_t workerIndex, const string& directory, const FileCallback& onFile)
+		{
+			string path = directory;
+			if (path.empty() || (path.back() != '\\' && path.back() != '/'))
+			{
+				path += '\\';
+			}
+			const size_t baseLength = path.size();
+
+			WIN32_FIND_DATAA data;
+			HANDLE find = FindFirstFileExA((path + "*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+			if (find == INVALID_HANDLE_VALUE)
+			{
+				mErrors.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			mDirectories.fetch_add(1, std::memory_order_relaxed);
+
+			try
+			{
+				do
+				{
+					if (IsDotOrDotDot(data.cFileName) || (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+					{
+						continue;
+					}
+					path.resize(baseLength);
+					path += data.cFileName;
+					if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+					{
+						AddDirectory(workerIndex, path);
+					}
+					else
+					{
+						mFiles.fetch_add(1, std::memory_order_relaxed);
+						onFile(path);
+					}
+				} while (FindNextFileA(find, &data));
+			}
+			catch (...)
+			{
+				FindClose(find);
+				throw;
+			}
+			if (GetLastError() != ERROR_NO_MORE_FILES)
+			{
+				mErrors.fetch_add(1, std::memory_order_relaxed);
+			}
+			FindClose(find);
+		}
+#elif defined(__linux__)
+		void DirectoryCrawler::ListDirectory(size_t workerIndex, const string& directory, const FileCallback& onFile)
+		{
+			int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (fd < 0)
+			{
+				mErrors.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			mDirectories.fetch_add(1, std::memory_order_relaxed);
+
+			string path = directory;
+			if (path.empty() || path.back() != '/')
+			{
+				path += '/';
+			}
+			const size_t baseLength = path.size();
+
+			// Reused by every directory this thread lists. Each call returns as many entries as fit.
+			thread_local std::unique_ptr<char[]> buffer(new char[kListingBufferSize]);
+			try
+			{
+				for (;;)
+				{
+					long count = syscall(SYS_getdents64, fd, buffer.get(), kListingBufferSize);
+					if (count < 0)
+					{
+						mErrors.fetch_add(1, std::memory_order_relaxed);
+						break;
+					}
+					if (count == 0)
+					{
+						break;
+					}
+
+					for (long offset = 0; offset < count;)
+					{
+						auto entry = reinterpret_cast<const LinuxDirent64*>(buffer.get() + offset);
+						offset += entry->recordLength;
+						if (IsDotOrDotDot(entry->name))
+						{
+							continue;
+						}
+
+						unsigned char type = entry->type;
+						if (type == DT_UNKNOWN)
+						{
+							// Some file systems don't report the type in the listing.
+							struct stat info;
+							if (fstatat(fd, entry->name, &info, AT_SYMLINK_NOFOLLOW) != 0)
+							{
+								continue;
+							}
+							type = S_ISDIR(info.st_mode) ? DT_DIR : S_ISREG(info.st_mode) ? DT_REG : DT_UNKNOWN;
+						}
+
+						path.resize(baseLength);
+						path += entry->name;
+						if (type == DT_DIR)
+						{
+							AddDirectory(workerIndex, path);
+						}
+						else if (type == DT_REG)
+						{
+							mFiles.fetch_add(1, std::memory_order_relaxed);
+							onFile(path);
+						}
+					}
+				}
+			}
+			catch (...)
+			{
+				close(fd);
+				throw;
+			}
+			close(fd);
+		}
+#else
+		void DirectoryCrawler::ListDirectory(size_t workerIndex, const string& directory, const FileCallback& onFile)
+		{
+			DIR* dir = opendir(directory.c_str());
+			if (dir == nullptr)
+			{
+				mErrors.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			mDirectories.fetch_add(1, std::memory_order_relaxed);
+
+			string path = directory;
+			if (path.empty() || path.back() != '/')
+			{
+				path += '/';
+			}
+			const size_t baseLength = path.size();
+
+			try
+			{
+				// readdir returns null both at the end and on failure; only a failure sets errno.
+				for (;;)
+				{
+					errno = 0;
+					struct dirent* entry = readdir(dir);
+					if (entry == nullptr)
+					{
+						if (errno != 0)
+						{
+							mErrors.fetch_add(1, std::memory_order_relaxed);
+						}
+						break;
+					}
+					if (IsDotOrDotDot(entry->d_name))
+					{
+						continue;
+					}
+
+					unsigned char type = entry->d_type;
+					if (type == DT_UNKNOWN)
+					{
+						struct stat info;
+						if (fstatat(dirfd(dir), entry->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0)
+						{
+							continue;
+						}
+						type = S_ISDIR(info.st_mode) ? DT_DIR : S_ISREG(info.st_mode) ? DT_REG : DT_UNKNOWN;
+					}
+
+					path.resize(baseLength);
+					path += entry->d_name;
+					if (type == DT_DIR)
+					{
+						AddDirectory(workerIndex, path);
+					}
+					else if (type == DT_REG)
+					{
+						mFiles.fetch_add(1, std::memory_order_relaxed);
+						onFile(path);
+					}
+				}
+			}
+			catch (...)
+			{
+				closedir(dir);
+				throw;
+			}
+			closedir(dir);
+		}
+#endif
+
+	} //  namespace utils
+} //  namespace sample
@@ -0,0 +1,101 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UTILS_DIRECTORY_CRAWLER_H_
+#define SAMPLES_UTILS_DIRECTORY_CRAWLER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sample {
+	namespace utils {
+
+		struct CrawlStats {
+			uint64_t directories = 0;
+			uint64_t files = 0;
+			uint64_t errors = 0;	// Directories that could not be opened or read to the end
+			uint64_t steals = 0;	// Directories taken from another worker's queue
+		};
+
+		/**
+		 * @brief Parallel directory tree walker.
+		 * Each worker owns a queue of directories. It lists directories from the back of its own queue and, when that is
+		 * empty, steals from the front of another worker's queue, so one deep subtree spreads across all workers. Workers
+		 * with nothing to steal sleep until a directory is queued.
+		 * Entries are read in large batches (getdents64 on Linux, FindFirstFileEx with large fetch on Windows) and the
+		 * entry type from the listing is used, so files are not stat'ed individually. Symbolic links are not followed.
+		 */
+		class DirectoryCrawler final {
+		public:
+			// Called concurrently from worker threads for every regular file. An exception stops the crawl and is rethrown
+			// by Crawl.
+			using FileCallback = std::function<void(const std::string& path)>;
+
+			explicit DirectoryCrawler(unsigned int threadCount = 0);
+
+			CrawlStats Crawl(const std::string& root, const FileCallback& onFile);
+
+		private:
+			struct WorkerQueue {
+				std::mutex mutex;
+				std::deque<std::string> directories;
+			};
+
+			void Work(size_t workerIndex, const FileCallback& onFile);
+			bool TakeDirectory(size_t workerIndex, std::string& directory);
+			void ListDirectory(size_t workerIndex, const std::string& directory, const FileCallback& onFile);
+			void AddDirectory(size_t workerIndex, std::string directory);
+			void WakeAll();
+
+			unsigned int mThreadCount;
+			std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+			std::atomic<uint64_t> mPendingDirectories{ 0 };	// Queued or being listed; the crawl ends when it reaches zero
+			std::atomic<uint64_t> mQueuedDirectories{ 0 };	// Queued and not yet taken
+			std::atomic<unsigned int> mIdleWorkers{ 0 };	// Waiting on mWorkAvailable
+			std::mutex mIdleMutex;
+			std::condition_variable mWorkAvailable;			// A directory was queued, the crawl ended or a callback failed
+			std::atomic<bool> mFailed{ false };
+			std::exception_ptr mError;						// First exception from the file callback, guarded by mIdleMutex
+			std::atomic<uint64_t> mDirectories{ 0 };
+			std::atomic<uint64_t> mFiles{ 0 };
+			std::atomic<uint64_t> mErrors{ 0 };
+			std::atomic<uint64_t> mSteals{ 0 };
+		};
+
+	} //  namespace utils
+} //  namespace sample
+
+#endif //  SAMPLES_UTILS_DIRECTORY_CRAWLER_H_
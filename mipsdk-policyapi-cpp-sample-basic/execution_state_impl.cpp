@@ -26,6 +26,12 @@
  */
 
 #include "execution_state_impl.h"
+#include "classification_results_impl.h"
+#include "request_arena.h"
+
+#include <algorithm>
+#include <exception>
+#include <memory_resource>
 
 using std::pair;
 using std::string;
@@ -34,31 +40,42 @@ using std::vector;
 
 namespace sample {
 	namespace policy {
+		// The interface returns by value, so this is one copy of a vector resolved once per label.
 		vector<pair<string, string>> ExecutionStateImpl::GetNewLabelExtendedProperties() const {
-			return vector<pair<string, string>>();
+			if (!mOptions.newLabelExtendedProperties)
+				return vector<pair<string, string>>();
+			return *mOptions.newLabelExtendedProperties;
 		}
 
         vector<mip::MetadataEntry> ExecutionStateImpl::GetContentMetadata(
             const vector<string>& names,
             const vector<string>& namePrefixes) const {
-            unordered_map<string, string> filteredMetadata;
+            // Matches are collected as pointers into mOptions.metadata on the request arena, so nothing is copied
+            // until the result is built.
+            typedef unordered_map<string, string>::value_type Entry;
+            std::pmr::vector<const Entry*> matches(utils::GetRequestResource());
 
             for (const string& namePrefix : namePrefixes) {
                 for (const auto& prop : mOptions.metadata) {
                     if (prop.first.compare(0, namePrefix.length(), namePrefix) == 0)
-                        filteredMetadata[prop.first] = prop.second;
+                        matches.push_back(&prop);
                 }
             }
 
             for (const string& name : names) {
                 auto itName = mOptions.metadata.find(name);
                 if (itName != mOptions.metadata.end())
-                    filteredMetadata[name] = itName->second;
+                    matches.push_back(&*itName);
             }
 
+            // A key matched by several names or prefixes is reported once.
+            std::sort(matches.begin(), matches.end());
+            matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+
             vector<mip::MetadataEntry> result;
-            for (const auto& prop : filteredMetadata)
-                result.emplace_back(prop.first, prop.second);
+            result.reserve(matches.size());
+            for (const Entry* prop : matches)
+                result.emplace_back(prop->first, prop->second);
 
             return result;
         }
@@ -68,22 +85,54 @@ namespace sample {
 			//  choose not to support specific actions that may appear in a policy. (For instance, A policy may define a label to
 			//  require both protection and a watermark, but the application could decide not to support watermarks by not
 			//  including ADD_WATERMARK here. If that were the case, 'mip::PolicyEngine::ComputeActions' would never return
-			//  AddWatermark actions.)
-			return mip::ActionType::ADD_CONTENT_FOOTER |
-				mip::ActionType::ADD_CONTENT_HEADER |
-				mip::ActionType::ADD_WATERMARK |
-				mip::ActionType::METADATA |
-				mip::ActionType::CUSTOM |
-				mip::ActionType::PROTECT_ADHOC |
-				mip::ActionType::PROTECT_BY_TEMPLATE |
-				mip::ActionType::PROTECT_DO_NOT_FORWARD | 
-				mip::ActionType::REMOVE_PROTECTION | 
-				mip::ActionType::JUSTIFY;
+			//  AddWatermark actions.) Callers narrow this per content format with GetContentProfile.
+			return mOptions.supportedActions;
 		}
 
-		std::shared_ptr<mip::ClassificationResults> ExecutionStateImpl::GetClassificationResults(const std::vector<std::shared_ptr<mip::ClassificationRequest>>&) const
+		std::shared_ptr<mip::ClassificationResults> ExecutionStateImpl::GetClassificationResults(
+			const std::vector<std::shared_ptr<mip::ClassificationRequest>>& classificationIds) const
 		{
-			return std::shared_ptr<mip::ClassificationResults>();
+			if (!mOptions.classifier || (!mOptions.content && !mOptions.contentScanner))
+			{
+				return std::shared_ptr<mip::ClassificationResults>();
+			}
+
+			// One pass over the content counts every configured type; the SDK's requests only select which to report.
+			// The SDK calls this from inside ComputeActions, so a scan failure is reported as no results rather than thrown
+			// through it.
+			std::vector<uint32_t> counts;
+			try
+			{
+				if (mOptions.content)
+				{
+					counts = mOptions.classifier->Scan(*mOptions.content);
+				}
+				else
+				{
+					counts = mOptions.contentScanner->ScanFile(*mOptions.classifier, mOptions.contentIdentifier);
+				}
+			}
+			catch (const std::exception& ex)
+			{
+				if (mOptions.log)
+				{
+					mOptions.log->Log(mip::LogLevel::Warning, "Unable to classify %s: %s", mOptions.contentIdentifier.c_str(), ex.what());
+				}
+				return std::shared_ptr<mip::ClassificationResults>();
+			}
+
+			auto results = std::make_shared<ClassificationResultsImpl>();
+			for (const auto& request : classificationIds)
+			{
+				int typeIndex = mOptions.classifier->FindType(request->GetClassificationId());
+				if (typeIndex >= 0 && counts[typeIndex] > 0)
+				{
+					const auto& type = mOptions.classifier->GetType(typeIndex);
+					results->AddResult(type.id, static_cast<int>(counts[typeIndex]), type.confidenceLevel);
+				}
+			}
+
+			return results;
 		}
 
 	} //  namespace sample
@@ -32,18 +32,26 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "mip/protection_descriptor.h"
 #include "mip/upe/action.h"
 #include "mip/upe/execution_state.h"
+#include "async_log_sink.h"
+#include "classifier.h"
+#include "content_profiles.h"
+#include "content_scanner.h"
 #include "protection_descriptor_impl.h"
 
 namespace sample {
 	namespace policy {
 
+		typedef std::vector<std::pair<std::string, std::string>> ExtendedProperties;
+
 		struct ExecutionStateOptions {
 			std::unordered_map<std::string, std::string> metadata;
 			std::shared_ptr<mip::Label> newLabel;
+			std::shared_ptr<const ExtendedProperties> newLabelExtendedProperties;	// Shared by every request for the label. Filled from Action's LabelPropertyTable if null.
 			std::string contentIdentifier;
 			mip::ActionSource actionSource = mip::ActionSource::MANUAL;
 			mip::DataState dataState = mip::DataState::USE;
@@ -51,9 +59,13 @@ namespace sample {
 			bool isDowngradeJustified = false;
 			std::string downgradeJustification;
 			std::string templateId;
-			std::string contentFormat;
-			mip::ActionType supportedActions = mip::ActionType::REMOVE_WATERMARK;
+			std::string contentFormat;						// Set with supportedActions from GetContentProfile for files
+			mip::ActionType supportedActions = kAllContentActions;	// Actions the content can apply. The engine won't generate others.
 			bool generateAuditEvent = true;
+			std::shared_ptr<const Classifier> classifier;	// Local classifier for auto-labeling conditions. Null reports no results.
+			std::shared_ptr<const std::string> content;		// Content passed to the classifier. If null, the file named by contentIdentifier is scanned.
+			std::shared_ptr<const ContentScanner> contentScanner;	// Reads the file named by contentIdentifier. Null disables file scanning.
+			std::shared_ptr<utils::AsyncLogSink> log;				// Receives classification failures. Null drops them.
 		};
 
 		class ExecutionStateImpl final : public mip::ExecutionState {
@@ -78,7 +90,7 @@ namespace sample {
 			
 			mip::ActionType GetSupportedActions() const override;
 			std::shared_ptr<mip::ClassificationResults> GetClassificationResults(
-				const std::vector<std::shared_ptr<mip::ClassificationRequest>>& /*classificationIds*/) const override;
+				const std::vector<std::shared_ptr<mip::ClassificationRequest>>& classificationIds) const override;
 			
 
 		private:
@@ -0,0 +1,338 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "json_reader.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+using std::string;
+using std::string_view;
+
+namespace {
+	const int kMaxDepth = 64;
+
+	void AppendUtf8(string& output, unsigned long codePoint)
+	{
+		if (codePoint < 0x80)
+		{
+			output += static_cast<char>(codePoint);
+		}
+		else if (codePoint < 0x800)
+		{
+			output += static_cast<char>(0xC0 | (codePoint >> 6));
+			output += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else if (codePoint < 0x10000)
+		{
+			output += static_cast<char>(0xE0 | (codePoint >> 12));
+			output += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			output += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else
+		{
+			output += static_cast<char>(0xF0 | (codePoint >> 18));
+			output += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+			output += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			output += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+	}
+}
+
+namespace sample {
+	namespace utils {
+
+		const JsonValue* JsonValue::Find(string_view key) const
+		{
+			for (const auto& member : mObject)
+			{
+				if (member.first == key)
+				{
+					return &member.second;
+				}
+			}
+			return nullptr;
+		}
+
+		string_view JsonValue::GetString(string_view key, string_view defaultValue) const
+		{
+			auto value = Find(key);
+			return value != nullptr && value->mType == Type::String ? value->mString : defaultValue;
+		}
+
+		double JsonValue::GetNumber(string_view key, double defaultValue) const
+		{
+			auto value = Find(key);
+			return value != nullptr && value->mType == Type::Number ? value->mNumber : defaultValue;
+		}
+
+		bool JsonValue::GetBool(string_view key, bool defaultValue) const
+		{
+			auto value = Find(key);
+			return value != nullptr && value->mType == Type::Bool ? value->mBool : defaultValue;
+		}
+
+		JsonDocument::JsonDocument(string_view text) : mText(text)
+		{
+			// Skip a UTF-8 byte order mark, which editors on Windows commonly add.
+			if (mText.size() >= 3 && std::memcmp(mText.data(), "\xEF\xBB\xBF", 3) == 0)
+			{
+				mPosition = 3;
+			}
+			ParseValue(mRoot, 0);
+			SkipWhitespace();
+			if (mPosition != mText.size())
+			{
+				Fail("unexpected data after value");
+			}
+		}
+
+		void JsonDocument::Fail(const char* message) const
+		{
+			throw std::runtime_error(string("JSON parse error at offset ") + std::to_string(mPosition) + ": " + message);
+		}
+
+		void JsonDocument::SkipWhitespace()
+		{
+			while (mPosition < mText.size())
+			{
+				char c = mText[mPosition];
+				if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+				{
+					break;
+				}
+				++mPosition;
+			}
+		}
+
+		string_view JsonDocument::ParseString()
+		{
+			if (mPosition >= mText.size() || mText[mPosition] != '"')
+			{
+				Fail("expected string");
+			}
+			size_t start = ++mPosition;
+
+			// Fast path: no escapes, the value is a view of the input.
+			while (mPosition < mText.size() && mText[mPosition] != '"' && mText[mPosition] != '\\')
+			{
+				++mPosition;
+			}
+			if (mPosition >= mText.size())
+			{
+				Fail("unterminated string");
+			}
+			if (mText[mPosition] == '"')
+			{
+				return mText.substr(start, mPosition++ - start);
+			}
+
+			string decoded(mText.substr(start, mPosition - start));
+			while (mPosition < mText.size() && mText[mPosition] != '"')
+			{
+				char c = mText[mPosition++];
+				if (c != '\\')
+				{
+					decoded += c;
+					continue;
+				}
+				if (mPosition >= mText.size())
+				{
+					Fail("unterminated escape");
+				}
+				char escape = mText[mPosition++];
+				switch (escape)
+				{
+				case '"': decoded += '"'; break;
+				case '\\': decoded += '\\'; break;
+				case '/': decoded += '/'; break;
+				case 'b': decoded += '\b'; break;
+				case 'f': decoded += '\f'; break;
+				case 'n': decoded += '\n'; break;
+				case 'r': decoded += '\r'; break;
+				case 't': decoded += '\t'; break;
+				case 'u': {
+					if (mPosition + 4 > mText.size())
+					{
+						Fail("truncated unicode escape");
+					}
+					string hex(mText.substr(mPosition, 4));
+					mPosition += 4;
+					unsigned long codePoint = std::strtoul(hex.c_str(), nullptr, 16);
+					if (codePoint >= 0xD800 && codePoint <= 0xDBFF && mPosition + 6 <= mText.size() &&
+						mText[mPosition] == '\\' && mText[mPosition + 1] == 'u')
+					{
+						string low(mText.substr(mPosition + 2, 4));
+						unsigned long lowSurrogate = std::strtoul(low.c_str(), nullptr, 16);
+						if (lowSurrogate >= 0xDC00 && lowSurrogate <= 0xDFFF)
+						{
+							codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
+							mPosition += 6;
+						}
+					}
+					AppendUtf8(decoded, codePoint);
+					break;
+				}
+				default:
+					Fail("invalid escape");
+				}
+			}
+			if (mPosition >= mText.size())
+			{
+				Fail("unterminated string");
+			}
+			++mPosition;
+
+			mDecodedStrings.push_back(std::move(decoded));
+			return mDecodedStrings.back();
+		}
+
+		void JsonDocument::ParseValue(JsonValue& value, int depth)
+		{
+			if (depth > kMaxDepth)
+			{
+				Fail("nesting too deep");
+			}
+
+			SkipWhitespace();
+			if (mPosition >= mText.size())
+			{
+				Fail("unexpected end of input");
+			}
+
+			char c = mText[mPosition];
+			if (c == '{')
+			{
+				value.mType = JsonValue::Type::Object;
+				++mPosition;
+				SkipWhitespace();
+				if (mPosition < mText.size() && mText[mPosition] == '}')
+				{
+					++mPosition;
+					return;
+				}
+				for (;;)
+				{
+					SkipWhitespace();
+					string_view key = ParseString();
+					SkipWhitespace();
+					if (mPosition >= mText.size() || mText[mPosition] != ':')
+					{
+						Fail("expected ':'");
+					}
+					++mPosition;
+					value.mObject.emplace_back(key, JsonValue());
+					ParseValue(value.mObject.back().second, depth + 1);
+					SkipWhitespace();
+					if (mPosition < mText.size() && mText[mPosition] == ',')
+					{
+						++mPosition;
+						continue;
+					}
+					if (mPosition < mText.size() && mText[mPosition] == '}')
+					{
+						++mPosition;
+						return;
+					}
+					Fail("expected ',' or '}'");
+				}
+			}
+			else if (c == '[')
+			{
+				value.mType = JsonValue::Type::Array;
+				++mPosition;
+				SkipWhitespace();
+				if (mPosition < mText.size() && mText[mPosition] == ']')
+				{
+					++mPosition;
+					return;
+				}
+				for (;;)
+				{
+					value.mArray.emplace_back();
+					ParseValue(value.mArray.back(), depth + 1);
+					SkipWhitespace();
+					if (mPosition < mText.size() && mText[mPosition] == ',')
+					{
+						++mPosition;
+						continue;
+					}
+					if (mPosition < mText.size() && mText[mPosition] == ']')
+					{
+						++mPosition;
+						return;
+					}
+					Fail("expected ',' or ']'");
+				}
+			}
+			else if (c == '"')
+			{
+				value.mType = JsonValue::Type::String;
+				value.mString = ParseString();
+			}
+			else if (mText.compare(mPosition, 4, "true") == 0)
+			{
+				value.mType = JsonValue::Type::Bool;
+				value.mBool = true;
+				mPosition += 4;
+			}
+			else if (mText.compare(mPosition, 5, "false") == 0)
+			{
+				value.mType = JsonValue::Type::Bool;
+				mPosition += 5;
+			}
+			else if (mText.compare(mPosition, 4, "null") == 0)
+			{
+				value.mType = JsonValue::Type::Null;
+				mPosition += 4;
+			}
+			else if (c == '-' || (c >= '0' && c <= '9'))
+			{
+				size_t start = mPosition;
+				while (mPosition < mText.size() && std::strchr("+-0123456789.eE", mText[mPosition]) != nullptr && mText[mPosition] != '\0')
+				{
+					++mPosition;
+				}
+				string number(mText.substr(start, mPosition - start));
+				char* end = nullptr;
+				value.mType = JsonValue::Type::Number;
+				value.mNumber = std::strtod(number.c_str(), &end);
+				if (end == nullptr || *end != '\0')
+				{
+					Fail("invalid number");
+				}
+			}
+			else
+			{
+				Fail("unexpected character");
+			}
+		}
+
+	} //  namespace utils
+} //  namespace sample
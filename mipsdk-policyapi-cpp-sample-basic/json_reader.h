@@ -0,0 +1,104 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UTILS_JSON_READER_H_
+#define SAMPLES_UTILS_JSON_READER_H_
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace sample {
+	namespace utils {
+
+		/**
+		 * @brief Read-only JSON value produced by JsonDocument.
+		 * Strings and object keys are views. Unless they contain escape sequences they point straight into the
+		 * parsed text, so the text must outlive the document.
+		 */
+		class JsonValue final {
+		public:
+			enum class Type { Null, Bool, Number, String, Array, Object };
+
+			Type GetType() const { return mType; }
+			bool IsNull() const { return mType == Type::Null; }
+			bool IsString() const { return mType == Type::String; }
+			bool IsObject() const { return mType == Type::Object; }
+			bool IsArray() const { return mType == Type::Array; }
+
+			bool GetBool() const { return mBool; }
+			double GetNumber() const { return mNumber; }
+			std::string_view GetString() const { return mString; }
+			const std::vector<JsonValue>& GetArray() const { return mArray; }
+			const std::vector<std::pair<std::string_view, JsonValue>>& GetObject() const { return mObject; }
+
+			// Member lookup for objects. Returns nullptr if this is not an object or the key is missing.
+			const JsonValue* Find(std::string_view key) const;
+			std::string_view GetString(std::string_view key, std::string_view defaultValue = std::string_view()) const;
+			double GetNumber(std::string_view key, double defaultValue = 0) const;
+			bool GetBool(std::string_view key, bool defaultValue = false) const;
+
+		private:
+			friend class JsonDocument;
+
+			Type mType = Type::Null;
+			bool mBool = false;
+			double mNumber = 0;
+			std::string_view mString;
+			std::vector<JsonValue> mArray;
+			std::vector<std::pair<std::string_view, JsonValue>> mObject;
+		};
+
+		class JsonDocument final {
+		public:
+			// Throws std::runtime_error on malformed input.
+			explicit JsonDocument(std::string_view text);
+
+			JsonDocument(const JsonDocument&) = delete;
+			JsonDocument& operator=(const JsonDocument&) = delete;
+
+			const JsonValue& GetRoot() const { return mRoot; }
+
+		private:
+			void ParseValue(JsonValue& value, int depth);
+			std::string_view ParseString();
+			void SkipWhitespace();
+			[[noreturn]] void Fail(const char* message) const;
+
+			std::string_view mText;
+			size_t mPosition = 0;
+			std::deque<std::string> mDecodedStrings;	// Storage for strings that contained escapes
+			JsonValue mRoot;
+		};
+
+	} //  namespace utils
+} //  namespace sample
+
+#endif //  SAMPLES_UTILS_JSON_READER_H_
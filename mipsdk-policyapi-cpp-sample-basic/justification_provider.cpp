@@ -0,0 +1,157 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "justification_provider.h"
+
+#include <iostream>
+
+using std::string;
+
+namespace sample {
+	namespace policy {
+
+		InteractiveJustificationProvider::InteractiveJustificationProvider(std::shared_ptr<utils::AsyncLogSink> log)
+			: mLog(std::move(log))
+		{
+		}
+
+		JustificationResult InteractiveJustificationProvider::GetJustification(const ExecutionStateOptions& options, string& justification)
+		{
+			std::lock_guard<std::mutex> lock(mConsoleMutex);
+			if (mLog)
+			{
+				mLog->Flush();
+			}
+			std::cout << "Provide Justification for " << options.contentIdentifier << ": ";
+			std::cin >> justification;
+			std::cout << std::endl;
+			return std::cin && !justification.empty() ? JustificationResult::Provided : JustificationResult::Denied;
+		}
+
+		RuleJustificationProvider::RuleJustificationProvider(std::vector<JustificationRule> rules)
+			: mRules(std::move(rules))
+		{
+		}
+
+		JustificationResult RuleJustificationProvider::GetJustification(const ExecutionStateOptions& options, string& justification)
+		{
+			const string labelId = options.newLabel ? options.newLabel->GetId() : string();
+			for (const auto& rule : mRules)
+			{
+				if (!rule.labelId.empty() && rule.labelId != labelId)
+				{
+					continue;
+				}
+				if (options.contentIdentifier.compare(0, rule.pathPrefix.size(), rule.pathPrefix) != 0)
+				{
+					continue;
+				}
+				justification = rule.justification;
+				return JustificationResult::Provided;
+			}
+			return JustificationResult::Denied;
+		}
+
+		PreSuppliedJustificationProvider::PreSuppliedJustificationProvider(std::shared_ptr<JustificationProvider> fallback)
+			: mFallback(std::move(fallback))
+		{
+		}
+
+		void PreSuppliedJustificationProvider::SetJustification(const string& contentIdentifier, const string& justification)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mJustifications[contentIdentifier] = justification;
+		}
+
+		JustificationResult PreSuppliedJustificationProvider::GetJustification(const ExecutionStateOptions& options, string& justification)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				auto it = mJustifications.find(options.contentIdentifier);
+				if (it != mJustifications.end())
+				{
+					justification = it->second;
+					return JustificationResult::Provided;
+				}
+			}
+			return mFallback ? mFallback->GetJustification(options, justification) : JustificationResult::Denied;
+		}
+
+		DeferredJustificationProvider::DeferredJustificationProvider(std::shared_ptr<JustificationProvider> primary, size_t capacity)
+			: mPrimary(std::move(primary)),
+			mCapacity(capacity)
+		{
+		}
+
+		JustificationResult DeferredJustificationProvider::GetJustification(const ExecutionStateOptions& options, string& justification)
+		{
+			if (mPrimary)
+			{
+				auto result = mPrimary->GetJustification(options, justification);
+				if (result != JustificationResult::Denied)
+				{
+					return result;
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mDeferred.size() >= mCapacity)
+			{
+				++mDenied;
+				return JustificationResult::Denied;
+			}
+			mDeferred.push_back(options);
+			return JustificationResult::Deferred;
+		}
+
+		bool DeferredJustificationProvider::TakeDeferred(ExecutionStateOptions& options)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mDeferred.empty())
+			{
+				return false;
+			}
+			options = std::move(mDeferred.front());
+			mDeferred.pop_front();
+			return true;
+		}
+
+		size_t DeferredJustificationProvider::GetDeferredCount() const
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			return mDeferred.size();
+		}
+
+		uint64_t DeferredJustificationProvider::GetDeniedCount() const
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			return mDenied;
+		}
+
+	} //  namespace policy
+} //  namespace sample
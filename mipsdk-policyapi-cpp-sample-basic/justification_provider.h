@@ -0,0 +1,130 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_JUSTIFICATION_PROVIDER_H_
+#define SAMPLES_UPE_JUSTIFICATION_PROVIDER_H_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "async_log_sink.h"
+#include "execution_state_impl.h"
+
+namespace sample {
+	namespace policy {
+
+		enum class JustificationResult {
+			Provided,	// The justification was filled in and the downgrade can go ahead
+			Deferred,	// The item was set aside to be retried later
+			Denied		// No justification is available. The downgrade must not be applied.
+		};
+
+		/**
+		 * @brief Supplies the justification a JUSTIFY action asks for.
+		 * Called from ComputeActionLoop on whichever thread is evaluating the item, so implementations must be thread safe.
+		 */
+		class JustificationProvider {
+		public:
+			virtual ~JustificationProvider() = default;
+			virtual JustificationResult GetJustification(const ExecutionStateOptions& options, std::string& justification) = 0;
+		};
+
+		// Prompts on the console. Prompts from several threads are asked one at a time.
+		class InteractiveJustificationProvider final : public JustificationProvider {
+		public:
+			explicit InteractiveJustificationProvider(std::shared_ptr<utils::AsyncLogSink> log = nullptr);
+			JustificationResult GetJustification(const ExecutionStateOptions& options, std::string& justification) override;
+
+		private:
+			std::shared_ptr<utils::AsyncLogSink> mLog;	// Flushed before prompting so output doesn't interleave with the prompt
+			std::mutex mConsoleMutex;
+		};
+
+		struct JustificationRule {
+			std::string labelId;		// New label the rule applies to. Empty matches any label.
+			std::string pathPrefix;		// Prefix of contentIdentifier the rule applies to. Empty matches any item.
+			std::string justification;
+		};
+
+		// Answers from a list of rules. The first matching rule wins, and items no rule matches are denied.
+		class RuleJustificationProvider final : public JustificationProvider {
+		public:
+			explicit RuleJustificationProvider(std::vector<JustificationRule> rules);
+			JustificationResult GetJustification(const ExecutionStateOptions& options, std::string& justification) override;
+
+		private:
+			const std::vector<JustificationRule> mRules;
+		};
+
+		// Answers from justifications supplied per item, keyed by contentIdentifier. Other items go to fallback, or are denied.
+		class PreSuppliedJustificationProvider final : public JustificationProvider {
+		public:
+			explicit PreSuppliedJustificationProvider(std::shared_ptr<JustificationProvider> fallback = nullptr);
+
+			void SetJustification(const std::string& contentIdentifier, const std::string& justification);
+			JustificationResult GetJustification(const ExecutionStateOptions& options, std::string& justification) override;
+
+		private:
+			std::shared_ptr<JustificationProvider> mFallback;
+			std::mutex mMutex;
+			std::unordered_map<std::string, std::string> mJustifications;
+		};
+
+		/**
+		 * @brief Sets items that need a justification aside instead of waiting for one.
+		 * The item's execution state is queued for a later retry (LabelingPipeline::RetryDeferred) and the worker moves on.
+		 * A primary provider, if given, is asked first and only items it denies are deferred. Once capacity items are
+		 * waiting, further items are denied.
+		 */
+		class DeferredJustificationProvider final : public JustificationProvider {
+		public:
+			explicit DeferredJustificationProvider(std::shared_ptr<JustificationProvider> primary = nullptr, size_t capacity = 10000);
+
+			JustificationResult GetJustification(const ExecutionStateOptions& options, std::string& justification) override;
+
+			bool TakeDeferred(ExecutionStateOptions& options);	// Pop the oldest deferred item. False if there are none.
+			size_t GetDeferredCount() const;
+			uint64_t GetDeniedCount() const;	// Items denied because the queue was full
+
+		private:
+			std::shared_ptr<JustificationProvider> mPrimary;
+			const size_t mCapacity;
+			mutable std::mutex mMutex;
+			std::deque<ExecutionStateOptions> mDeferred;
+			uint64_t mDenied = 0;
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_JUSTIFICATION_PROVIDER_H_
@@ -0,0 +1,179 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "label_metadata.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <random>
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace {
+	const string_view kEnabledSuffix = "_Enabled";
+	const string_view kVolatileSuffixes[] = { "_SetDate", "_ActionId" };
+
+	const char* GetMethodName(mip::AssignmentMethod method)
+	{
+		switch (method)
+		{
+		case mip::AssignmentMethod::PRIVILEGED:
+			return "Privileged";
+		case mip::AssignmentMethod::AUTO:
+			return "Auto";
+		default:
+			return "Standard";
+		}
+	}
+
+	string GetUtcTimestamp()
+	{
+		std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+		std::tm utc = {};
+#if defined(_WIN32) || defined(_WIN64)
+		gmtime_s(&utc, &now);
+#else
+		gmtime_r(&now, &utc);
+#endif
+		char buffer[32];
+		std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &utc);
+		return buffer;
+	}
+
+	string NewActionId()
+	{
+		thread_local std::mt19937_64 generator(std::random_device{}());
+		uint64_t high = generator();
+		uint64_t low = generator();
+		char buffer[40];
+		std::snprintf(buffer, sizeof(buffer), "%08x-%04x-%04x-%04x-%012llx",
+			static_cast<unsigned int>(high >> 32), static_cast<unsigned int>((high >> 16) & 0xFFFF), static_cast<unsigned int>(high & 0xFFFF),
+			static_cast<unsigned int>(low >> 48), static_cast<unsigned long long>(low & 0xFFFFFFFFFFFFull));
+		return buffer;
+	}
+
+	bool IsTrue(string_view value)
+	{
+		return value.size() == 4 && std::tolower(static_cast<unsigned char>(value[0])) == 't' &&
+			std::tolower(static_cast<unsigned char>(value[1])) == 'r' &&
+			std::tolower(static_cast<unsigned char>(value[2])) == 'u' &&
+			std::tolower(static_cast<unsigned char>(value[3])) == 'e';
+	}
+
+	// Label ID from an MSIP_Label_<id>_Enabled key, or empty if key is something else.
+	string_view GetEnabledLabelId(string_view key)
+	{
+		string_view prefix(sample::policy::kLabelMetadataPrefix);
+		if (key.size() <= prefix.size() + kEnabledSuffix.size() || key.compare(0, prefix.size(), prefix) != 0 ||
+			key.compare(key.size() - kEnabledSuffix.size(), kEnabledSuffix.size(), kEnabledSuffix) != 0)
+		{
+			return string_view();
+		}
+		return key.substr(prefix.size(), key.size() - prefix.size() - kEnabledSuffix.size());
+	}
+}
+
+namespace sample {
+	namespace policy {
+
+		const char* const kLabelMetadataPrefix = "MSIP_Label_";
+
+		vector<mip::MetadataEntry> BuildLabelMetadata(const mip::Label& label, mip::AssignmentMethod method, const string& siteId)
+		{
+			string keyPrefix = string(kLabelMetadataPrefix) + label.GetId() + "_";
+			vector<mip::MetadataEntry> metadata;
+			metadata.reserve(6);
+			metadata.emplace_back(keyPrefix + "Enabled", "true");
+			metadata.emplace_back(keyPrefix + "SetDate", GetUtcTimestamp());
+			metadata.emplace_back(keyPrefix + "Method", GetMethodName(method));
+			metadata.emplace_back(keyPrefix + "Name", label.GetName());
+			if (!siteId.empty())
+			{
+				metadata.emplace_back(keyPrefix + "SiteId", siteId);
+			}
+			metadata.emplace_back(keyPrefix + "ActionId", NewActionId());
+			return metadata;
+		}
+
+		string FindEnabledLabelId(const vector<mip::MetadataEntry>& metadata)
+		{
+			for (const auto& entry : metadata)
+			{
+				auto labelId = GetEnabledLabelId(entry.GetKey());
+				if (!labelId.empty() && IsTrue(entry.GetValue()))
+				{
+					return string(labelId);
+				}
+			}
+			return string();
+		}
+
+		string FindEnabledLabelId(const std::unordered_map<string, string>& metadata)
+		{
+			for (const auto& entry : metadata)
+			{
+				auto labelId = GetEnabledLabelId(entry.first);
+				if (!labelId.empty() && IsTrue(entry.second))
+				{
+					return string(labelId);
+				}
+			}
+			return string();
+		}
+
+		bool IsLabelMetadataKeyFor(string_view key, string_view labelId)
+		{
+			string_view prefix(kLabelMetadataPrefix);
+			return key.size() > prefix.size() + labelId.size() + 1 && key.compare(0, prefix.size(), prefix) == 0 &&
+				key.compare(prefix.size(), labelId.size(), labelId) == 0 && key[prefix.size() + labelId.size()] == '_';
+		}
+
+		bool IsVolatileLabelMetadataKey(string_view key)
+		{
+			string_view prefix(kLabelMetadataPrefix);
+			if (key.compare(0, prefix.size(), prefix) != 0)
+			{
+				return false;
+			}
+			for (const auto& suffix : kVolatileSuffixes)
+			{
+				if (key.size() > prefix.size() + suffix.size() && key.compare(key.size() - suffix.size(), suffix.size(), suffix) == 0)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+	} //  namespace policy
+} //  namespace sample
@@ -0,0 +1,66 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_LABEL_METADATA_H_
+#define SAMPLES_UPE_LABEL_METADATA_H_
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mip/common_types.h"
+#include "mip/upe/label.h"
+
+namespace sample {
+	namespace policy {
+
+		// Every label metadata key starts with this prefix, followed by the label ID and the property name.
+		extern const char* const kLabelMetadataPrefix;
+
+		// The MSIP_Label_<id>_* entries that mark content as carrying label.
+		std::vector<mip::MetadataEntry> BuildLabelMetadata(
+			const mip::Label& label,
+			mip::AssignmentMethod method,
+			const std::string& siteId);
+
+		// ID of the label whose MSIP_Label_<id>_Enabled entry is "true", or empty if there is none.
+		std::string FindEnabledLabelId(const std::vector<mip::MetadataEntry>& metadata);
+		std::string FindEnabledLabelId(const std::unordered_map<std::string, std::string>& metadata);
+
+		// True if key belongs to the label with ID labelId.
+		bool IsLabelMetadataKeyFor(std::string_view key, std::string_view labelId);
+
+		// True for label entries whose value changes on every evaluation (SetDate, ActionId), so two results can't be
+		// compared on them.
+		bool IsVolatileLabelMetadataKey(std::string_view key);
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_LABEL_METADATA_H_
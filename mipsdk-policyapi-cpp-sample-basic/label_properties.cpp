@@ -0,0 +1,134 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+#include "label_properties.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+#include "json_reader.h"
+#include "mapped_file.h"
+#include "utils.h"
+
+using std::shared_ptr;
+using std::string;
+
+namespace {
+	const int kMaxLabelDepth = 8;
+}
+
+namespace sample {
+	namespace policy {
+
+		shared_ptr<LabelPropertyTable> LabelPropertyTable::LoadFromFile(const string& path)
+		{
+			if (!utils::FileExists(path.c_str()))
+			{
+				throw std::runtime_error("Label property file " + path + " not found");
+			}
+			utils::MappedFile file(path);
+			return Parse(std::string_view(file.GetData(), file.GetSize()));
+		}
+
+		shared_ptr<LabelPropertyTable> LabelPropertyTable::Parse(std::string_view json)
+		{
+			utils::JsonDocument document(json);
+			const auto& root = document.GetRoot();
+			if (!root.IsObject())
+			{
+				throw std::runtime_error("Label properties must be a JSON object keyed by label ID");
+			}
+
+			shared_ptr<LabelPropertyTable> table(new LabelPropertyTable());
+			for (const auto& label : root.GetObject())
+			{
+				if (!label.second.IsObject())
+				{
+					throw std::runtime_error("Properties of label " + string(label.first) + " must be an object");
+				}
+				auto& properties = table->mDeclared[string(label.first)];
+				for (const auto& property : label.second.GetObject())
+				{
+					if (!property.second.IsString())
+					{
+						throw std::runtime_error("Property " + string(property.first) + " of label " + string(label.first) + " must be a string");
+					}
+					properties.emplace_back(string(property.first), string(property.second.GetString()));
+				}
+			}
+			return table;
+		}
+
+		shared_ptr<const ExtendedProperties> LabelPropertyTable::Resolve(const mip::Label& label) const
+		{
+			{
+				std::shared_lock<std::shared_mutex> lock(mMutex);
+				auto found = mResolved.find(label.GetId());
+				if (found != mResolved.end())
+				{
+					return found->second;
+				}
+			}
+
+			// Parents first, so a label's own values replace inherited ones.
+			std::vector<const mip::Label*> chain{ &label };
+			shared_ptr<mip::Label> parent = label.GetParent().lock();
+			for (int depth = 0; parent && depth < kMaxLabelDepth; ++depth, parent = parent->GetParent().lock())
+			{
+				chain.push_back(parent.get());
+			}
+
+			std::map<string, string> merged;
+			for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+			{
+				auto declared = mDeclared.find((*it)->GetId());
+				if (declared == mDeclared.end())
+				{
+					continue;
+				}
+				for (const auto& property : declared->second)
+				{
+					merged[property.first] = property.second;
+				}
+			}
+
+			shared_ptr<const ExtendedProperties> resolved;
+			if (!merged.empty())
+			{
+				resolved = std::make_shared<const ExtendedProperties>(merged.begin(), merged.end());
+			}
+
+			std::unique_lock<std::shared_mutex> lock(mMutex);
+			return mResolved.emplace(label.GetId(), std::move(resolved)).first->second;
+		}
+
+	} //  namespace policy
+} //  namespace sample
@@ -0,0 +1,69 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+#ifndef SAMPLES_UPE_LABEL_PROPERTIES_H_
+#define SAMPLES_UPE_LABEL_PROPERTIES_H_
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "mip/upe/label.h"
+#include "execution_state_impl.h"
+
+namespace sample {
+	namespace policy {
+
+		/**
+		 * @brief Extended properties the application supplies for each label, loaded from a JSON file:
+		 * { "<label ID>": { "<name>": "<value>", ... }, ... }
+		 * A label inherits its parents' properties and overrides those with the same name. Each label is resolved once,
+		 * into an immutable vector sorted by name that every later request for the label shares. Thread safe.
+		 */
+		class LabelPropertyTable final {
+		public:
+			static std::shared_ptr<LabelPropertyTable> LoadFromFile(const std::string& path);
+			static std::shared_ptr<LabelPropertyTable> Parse(std::string_view json);	// Throws std::runtime_error if malformed
+
+			std::shared_ptr<const ExtendedProperties> Resolve(const mip::Label& label) const;	// Null if the label and its parents have none
+
+		private:
+			LabelPropertyTable() = default;
+
+			std::unordered_map<std::string, ExtendedProperties> mDeclared;	// As written in the file, per label ID
+			mutable std::shared_mutex mMutex;
+			mutable std::unordered_map<std::string, std::shared_ptr<const ExtendedProperties>> mResolved;
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_LABEL_PROPERTIES_H_
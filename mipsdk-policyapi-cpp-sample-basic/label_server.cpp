@@ -0,0 +1,621 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "label_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <list>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "mip/upe/metadata_action.h"
+#include "mip/upe/protect_by_template_action.h"
+
+#include "content_profiles.h"
+#include "trace_recorder.h"
+
+using mip::LogLevel;
+using std::string;
+
+namespace {
+	const size_t kFrameHeaderSize = 9;		// u32 length, u8 opcode or status, u32 requestId
+	const size_t kReadSize = 64 * 1024;
+	const uint8_t kStatusOk = 0;
+	const uint8_t kStatusError = 1;
+	const uint8_t kFlagGenerateAuditEvent = 1;
+
+	void PutU32(string& output, uint32_t value)
+	{
+		char bytes[4] = {
+			static_cast<char>(value & 0xFF),
+			static_cast<char>((value >> 8) & 0xFF),
+			static_cast<char>((value >> 16) & 0xFF),
+			static_cast<char>((value >> 24) & 0xFF)
+		};
+		output.append(bytes, sizeof(bytes));
+	}
+
+	void PutString(string& output, const string& value)
+	{
+		PutU32(output, static_cast<uint32_t>(value.size()));
+		output += value;
+	}
+
+	uint32_t GetU32(const char* data)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+		return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+			(static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+	}
+
+	// Bounds-checked reader over a request payload.
+	class PayloadReader {
+	public:
+		explicit PayloadReader(const string& payload) : mPosition(payload.data()), mEnd(payload.data() + payload.size()) {}
+
+		uint8_t U8()
+		{
+			Require(1);
+			return static_cast<uint8_t>(*mPosition++);
+		}
+
+		uint32_t U32()
+		{
+			Require(4);
+			uint32_t value = GetU32(mPosition);
+			mPosition += 4;
+			return value;
+		}
+
+		string String()
+		{
+			uint32_t size = U32();
+			Require(size);
+			string value(mPosition, size);
+			mPosition += size;
+			return value;
+		}
+
+	private:
+		void Require(size_t size) const
+		{
+			if (static_cast<size_t>(mEnd - mPosition) < size)
+			{
+				throw std::runtime_error("Truncated request");
+			}
+		}
+
+		const char* mPosition;
+		const char* mEnd;
+	};
+}
+
+namespace sample {
+	namespace policy {
+
+		struct LabelServer::Connection {
+			explicit Connection(int fd) : fd(fd) {}
+			~Connection()
+			{
+#if !defined(_WIN32) && !defined(_WIN64)
+				close(fd);
+#endif
+			}
+
+			int fd;
+			std::mutex outputMutex;
+			std::string output;					// Whole responses not yet handed to send()
+			bool sending = false;				// A worker is draining output
+			bool closed = false;				// Disconnected; requests still queued are dropped
+			std::atomic<bool> finished{ false };	// Set when the reader thread is done and can be joined
+			std::thread reader;
+		};
+
+		LabelServer::LabelServer(Action& action, const LabelServerSettings& settings)
+			: mAction(action),
+			mSettings(settings),
+			mTasks(settings.queueCapacity)
+		{
+#if !defined(_WIN32) && !defined(_WIN64)
+			if (pipe(mWakeFds) != 0)
+			{
+				throw std::runtime_error("pipe() failed");
+			}
+			fcntl(mWakeFds[0], F_SETFD, FD_CLOEXEC);
+			fcntl(mWakeFds[1], F_SETFD, FD_CLOEXEC);
+#endif
+		}
+
+		LabelServer::~LabelServer()
+		{
+#if !defined(_WIN32) && !defined(_WIN64)
+			for (int fd : mWakeFds)
+			{
+				if (fd >= 0)
+				{
+					close(fd);
+				}
+			}
+#endif
+		}
+
+		void LabelServer::Stop()
+		{
+#if !defined(_WIN32) && !defined(_WIN64)
+			char wake = 1;
+			ssize_t written = write(mWakeFds[1], &wake, 1);
+			(void)written;
+#endif
+		}
+
+#if defined(_WIN32) || defined(_WIN64)
+		void LabelServer::Run()
+		{
+			throw std::runtime_error("LabelServer requires Unix domain sockets and is not supported on Windows");
+		}
+
+		void LabelServer::Serve(std::shared_ptr<Connection> /*connection*/)
+		{
+		}
+
+		void LabelServer::Handle(const std::shared_ptr<Connection>& /*connection*/, Opcode /*opcode*/, uint32_t /*requestId*/, const string& /*payload*/)
+		{
+		}
+
+		void LabelServer::SendQueued(const std::shared_ptr<Connection>& /*connection*/)
+		{
+		}
+
+		void LabelServer::Disconnect(Connection& /*connection*/)
+		{
+		}
+#else
+		void LabelServer::Run()
+		{
+			sockaddr_un address = {};
+			address.sun_family = AF_UNIX;
+			if (mSettings.socketPath.empty() || mSettings.socketPath.size() >= sizeof(address.sun_path))
+			{
+				throw std::runtime_error("Invalid socket path: " + mSettings.socketPath);
+			}
+			std::memcpy(address.sun_path, mSettings.socketPath.c_str(), mSettings.socketPath.size() + 1);
+
+			mListenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (mListenFd < 0)
+			{
+				throw std::runtime_error("socket() failed");
+			}
+			fcntl(mListenFd, F_SETFD, FD_CLOEXEC);
+
+			// A socket left by an earlier run is replaced; anything else at the path is an error.
+			struct stat existing = {};
+			if (lstat(mSettings.socketPath.c_str(), &existing) == 0)
+			{
+				if (!S_ISSOCK(existing.st_mode))
+				{
+					close(mListenFd);
+					mListenFd = -1;
+					throw std::runtime_error(mSettings.socketPath + " exists and is not a socket");
+				}
+				unlink(mSettings.socketPath.c_str());
+			}
+
+			// Only the owner may connect. Requests run with the signed-in user's engine. Connections are refused until
+			// listen(), so restricting the socket file between bind() and listen() leaves no window.
+			if (bind(mListenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+			{
+				close(mListenFd);
+				mListenFd = -1;
+				throw std::runtime_error("Unable to bind " + mSettings.socketPath);
+			}
+			if (chmod(mSettings.socketPath.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(mListenFd, 128) != 0)
+			{
+				unlink(mSettings.socketPath.c_str());
+				close(mListenFd);
+				mListenFd = -1;
+				throw std::runtime_error("Unable to listen on " + mSettings.socketPath);
+			}
+
+			auto& log = mAction.GetLogSink();
+			log->Log(LogLevel::Info, "Listening on %s", mSettings.socketPath.c_str());
+
+			unsigned int workerCount = mSettings.workerThreads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : mSettings.workerThreads;
+			std::vector<std::thread> workers;
+			for (unsigned int i = 0; i < workerCount; ++i)
+			{
+				workers.emplace_back([this]() {
+					std::function<void()> task;
+					while (mTasks.Pop(task))
+					{
+						task();
+					}
+				});
+			}
+
+			std::list<std::shared_ptr<Connection>> connections;
+			for (;;)
+			{
+				struct pollfd fds[2] = { { mListenFd, POLLIN, 0 }, { mWakeFds[0], POLLIN, 0 } };
+				int ready = poll(fds, 2, 1000);
+				if (ready < 0 && errno != EINTR)
+				{
+					break;
+				}
+				if (fds[1].revents != 0)
+				{
+					break;
+				}
+
+				if (fds[0].revents & POLLIN)
+				{
+					int fd = accept(mListenFd, nullptr, nullptr);
+					if (fd >= 0)
+					{
+						fcntl(fd, F_SETFD, FD_CLOEXEC);
+#if defined(SO_NOSIGPIPE)
+						int one = 1;
+						setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+						auto timeoutMs = mSettings.sendTimeout.count();
+						struct timeval sendTimeout = {};
+						sendTimeout.tv_sec = static_cast<decltype(sendTimeout.tv_sec)>(timeoutMs / 1000);
+						sendTimeout.tv_usec = static_cast<decltype(sendTimeout.tv_usec)>((timeoutMs % 1000) * 1000);
+						setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+						auto connection = std::make_shared<Connection>(fd);
+						connection->reader = std::thread(&LabelServer::Serve, this, connection);
+						connections.push_back(connection);
+					}
+				}
+
+				// Reap connections whose clients have gone away.
+				for (auto it = connections.begin(); it != connections.end();)
+				{
+					if ((*it)->finished)
+					{
+						(*it)->reader.join();
+						it = connections.erase(it);
+					}
+					else
+					{
+						++it;
+					}
+				}
+			}
+
+			close(mListenFd);
+			mListenFd = -1;
+			unlink(mSettings.socketPath.c_str());
+
+			// Unblock readers and any worker sending, drop requests still queued, then stop.
+			for (auto& connection : connections)
+			{
+				Disconnect(*connection);
+			}
+			for (auto& connection : connections)
+			{
+				connection->reader.join();
+			}
+			mTasks.Close();
+			for (auto& worker : workers)
+			{
+				worker.join();
+			}
+			log->Log(LogLevel::Info, "Stopped listening on %s", mSettings.socketPath.c_str());
+		}
+
+		void LabelServer::Serve(std::shared_ptr<Connection> connection)
+		{
+			string buffer;
+			size_t consumed = 0;
+			for (;;)
+			{
+				size_t size = buffer.size();
+				buffer.resize(size + kReadSize);
+				ssize_t received = recv(connection->fd, &buffer[size], kReadSize, 0);
+				if (received < 0 && errno == EINTR)
+				{
+					buffer.resize(size);
+					continue;
+				}
+				if (received <= 0)
+				{
+					break;
+				}
+				buffer.resize(size + static_cast<size_t>(received));
+
+				// Dispatch every complete frame. The rest waits for the next read.
+				bool malformed = false;
+				while (buffer.size() - consumed >= 4)
+				{
+					uint32_t length = GetU32(&buffer[consumed]);
+					if (length < kFrameHeaderSize - 4 || length > mSettings.maxFrameSize)
+					{
+						malformed = true;
+						break;
+					}
+					if (buffer.size() - consumed < 4 + static_cast<size_t>(length))
+					{
+						break;
+					}
+
+					auto opcode = static_cast<Opcode>(buffer[consumed + 4]);
+					uint32_t requestId = GetU32(&buffer[consumed + 5]);
+					string payload = buffer.substr(consumed + kFrameHeaderSize, length - (kFrameHeaderSize - 4));
+					consumed += 4 + static_cast<size_t>(length);
+					auto queued = std::chrono::steady_clock::now();
+					mTasks.Push([this, connection, opcode, requestId, payload, queued]() {
+						utils::TraceRequest request(mAction.GetTracer().get());
+						utils::TraceSpan::RecordSince(mAction.GetTracer().get(), "QueueWait", queued);
+						Handle(connection, opcode, requestId, payload);
+					});
+				}
+				if (malformed)
+				{
+					mAction.GetLogSink()->Log(LogLevel::Warning, "Closing connection after a malformed frame");
+					break;
+				}
+				buffer.erase(0, consumed);
+				consumed = 0;
+			}
+			connection->finished = true;
+		}
+
+		void LabelServer::Handle(const std::shared_ptr<Connection>& connection, Opcode opcode, uint32_t requestId, const string& payload)
+		{
+			{
+				std::lock_guard<std::mutex> lock(connection->outputMutex);
+				if (connection->closed)
+				{
+					return;
+				}
+			}
+
+			string response(kFrameHeaderSize, '\0');
+			uint8_t status = kStatusOk;
+			try
+			{
+				switch (opcode)
+				{
+				case Opcode::Ping:
+					break;
+				case Opcode::ListLabels:
+					EncodeLabels(response);
+					break;
+				case Opcode::Compute:
+					EncodeCompute(payload, response);
+					break;
+				default:
+					throw std::runtime_error("Unknown opcode " + std::to_string(static_cast<int>(opcode)));
+				}
+			}
+			catch (const std::exception& ex)
+			{
+				status = kStatusError;
+				response.resize(kFrameHeaderSize);
+				PutString(response, ex.what());
+			}
+
+			string header;
+			PutU32(header, static_cast<uint32_t>(response.size() - 4));
+			header += static_cast<char>(status);
+			PutU32(header, requestId);
+			response.replace(0, kFrameHeaderSize, header);
+
+			{
+				std::lock_guard<std::mutex> lock(connection->outputMutex);
+				if (connection->closed)
+				{
+					return;
+				}
+				if (connection->output.size() + response.size() > mSettings.maxPendingOutput)
+				{
+					mAction.GetLogSink()->Log(LogLevel::Warning, "Disconnecting a client with %zu bytes of unread responses", connection->output.size());
+					connection->closed = true;
+					connection->output.clear();
+					shutdown(connection->fd, SHUT_RDWR);
+					return;
+				}
+				connection->output += response;
+				if (connection->sending)
+				{
+					return;
+				}
+				connection->sending = true;
+			}
+			SendQueued(connection);
+		}
+
+		// Runs on the worker that found nobody sending. Responses queued meanwhile by other workers are sent too.
+		void LabelServer::SendQueued(const std::shared_ptr<Connection>& connection)
+		{
+#if defined(MSG_NOSIGNAL)
+			const int sendFlags = MSG_NOSIGNAL;
+#else
+			const int sendFlags = 0;
+#endif
+			string pending;
+			for (;;)
+			{
+				{
+					std::lock_guard<std::mutex> lock(connection->outputMutex);
+					if (connection->closed || connection->output.empty())
+					{
+						connection->sending = false;
+						return;
+					}
+					pending.clear();
+					pending.swap(connection->output);
+				}
+
+				size_t offset = 0;
+				while (offset < pending.size())
+				{
+					ssize_t sent = send(connection->fd, pending.data() + offset, pending.size() - offset, sendFlags);
+					if (sent < 0 && errno == EINTR)
+					{
+						continue;
+					}
+					if (sent < 0)
+					{
+						// A timeout (EAGAIN) means the client stopped reading; anything else means it went away.
+						if (errno == EAGAIN || errno == EWOULDBLOCK)
+						{
+							mAction.GetLogSink()->Log(LogLevel::Warning, "Disconnecting a client that stopped reading responses");
+						}
+						std::lock_guard<std::mutex> lock(connection->outputMutex);
+						connection->sending = false;
+						connection->closed = true;
+						connection->output.clear();
+						shutdown(connection->fd, SHUT_RDWR);
+						return;
+					}
+					offset += static_cast<size_t>(sent);
+				}
+			}
+		}
+
+		// The reader sees end of file, a worker blocked in send() fails at once, and queued requests are skipped.
+		void LabelServer::Disconnect(Connection& connection)
+		{
+			std::lock_guard<std::mutex> lock(connection.outputMutex);
+			connection.closed = true;
+			connection.output.clear();
+			shutdown(connection.fd, SHUT_RDWR);
+		}
+#endif
+
+		void LabelServer::EncodeLabels(string& response)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mLabelsMutex);
+				if (!mEncodedLabels.empty())
+				{
+					response += mEncodedLabels;
+					return;
+				}
+			}
+
+			// Labels served from the snapshot are re-read until the engine has loaded. After that the encoding is reused.
+			bool fromEngine = mAction.IsEngineReady();
+			auto labels = mAction.GetLabels();
+			string encoded;
+			PutU32(encoded, static_cast<uint32_t>(labels.size()));
+			for (const auto& label : labels)
+			{
+				PutString(encoded, label.id);
+				PutString(encoded, label.name);
+				PutString(encoded, label.parentId);
+				PutU32(encoded, static_cast<uint32_t>(label.sensitivity));
+				encoded += static_cast<char>(label.isActive ? 1 : 0);
+			}
+			response += encoded;
+
+			if (fromEngine)
+			{
+				std::lock_guard<std::mutex> lock(mLabelsMutex);
+				mEncodedLabels = std::move(encoded);
+			}
+		}
+
+		void LabelServer::EncodeCompute(const string& payload, string& response)
+		{
+			PayloadReader reader(payload);
+			ExecutionStateOptions options;
+			options.contentIdentifier = reader.String();
+			string labelId = reader.String();
+			options.templateId = reader.String();
+			options.downgradeJustification = reader.String();
+			options.isDowngradeJustified = !options.downgradeJustification.empty();
+			uint8_t dataState = reader.U8();
+			if (dataState > static_cast<uint8_t>(mip::DataState::USE))
+			{
+				throw std::runtime_error("Invalid data state");
+			}
+			options.dataState = static_cast<mip::DataState>(dataState);
+			options.generateAuditEvent = (reader.U8() & kFlagGenerateAuditEvent) != 0;
+			uint32_t metadataCount = reader.U32();
+			for (uint32_t i = 0; i < metadataCount; ++i)
+			{
+				string key = reader.String();
+				options.metadata[std::move(key)] = reader.String();
+			}
+			const auto& profile = GetContentProfile(options.contentIdentifier);
+			options.contentFormat = profile.GetContentFormat();
+			options.supportedActions = profile.supportedActions;
+			options.newLabel = mAction.GetLabelById(labelId);
+			if (!options.newLabel)
+			{
+				throw std::runtime_error("Label not found: " + labelId);
+			}
+
+			auto actions = mAction.ComputeAction(options);
+			PutU32(response, static_cast<uint32_t>(actions.size()));
+			for (const auto& action : actions)
+			{
+				auto type = action->GetType();
+				PutU32(response, static_cast<uint32_t>(type));
+				if (type == mip::ActionType::METADATA)
+				{
+					auto metadataAction = static_cast<mip::MetadataAction*>(action.get());
+					const auto& toRemove = metadataAction->GetMetadataToRemove();
+					PutU32(response, static_cast<uint32_t>(toRemove.size()));
+					for (const auto& key : toRemove)
+					{
+						PutString(response, key);
+					}
+					const auto& toAdd = metadataAction->GetMetadataToAdd();
+					PutU32(response, static_cast<uint32_t>(toAdd.size()));
+					for (const auto& entry : toAdd)
+					{
+						PutString(response, entry.GetKey());
+						PutString(response, entry.GetValue());
+					}
+				}
+				else if (type == mip::ActionType::PROTECT_BY_TEMPLATE)
+				{
+					PutString(response, static_cast<mip::ProtectByTemplateAction*>(action.get())->GetTemplateId());
+				}
+			}
+		}
+
+	} //  namespace policy
+} //  namespace sample
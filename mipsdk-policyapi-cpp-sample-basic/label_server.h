@@ -0,0 +1,112 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_LABEL_SERVER_H_
+#define SAMPLES_UPE_LABEL_SERVER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "action.h"
+#include "bounded_queue.h"
+
+namespace sample {
+	namespace policy {
+
+		struct LabelServerSettings {
+			std::string socketPath;				// An existing socket is replaced; any other file is an error. Owner-only.
+			unsigned int workerThreads = 0;		// Threads evaluating requests. Zero uses all cores.
+			size_t queueCapacity = 4096;		// Requests read but not yet evaluated. Readers wait when it is full.
+			uint32_t maxFrameSize = 1 << 20;	// Larger frames close the connection
+			std::chrono::milliseconds sendTimeout{ 5000 };	// A client that doesn't read its responses for this long is disconnected
+			size_t maxPendingOutput = 16 << 20;	// Bytes of responses queued for one client. More disconnects it.
+		};
+
+		/**
+		 * @brief Serves label listing and ComputeActions over a Unix domain socket.
+		 * One Action, with its engine, label index and caches, stays resident for the lifetime of the server.
+		 *
+		 * All integers are little endian. Strings are a u32 byte count followed by UTF-8 bytes.
+		 * Request:  u32 length (of what follows), u8 opcode, u32 requestId, payload
+		 * Response: u32 length (of what follows), u8 status, u32 requestId, payload
+		 * A connection may send any number of requests without waiting. Responses can arrive in any order and are
+		 * matched by requestId. An error response has status 1 and a string message as its payload.
+		 * Responses are queued per connection and sent by one worker at a time, so a client that stops reading holds up
+		 * at most one worker, for at most sendTimeout, before it is disconnected.
+		 *
+		 * Ping (0):       empty request and response payloads.
+		 * ListLabels (1): response is u32 count, then per label: id, name, parentId, i32 sensitivity, u8 isActive.
+		 * Compute (2):    contentIdentifier, newLabelId, templateId, downgradeJustification (empty if none),
+		 *                 u8 dataState, u8 flags (1 = generate audit event), u32 metadata count, then key/value pairs.
+		 *                 Response is u32 action count, then per action: u32 mip::ActionType, and for METADATA
+		 *                 u32 count + keys to remove, u32 count + key/value pairs to add, or for PROTECT_BY_TEMPLATE
+		 *                 the template ID. Other action types carry no details.
+		 */
+		class LabelServer final {
+		public:
+			enum class Opcode : uint8_t { Ping = 0, ListLabels = 1, Compute = 2 };
+
+			LabelServer(Action& action, const LabelServerSettings& settings);
+			~LabelServer();
+
+			LabelServer(const LabelServer&) = delete;
+			LabelServer& operator=(const LabelServer&) = delete;
+
+			// Serves until Stop() is called. Throws std::runtime_error if the socket can't be set up, or on Windows.
+			void Run();
+			// Only writes to a pipe, so it is safe to call from a signal handler.
+			void Stop();
+
+		private:
+			struct Connection;
+
+			void Serve(std::shared_ptr<Connection> connection);
+			void Handle(const std::shared_ptr<Connection>& connection, Opcode opcode, uint32_t requestId, const std::string& payload);
+			void SendQueued(const std::shared_ptr<Connection>& connection);
+			void Disconnect(Connection& connection);
+			void EncodeLabels(std::string& response);
+			void EncodeCompute(const std::string& payload, std::string& response);
+
+			Action& mAction;
+			LabelServerSettings mSettings;
+			utils::BoundedQueue<std::function<void()>> mTasks;
+			int mListenFd = -1;
+			int mWakeFds[2] = { -1, -1 };
+
+			std::mutex mLabelsMutex;
+			std::string mEncodedLabels;	// ListLabels payload, kept once it comes from the loaded engine
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_LABEL_SERVER_H_
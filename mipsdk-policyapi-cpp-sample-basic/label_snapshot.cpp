@@ -0,0 +1,349 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "label_snapshot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using std::runtime_error;
+using std::shared_ptr;
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace {
+	const char kSnapshotMagic[8] = { 'M', 'I', 'P', 'L', 'B', 'L', 'S', '\0' };
+	const uint32_t kFlagActive = 1;
+
+	std::atomic<uint32_t> gNextTempFile(0);
+
+	// Unique per process and call, so concurrent writers never share a temporary file.
+	string GetTempPath(const string& path)
+	{
+#if defined(_WIN32) || defined(_WIN64)
+		unsigned long processId = GetCurrentProcessId();
+#else
+		unsigned long processId = static_cast<unsigned long>(getpid());
+#endif
+		return path + "." + std::to_string(processId) + "." + std::to_string(gNextTempFile.fetch_add(1)) + ".tmp";
+	}
+
+	// Layout of the file: header, label records sorted by ID, string table. All integers are stored in native
+	// byte order; the snapshot is a local cache and is never shared between machines.
+	struct SnapshotHeader {
+		char magic[8];
+		uint32_t formatVersion;
+		uint32_t labelCount;
+		uint64_t recordsOffset;
+		uint64_t stringsOffset;
+		uint64_t stringsLength;
+		uint32_t policyVersionOffset;
+		uint32_t policyVersionLength;
+		uint32_t ownerOffset;
+		uint32_t ownerLength;
+		int64_t writtenTime;	// Seconds since the epoch
+	};
+
+	int64_t GetUnixTime()
+	{
+		return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	struct PendingLabel {
+		std::shared_ptr<mip::Label> label;
+		string parentId;
+	};
+
+	void Flatten(const vector<shared_ptr<mip::Label>>& labels, const string& parentId, vector<PendingLabel>& output)
+	{
+		for (const auto& label : labels)
+		{
+			output.push_back({ label, parentId });
+			Flatten(label->GetChildren(), label->GetId(), output);
+		}
+	}
+
+	uint32_t AppendString(string& table, const string& value)
+	{
+		auto offset = static_cast<uint32_t>(table.size());
+		table += value;
+		return offset;
+	}
+}
+
+namespace sample {
+	namespace policy {
+
+		struct LabelSnapshot::Record {
+			uint32_t idOffset;
+			uint32_t idLength;
+			uint32_t nameOffset;
+			uint32_t nameLength;
+			int32_t parentIndex;	// -1 for top level labels
+			int32_t sensitivity;
+			uint32_t flags;
+			uint32_t reserved;
+		};
+
+		void LabelSnapshot::Write(
+			const string& path,
+			const string& owner,
+			const string& policyVersion,
+			const vector<shared_ptr<mip::Label>>& labels)
+		{
+			vector<PendingLabel> pending;
+			Flatten(labels, "", pending);
+			std::sort(pending.begin(), pending.end(), [](const PendingLabel& left, const PendingLabel& right) {
+				return left.label->GetId() < right.label->GetId();
+			});
+
+			std::unordered_map<string, int32_t> indexById;
+			for (size_t i = 0; i < pending.size(); ++i)
+			{
+				indexById.emplace(pending[i].label->GetId(), static_cast<int32_t>(i));
+			}
+
+			string strings;
+			vector<Record> records;
+			records.reserve(pending.size());
+			for (const auto& item : pending)
+			{
+				Record record = {};
+				record.idLength = static_cast<uint32_t>(item.label->GetId().size());
+				record.idOffset = AppendString(strings, item.label->GetId());
+				record.nameLength = static_cast<uint32_t>(item.label->GetName().size());
+				record.nameOffset = AppendString(strings, item.label->GetName());
+				auto parent = indexById.find(item.parentId);
+				record.parentIndex = parent == indexById.end() ? -1 : parent->second;
+				record.sensitivity = item.label->GetSensitivity();
+				record.flags = item.label->IsActive() ? kFlagActive : 0;
+				records.push_back(record);
+			}
+
+			SnapshotHeader header = {};
+			std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+			header.formatVersion = kFormatVersion;
+			header.labelCount = static_cast<uint32_t>(records.size());
+			header.recordsOffset = sizeof(SnapshotHeader);
+			header.stringsOffset = header.recordsOffset + records.size() * sizeof(Record);
+			header.policyVersionLength = static_cast<uint32_t>(policyVersion.size());
+			header.policyVersionOffset = AppendString(strings, policyVersion);
+			header.ownerLength = static_cast<uint32_t>(owner.size());
+			header.ownerOffset = AppendString(strings, owner);
+			header.writtenTime = GetUnixTime();
+			header.stringsLength = strings.size();
+
+			// Write to a temporary file first so a reader never maps a partially written snapshot.
+			string tempPath = GetTempPath(path);
+			{
+				std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+				if (!file)
+				{
+					throw runtime_error("Unable to create label snapshot " + tempPath);
+				}
+				file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+				file.write(strings.data(), strings.size());
+				file.close();
+				if (!file)
+				{
+					std::remove(tempPath.c_str());
+					throw runtime_error("Unable to write label snapshot " + tempPath);
+				}
+			}
+
+#if defined(_WIN32) || defined(_WIN64)
+			bool replaced = MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+			bool replaced = std::rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+			if (!replaced)
+			{
+				std::remove(tempPath.c_str());
+				throw runtime_error("Unable to replace label snapshot " + path);
+			}
+		}
+
+		shared_ptr<LabelSnapshot> LabelSnapshot::Open(const string& path, const string& owner, std::chrono::seconds maxAge)
+		{
+			utils::MappedFile file;
+			try
+			{
+				file = utils::MappedFile(path);
+			}
+			catch (const std::exception&)
+			{
+				return nullptr;
+			}
+
+			shared_ptr<LabelSnapshot> snapshot(new LabelSnapshot(std::move(file)));
+			if (!snapshot->Validate(owner, maxAge))
+			{
+				return nullptr;
+			}
+			return snapshot;
+		}
+
+		LabelSnapshot::LabelSnapshot(utils::MappedFile&& file) : mFile(std::move(file))
+		{
+		}
+
+		bool LabelSnapshot::Validate(const string& owner, std::chrono::seconds maxAge)
+		{
+			if (mFile.GetSize() < sizeof(SnapshotHeader))
+			{
+				return false;
+			}
+
+			SnapshotHeader header;
+			std::memcpy(&header, mFile.GetData(), sizeof(header));
+			if (std::memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 || header.formatVersion != kFormatVersion)
+			{
+				return false;
+			}
+
+			uint64_t recordsEnd = header.recordsOffset + uint64_t(header.labelCount) * sizeof(Record);
+			if (header.recordsOffset % alignof(Record) != 0 || recordsEnd != header.stringsOffset ||
+				header.stringsOffset + header.stringsLength != mFile.GetSize() ||
+				uint64_t(header.policyVersionOffset) + header.policyVersionLength > header.stringsLength ||
+				uint64_t(header.ownerOffset) + header.ownerLength > header.stringsLength)
+			{
+				return false;
+			}
+
+			// Another identity or policy source, or old enough that the policy may have changed.
+			string_view strings(mFile.GetData() + header.stringsOffset, header.stringsLength);
+			if (strings.substr(header.ownerOffset, header.ownerLength) != owner)
+			{
+				return false;
+			}
+			if (maxAge.count() > 0 && GetUnixTime() - header.writtenTime > maxAge.count())
+			{
+				return false;
+			}
+
+			auto records = reinterpret_cast<const Record*>(mFile.GetData() + header.recordsOffset);
+			for (uint32_t i = 0; i < header.labelCount; ++i)
+			{
+				const Record& record = records[i];
+				if (uint64_t(record.idOffset) + record.idLength > header.stringsLength ||
+					uint64_t(record.nameOffset) + record.nameLength > header.stringsLength ||
+					record.parentIndex >= static_cast<int32_t>(header.labelCount))
+				{
+					return false;
+				}
+			}
+
+			mRecords = records;
+			mLabelCount = header.labelCount;
+			mStrings = mFile.GetData() + header.stringsOffset;
+			mPolicyVersion = GetString(header.policyVersionOffset, header.policyVersionLength);
+			return true;
+		}
+
+		string_view LabelSnapshot::GetString(uint32_t offset, uint32_t length) const
+		{
+			return string_view(mStrings + offset, length);
+		}
+
+		const LabelSnapshot::Record* LabelSnapshot::Find(string_view labelId) const
+		{
+			auto end = mRecords + mLabelCount;
+			auto it = std::lower_bound(mRecords, end, labelId, [this](const Record& record, string_view id) {
+				return GetString(record.idOffset, record.idLength) < id;
+			});
+			if (it == end || GetString(it->idOffset, it->idLength) != labelId)
+			{
+				return nullptr;
+			}
+			return it;
+		}
+
+		void LabelSnapshot::CopyRecord(const Record& record, LabelInfo& info) const
+		{
+			info.id = string(GetString(record.idOffset, record.idLength));
+			info.name = string(GetString(record.nameOffset, record.nameLength));
+			if (record.parentIndex >= 0)
+			{
+				const Record& parent = mRecords[record.parentIndex];
+				info.parentId = string(GetString(parent.idOffset, parent.idLength));
+			}
+			else
+			{
+				info.parentId.clear();
+			}
+			info.sensitivity = record.sensitivity;
+			info.isActive = (record.flags & kFlagActive) != 0;
+		}
+
+		bool LabelSnapshot::FindLabel(string_view labelId, LabelInfo& info) const
+		{
+			auto record = Find(labelId);
+			if (record == nullptr)
+			{
+				return false;
+			}
+			CopyRecord(*record, info);
+			return true;
+		}
+
+		bool LabelSnapshot::IsValidLabel(string_view labelId) const
+		{
+			auto record = Find(labelId);
+			return record != nullptr && (record->flags & kFlagActive) != 0;
+		}
+
+		vector<LabelInfo> LabelSnapshot::ListLabels() const
+		{
+			vector<LabelInfo> labels(mLabelCount);
+			for (size_t i = 0; i < mLabelCount; ++i)
+			{
+				CopyRecord(mRecords[i], labels[i]);
+			}
+			return labels;
+		}
+
+		string_view LabelSnapshot::GetPolicyVersion() const
+		{
+			return mPolicyVersion;
+		}
+
+	} //  namespace policy
+} //  namespace sample
@@ -0,0 +1,102 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_LABEL_SNAPSHOT_H_
+#define SAMPLES_UPE_LABEL_SNAPSHOT_H_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mip/upe/label.h"
+#include "mapped_file.h"
+
+namespace sample {
+	namespace policy {
+
+		// Owning copy of the label fields the sample needs to resolve and validate a label without an engine.
+		struct LabelInfo {
+			std::string id;
+			std::string name;
+			std::string parentId;
+			int sensitivity = 0;
+			bool isActive = false;
+		};
+
+		/**
+		 * @brief Versioned, memory-mappable copy of a policy engine's label table.
+		 * The file is written after each successful engine load and can be opened by a fresh process to answer
+		 * label lookups before the engine is available. Records are sorted by label ID, so a lookup is a binary
+		 * search over the mapping with no parsing or allocation.
+		 * A snapshot is only opened by the owner it was written for (identity, tenant and policy source) and only while
+		 * it is younger than a maximum age, since the policy may have changed since it was written.
+		 */
+		class LabelSnapshot final {
+		public:
+			static const uint32_t kFormatVersion = 2;
+
+			// Writes labels (and all of their children) to path for owner. The file is replaced atomically.
+			static void Write(
+				const std::string& path,
+				const std::string& owner,
+				const std::string& policyVersion,
+				const std::vector<std::shared_ptr<mip::Label>>& labels);
+
+			// Returns nullptr if the file does not exist, is truncated, was written by a different format version or for
+			// a different owner, or is older than maxAge. A zero maxAge accepts any age.
+			static std::shared_ptr<LabelSnapshot> Open(const std::string& path, const std::string& owner, std::chrono::seconds maxAge);
+
+			bool FindLabel(std::string_view labelId, LabelInfo& info) const;
+			bool IsValidLabel(std::string_view labelId) const;	// Label exists and is active
+			std::vector<LabelInfo> ListLabels() const;
+			std::string_view GetPolicyVersion() const;
+			size_t GetLabelCount() const { return mLabelCount; }
+
+		private:
+			struct Record;
+
+			explicit LabelSnapshot(utils::MappedFile&& file);
+			bool Validate(const std::string& owner, std::chrono::seconds maxAge);
+			const Record* Find(std::string_view labelId) const;
+			std::string_view GetString(uint32_t offset, uint32_t length) const;
+			void CopyRecord(const Record& record, LabelInfo& info) const;
+
+			utils::MappedFile mFile;
+			const Record* mRecords = nullptr;
+			size_t mLabelCount = 0;
+			const char* mStrings = nullptr;
+			std::string_view mPolicyVersion;
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_LABEL_SNAPSHOT_H_
@@ -0,0 +1,239 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "labeling_pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "content_profiles.h"
+#include "trace_recorder.h"
+#include "utils.h"
+
+using mip::LogLevel;
+using std::string;
+
+namespace {
+	struct QueuedItem {
+		sample::policy::ExecutionStateOptions options;
+		std::chrono::steady_clock::time_point enqueued;	// Start of the item's queue wait in traces
+	};
+}
+
+namespace sample {
+	namespace policy {
+
+		LabelingPipeline::LabelingPipeline(Action& action, const LabelingPipelineSettings& settings)
+			: mAction(action),
+			mSettings(settings),
+			mMetadataReader(settings.metadataReader, action.GetLogSink())
+		{
+		}
+
+		ExecutionStateOptions LabelingPipeline::BuildOptions(const string& path, const std::shared_ptr<mip::Label>& label) const
+		{
+			ExecutionStateOptions options;
+			options.newLabel = label;
+			options.contentIdentifier = path;
+			const auto& profile = GetContentProfile(path);
+			options.contentFormat = profile.GetContentFormat();
+			options.supportedActions = profile.supportedActions;
+			options.actionSource = mSettings.actionSource;
+			options.assignmentMethod = mSettings.assignmentMethod;
+			options.dataState = mip::DataState::REST;
+			options.generateAuditEvent = mSettings.generateAuditEvents;
+			mMetadataReader.Read(path, options.metadata, &options.templateId);
+			return options;
+		}
+
+		LabelingPipelineStats LabelingPipeline::Run(const string& root, const string& labelId)
+		{
+			auto start = std::chrono::steady_clock::now();
+			auto label = mAction.GetLabelById(labelId);
+			if (!label)
+			{
+				throw std::runtime_error("Label " + labelId + " not found");
+			}
+
+			auto tracer = mAction.GetTracer().get();
+			auto justifications = mAction.GetJustificationProvider();
+			utils::BoundedQueue<QueuedItem> queue(mSettings.queueCapacity);
+			Counters counters;
+
+			unsigned int computeThreads = mSettings.computeThreads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : mSettings.computeThreads;
+			std::vector<std::thread> workers;
+			for (unsigned int i = 0; i < computeThreads; ++i)
+			{
+				workers.emplace_back([&]() {
+					QueuedItem item;
+					while (queue.Pop(item))
+					{
+						// Every evaluation of the item belongs to one traced request.
+						utils::TraceRequest request(tracer);
+						utils::TraceSpan::RecordSince(tracer, "QueueWait", item.enqueued);
+						Evaluate(item.options, *justifications, counters);
+					}
+				});
+			}
+
+			// Items queued before a crawl failure are still evaluated and written before it is rethrown.
+			utils::DirectoryCrawler crawler(mSettings.crawlerThreads);
+			LabelingPipelineStats stats;
+			std::exception_ptr crawlError;
+			try
+			{
+				stats.crawl = crawler.Crawl(root, [&](const string& path) {
+					queue.Push(QueuedItem{ BuildOptions(path, label), std::chrono::steady_clock::now() });
+				});
+			}
+			catch (...)
+			{
+				crawlError = std::current_exception();
+			}
+
+			queue.Close();
+			for (auto& worker : workers)
+			{
+				worker.join();
+			}
+			FlushWriters();
+			if (crawlError)
+			{
+				std::rethrow_exception(crawlError);
+			}
+
+			CopyCounters(counters, stats);
+			stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			return stats;
+		}
+
+		// Runs on the calling thread: the justifications it needs may come from a prompt. Items deferred again during the
+		// pass are left for a later pass rather than retried in a loop.
+		LabelingPipelineStats LabelingPipeline::RetryDeferred(DeferredJustificationProvider& deferred, JustificationProvider& justifications)
+		{
+			auto start = std::chrono::steady_clock::now();
+			Counters counters;
+			ExecutionStateOptions options;
+			for (size_t remaining = deferred.GetDeferredCount(); remaining > 0 && deferred.TakeDeferred(options); --remaining)
+			{
+				utils::TraceRequest request(mAction.GetTracer().get());
+				options.isDowngradeJustified = false;
+				options.downgradeJustification.clear();
+				Evaluate(options, justifications, counters);
+			}
+			FlushWriters();
+
+			LabelingPipelineStats stats;
+			CopyCounters(counters, stats);
+			stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			return stats;
+		}
+
+		// A downgrade needs a justification. The provider is asked rather than stalling on a prompt, and the item is
+		// skipped if the justification is deferred or denied.
+		void LabelingPipeline::Evaluate(ExecutionStateOptions& options, JustificationProvider& justifications, Counters& counters)
+		{
+			auto& log = mAction.GetLogSink();
+			try
+			{
+				ActionResults actions(mAction.ComputeAction(options));
+				counters.evaluated.fetch_add(1, std::memory_order_relaxed);
+
+				if (actions.Contains(mip::ActionType::JUSTIFY))
+				{
+					if (justifications.GetJustification(options, options.downgradeJustification) != JustificationResult::Provided)
+					{
+						counters.deferred.fetch_add(1, std::memory_order_relaxed);
+						if (mSettings.resultsWriter)
+						{
+							mSettings.resultsWriter->Record(options, actions, ResultOutcome::Deferred);
+						}
+						return;
+					}
+					options.isDowngradeJustified = true;
+					actions = ActionResults(mAction.ComputeAction(options));
+				}
+
+				if (!actions.empty())
+				{
+					counters.withActions.fetch_add(1, std::memory_order_relaxed);
+					if (mSettings.metadataWriter)
+					{
+						MetadataPatch patch;
+						patch.contentIdentifier = options.contentIdentifier;
+						for (const auto& result : actions)
+						{
+							patch.AddResult(result);
+						}
+						mSettings.metadataWriter->Submit(std::move(patch));
+					}
+				}
+				if (mSettings.resultsWriter)
+				{
+					mSettings.resultsWriter->Record(options, actions, ResultOutcome::Evaluated);
+				}
+				log->Log(LogLevel::Trace, "%s: %zu action(s)", options.contentIdentifier.c_str(), actions.size());
+			}
+			catch (const std::exception& ex)
+			{
+				counters.failed.fetch_add(1, std::memory_order_relaxed);
+				if (mSettings.resultsWriter)
+				{
+					mSettings.resultsWriter->Record(options, ActionResults(), ResultOutcome::Failed);
+				}
+				log->Log(LogLevel::Warning, "%s: %s", options.contentIdentifier.c_str(), ex.what());
+			}
+		}
+
+		void LabelingPipeline::FlushWriters()
+		{
+			if (mSettings.metadataWriter)
+			{
+				mSettings.metadataWriter->Flush();
+			}
+			if (mSettings.resultsWriter)
+			{
+				mSettings.resultsWriter->Flush();
+			}
+		}
+
+		void LabelingPipeline::CopyCounters(const Counters& counters, LabelingPipelineStats& stats)
+		{
+			stats.evaluated = counters.evaluated;
+			stats.withActions = counters.withActions;
+			stats.failed = counters.failed;
+			stats.deferred = counters.deferred;
+		}
+
+	} //  namespace policy
+} //  namespace sample
@@ -0,0 +1,108 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_LABELING_PIPELINE_H_
+#define SAMPLES_UPE_LABELING_PIPELINE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "mip/common_types.h"
+#include "action.h"
+#include "directory_crawler.h"
+#include "execution_state_impl.h"
+#include "justification_provider.h"
+#include "metadata_reader.h"
+#include "metadata_writer.h"
+#include "results_report.h"
+
+namespace sample {
+	namespace policy {
+
+		struct LabelingPipelineSettings {
+			unsigned int crawlerThreads = 0;		// Zero uses all cores
+			unsigned int computeThreads = 0;		// Zero uses all cores
+			size_t queueCapacity = 1024;			// Items crawled but not yet evaluated. The crawler waits when it is full.
+			mip::ActionSource actionSource = mip::ActionSource::MANUAL;
+			mip::AssignmentMethod assignmentMethod = mip::AssignmentMethod::STANDARD;
+			bool generateAuditEvents = false;
+			MetadataReaderSettings metadataReader;	// Where existing label metadata is looked for
+			std::shared_ptr<MetadataWriter> metadataWriter;	// Applies the resulting metadata changes. Null only evaluates.
+			std::shared_ptr<ResultsWriter> resultsWriter;	// Stores every item's outcome in a columnar file. Null keeps only the totals.
+		};
+
+		struct LabelingPipelineStats {
+			utils::CrawlStats crawl;
+			uint64_t evaluated = 0;		// Items ComputeAction returned for
+			uint64_t withActions = 0;	// Items that need at least one action
+			uint64_t failed = 0;		// Items ComputeAction threw for
+			uint64_t deferred = 0;		// Items left unchanged because a justification was deferred or denied
+			double seconds = 0;
+		};
+
+		/**
+		 * @brief Applies a label to every file under a directory.
+		 * A DirectoryCrawler builds ExecutionStateOptions for each file and pushes them into a bounded queue consumed by
+		 * compute threads, so crawling and evaluation overlap and the crawler is held back when evaluation falls behind.
+		 * Label metadata already stored with each file is read on the crawler threads, so a relabel is a single
+		 * ComputeActions call per file.
+		 */
+		class LabelingPipeline final {
+		public:
+			LabelingPipeline(Action& action, const LabelingPipelineSettings& settings);
+
+			LabelingPipelineStats Run(const std::string& root, const std::string& labelId);
+
+			// Evaluates the items deferred for a justification again, asking justifications this time. Items it doesn't
+			// justify are counted as deferred again. Each retried item adds a second row to the results.
+			LabelingPipelineStats RetryDeferred(DeferredJustificationProvider& deferred, JustificationProvider& justifications);
+
+		private:
+			struct Counters {
+				std::atomic<uint64_t> evaluated{ 0 };
+				std::atomic<uint64_t> withActions{ 0 };
+				std::atomic<uint64_t> failed{ 0 };
+				std::atomic<uint64_t> deferred{ 0 };
+			};
+
+			ExecutionStateOptions BuildOptions(const std::string& path, const std::shared_ptr<mip::Label>& label) const;
+			void Evaluate(ExecutionStateOptions& options, JustificationProvider& justifications, Counters& counters);
+			void FlushWriters();
+			static void CopyCounters(const Counters& counters, LabelingPipelineStats& stats);
+
+			Action& mAction;
+			LabelingPipelineSettings mSettings;
+			MetadataReader mMetadataReader;
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_LABELING_PIPELINE_H_
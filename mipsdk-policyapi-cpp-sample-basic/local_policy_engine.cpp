@@ -0,0 +1,236 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "local_policy_engine.h"
+
+#include <functional>
+#include <stdexcept>
+
+#include "mip/upe/justify_action.h"
+#include "mip/upe/metadata_action.h"
+#include "mip/upe/protect_by_template_action.h"
+#include "mip/upe/remove_protection_action.h"
+
+#include "json_reader.h"
+#include "label_metadata.h"
+#include "mapped_file.h"
+
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace {
+	const int kMaxLabelDepth = 8;
+}
+
+namespace sample {
+	namespace policy {
+
+		vector<shared_ptr<mip::Action>> LocalPolicyHandler::ComputeActions(const mip::ExecutionState& state) const
+		{
+			auto metadata = state.GetContentMetadata(vector<string>(), vector<string>{ kLabelMetadataPrefix });
+			string currentLabelId = FindEnabledLabelId(metadata);
+			const LocalLabel* currentLabel = currentLabelId.empty() ? nullptr : mEngine->FindLabel(currentLabelId);
+
+			auto newLabel = state.GetNewLabel();
+			const LocalLabel* targetLabel = nullptr;
+			if (newLabel)
+			{
+				targetLabel = mEngine->FindLabel(newLabel->GetId());
+				if (targetLabel == nullptr)
+				{
+					throw std::runtime_error("Label " + newLabel->GetId() + " is not in the local policy");
+				}
+			}
+
+			string currentTemplateId;
+			auto protection = state.GetProtectionDescriptor();
+			if (protection)
+			{
+				currentTemplateId = protection->GetTemplateId();
+			}
+
+			vector<shared_ptr<mip::Action>> actions;
+
+			// A downgrade needs a justification before anything else happens.
+			bool isDowngrade = currentLabel != nullptr &&
+				(targetLabel == nullptr || targetLabel->GetSensitivity() < currentLabel->GetSensitivity());
+			if (isDowngrade && mEngine->IsDowngradeJustificationRequired() && !state.IsDowngradeJustified().first)
+			{
+				actions.push_back(make_shared<mip::JustifyAction>());
+				return actions;
+			}
+
+			string targetLabelId = targetLabel != nullptr ? targetLabel->GetId() : string();
+			if (targetLabelId != currentLabelId)
+			{
+				vector<string> metadataToRemove;
+				if (!currentLabelId.empty())
+				{
+					for (const auto& entry : metadata)
+					{
+						if (IsLabelMetadataKeyFor(entry.GetKey(), currentLabelId))
+						{
+							metadataToRemove.push_back(entry.GetKey());
+						}
+					}
+				}
+				vector<mip::MetadataEntry> metadataToAdd;
+				if (targetLabel != nullptr)
+				{
+					metadataToAdd = BuildLabelMetadata(*targetLabel, state.GetNewLabelAssignmentMethod(), mEngine->GetTenantId());
+				}
+				if (!metadataToRemove.empty() || !metadataToAdd.empty())
+				{
+					actions.push_back(make_shared<mip::MetadataAction>(metadataToRemove, metadataToAdd));
+				}
+			}
+
+			string targetTemplateId = targetLabel != nullptr ? targetLabel->GetTemplateId() : string();
+			// Removals are always reported, as the SDK does. Protection is only added if the content can carry it.
+			bool canProtect = (state.GetSupportedActions() & mip::ActionType::PROTECT_BY_TEMPLATE) == mip::ActionType::PROTECT_BY_TEMPLATE;
+			if (!targetTemplateId.empty() && targetTemplateId != currentTemplateId)
+			{
+				if (canProtect)
+				{
+					actions.push_back(make_shared<mip::ProtectByTemplateAction>(targetTemplateId));
+				}
+			}
+			else if (targetTemplateId.empty() && !currentTemplateId.empty() && currentLabel != nullptr &&
+				currentLabel->GetTemplateId() == currentTemplateId)
+			{
+				actions.push_back(make_shared<mip::RemoveProtectionAction>());
+			}
+
+			return actions;
+		}
+
+		void LocalPolicyHandler::NotifyCommittedActions(const mip::ExecutionState& /*state*/) const
+		{
+		}
+
+		shared_ptr<LocalPolicyEngine> LocalPolicyEngine::Load(const string& path)
+		{
+			utils::MappedFile file(path);
+			return Parse(std::string_view(file.GetData(), file.GetSize()));
+		}
+
+		shared_ptr<LocalPolicyEngine> LocalPolicyEngine::Parse(std::string_view policyJson)
+		{
+			utils::JsonDocument document(policyJson);
+			const auto& root = document.GetRoot();
+			if (!root.IsObject())
+			{
+				throw std::runtime_error("Local policy must be a JSON object");
+			}
+
+			shared_ptr<LocalPolicyEngine> engine(new LocalPolicyEngine());
+			engine->mPolicyVersion = string(root.GetString("policyVersion", "1"));
+			engine->mTenantId = string(root.GetString("tenantId"));
+			engine->mRequireDowngradeJustification = root.GetBool("requireDowngradeJustification", true);
+
+			std::function<void(const utils::JsonValue&, const shared_ptr<LocalLabel>&, vector<shared_ptr<mip::Label>>&, int)> addLabels =
+				[&](const utils::JsonValue& list, const shared_ptr<LocalLabel>& parent, vector<shared_ptr<mip::Label>>& output, int depth) {
+				if (!list.IsArray())
+				{
+					throw std::runtime_error("Local policy labels must be an array");
+				}
+				if (depth > kMaxLabelDepth)
+				{
+					throw std::runtime_error("Local policy labels are nested too deeply");
+				}
+
+				for (const auto& item : list.GetArray())
+				{
+					auto label = make_shared<LocalLabel>();
+					label->mId = string(item.GetString("id"));
+					if (label->mId.empty())
+					{
+						throw std::runtime_error("Local policy label without an id");
+					}
+					label->mName = string(item.GetString("name", label->mId));
+					label->mDescription = string(item.GetString("description"));
+					label->mColor = string(item.GetString("color"));
+					label->mSensitivity = static_cast<int>(item.GetNumber("sensitivity"));
+					label->mTooltip = string(item.GetString("tooltip"));
+					label->mAutoTooltip = string(item.GetString("autoTooltip"));
+					label->mIsActive = item.GetBool("active", true);
+					label->mTemplateId = string(item.GetString("templateId"));
+					label->mParent = parent;
+					auto customSettings = item.Find("customSettings");
+					if (customSettings != nullptr && customSettings->IsObject())
+					{
+						for (const auto& setting : customSettings->GetObject())
+						{
+							label->mCustomSettings.emplace_back(string(setting.first), string(setting.second.GetString()));
+						}
+					}
+
+					if (!engine->mLabelsById.emplace(label->mId, label).second)
+					{
+						throw std::runtime_error("Local policy has more than one label with id " + label->mId);
+					}
+					output.push_back(label);
+
+					auto children = item.Find("children");
+					if (children != nullptr)
+					{
+						addLabels(*children, label, label->mChildren, depth + 1);
+					}
+				}
+			};
+
+			auto labels = root.Find("labels");
+			if (labels == nullptr)
+			{
+				throw std::runtime_error("Local policy has no labels");
+			}
+			addLabels(*labels, nullptr, engine->mLabels, 0);
+			return engine;
+		}
+
+		shared_ptr<mip::Label> LocalPolicyEngine::GetLabelById(const string& labelId) const
+		{
+			auto it = mLabelsById.find(labelId);
+			return it != mLabelsById.end() ? it->second : nullptr;
+		}
+
+		const LocalLabel* LocalPolicyEngine::FindLabel(const string& labelId) const
+		{
+			auto it = mLabelsById.find(labelId);
+			return it != mLabelsById.end() ? it->second.get() : nullptr;
+		}
+
+		shared_ptr<LocalPolicyHandler> LocalPolicyEngine::CreatePolicyHandler() const
+		{
+			return make_shared<LocalPolicyHandler>(shared_from_this());
+		}
+
+	} //  namespace policy
+} //  namespace sample
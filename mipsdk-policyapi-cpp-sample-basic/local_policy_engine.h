@@ -0,0 +1,145 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_LOCAL_POLICY_ENGINE_H_
+#define SAMPLES_UPE_LOCAL_POLICY_ENGINE_H_
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "mip/upe/action.h"
+#include "mip/upe/execution_state.h"
+#include "mip/upe/label.h"
+
+namespace sample {
+	namespace policy {
+
+		class LocalPolicyEngine;
+
+		// Label loaded from a local policy file.
+		class LocalLabel final : public mip::Label {
+		public:
+			const std::string& GetId() const override { return mId; }
+			const std::string& GetName() const override { return mName; }
+			const std::string& GetDescription() const override { return mDescription; }
+			const std::string& GetColor() const override { return mColor; }
+			int GetSensitivity() const override { return mSensitivity; }
+			const std::string& GetTooltip() const override { return mTooltip; }
+			const std::string& GetAutoTooltip() const override { return mAutoTooltip; }
+			bool IsActive() const override { return mIsActive; }
+			std::weak_ptr<mip::Label> GetParent() const override { return mParent; }
+			const std::vector<std::shared_ptr<mip::Label>>& GetChildren() const override { return mChildren; }
+			const std::vector<std::pair<std::string, std::string>>& GetCustomSettings() const override { return mCustomSettings; }
+
+			const std::string& GetTemplateId() const { return mTemplateId; }	// Protection template the label applies. Empty if none.
+
+		private:
+			friend class LocalPolicyEngine;
+
+			std::string mId;
+			std::string mName;
+			std::string mDescription;
+			std::string mColor;
+			int mSensitivity = 0;
+			std::string mTooltip;
+			std::string mAutoTooltip;
+			bool mIsActive = true;
+			std::weak_ptr<mip::Label> mParent;
+			std::vector<std::shared_ptr<mip::Label>> mChildren;
+			std::vector<std::pair<std::string, std::string>> mCustomSettings;
+			std::string mTemplateId;
+		};
+
+		// Evaluates execution states against a LocalPolicyEngine. Same contract as mip::PolicyHandler.
+		class LocalPolicyHandler final {
+		public:
+			explicit LocalPolicyHandler(std::shared_ptr<const LocalPolicyEngine> engine) : mEngine(std::move(engine)) {}
+
+			std::vector<std::shared_ptr<mip::Action>> ComputeActions(const mip::ExecutionState& state) const;
+			void NotifyCommittedActions(const mip::ExecutionState& state) const;	// Offline, so there is no audit pipeline to notify
+
+		private:
+			std::shared_ptr<const LocalPolicyEngine> mEngine;
+		};
+
+		/**
+		 * @brief In-process policy engine loaded from a JSON policy file.
+		 * Serves the ListSensitivityLabels/GetLabelById/handler ComputeActions contract of mip::PolicyEngine without a
+		 * tenant, for development, load tests and benchmarks. Labels are immutable after loading, so the engine and its
+		 * handlers can be used from any number of threads.
+		 *
+		 * {
+		 *   "policyVersion": "2",
+		 *   "tenantId": "...",								// Written as the SiteId label metadata
+		 *   "requireDowngradeJustification": true,
+		 *   "labels": [
+		 *     { "id": "...", "name": "...", "sensitivity": 0, "description": "", "color": "", "tooltip": "",
+		 *       "active": true, "templateId": "", "customSettings": { "key": "value" }, "children": [ ... ] }
+		 *   ]
+		 * }
+		 *
+		 * ComputeActions returns, in order of precedence:
+		 * - JUSTIFY when the new label is less sensitive than the label in the content metadata (or removes it), the
+		 *   policy requires a justification and none was given.
+		 * - METADATA removing the old label's entries and adding the new label's entries, if the label changes.
+		 * - PROTECT_BY_TEMPLATE if the new label has a template the content isn't protected with, or REMOVE_PROTECTION
+		 *   if the content is protected with the old label's template and the new label has none.
+		 */
+		class LocalPolicyEngine final : public std::enable_shared_from_this<LocalPolicyEngine> {
+		public:
+			// Throws std::runtime_error if the file can't be read or isn't a valid policy.
+			static std::shared_ptr<LocalPolicyEngine> Load(const std::string& path);
+			static std::shared_ptr<LocalPolicyEngine> Parse(std::string_view policyJson);
+
+			const std::vector<std::shared_ptr<mip::Label>>& ListSensitivityLabels() const { return mLabels; }
+			std::shared_ptr<mip::Label> GetLabelById(const std::string& labelId) const;
+			std::shared_ptr<LocalPolicyHandler> CreatePolicyHandler() const;
+			const std::string& GetPolicyFileId() const { return mPolicyVersion; }
+			const std::string& GetTenantId() const { return mTenantId; }
+			bool IsDowngradeJustificationRequired() const { return mRequireDowngradeJustification; }
+
+			const LocalLabel* FindLabel(const std::string& labelId) const;
+
+		private:
+			LocalPolicyEngine() = default;
+
+			std::vector<std::shared_ptr<mip::Label>> mLabels;	// Top-level labels. Children hang off their parents.
+			std::unordered_map<std::string, std::shared_ptr<LocalLabel>> mLabelsById;
+			std::string mPolicyVersion;
+			std::string mTenantId;
+			bool mRequireDowngradeJustification = true;
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_LOCAL_POLICY_ENGINE_H_
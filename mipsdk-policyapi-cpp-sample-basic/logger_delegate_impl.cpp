@@ -0,0 +1,75 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "logger_delegate_impl.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+
+using std::string;
+
+namespace sample {
+	namespace utils {
+
+		// Output destination is owned by the sink, so there is nothing to set up in the SDK's storage path.
+		void LoggerDelegateImpl::Init(const string& /*storagePath*/, const string& /*logFileExtension*/)
+		{
+		}
+
+		void LoggerDelegateImpl::Flush()
+		{
+			mSink->Flush();
+		}
+
+		void LoggerDelegateImpl::WriteToLog(const mip::LogMessageData& data)
+		{
+			// Filter before formatting; most SDK trace messages are discarded here.
+			if (!mSink->IsEnabled(data.GetLogLevel()))
+			{
+				return;
+			}
+
+			char buffer[512];
+			int length = snprintf(buffer, sizeof(buffer), "%s (%s:%d) %s",
+				data.GetFunction().c_str(),
+				data.GetFileName().c_str(),
+				static_cast<int>(data.GetLineNumber()),
+				data.GetLogMessage().c_str());
+			if (length < 0)
+			{
+				return;
+			}
+
+			// File and line identify the SDK call site for rate limiting.
+			uint64_t siteKey = std::hash<string>()(data.GetFileName()) * 31 + static_cast<uint64_t>(data.GetLineNumber());
+			mSink->Write(data.GetLogLevel(), std::string_view(buffer, std::min(static_cast<size_t>(length), sizeof(buffer) - 1)), siteKey);
+		}
+
+	} //  namespace utils
+} //  namespace sample
@@ -0,0 +1,57 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UTILS_LOGGER_DELEGATE_IMPL_H_
+#define SAMPLES_UTILS_LOGGER_DELEGATE_IMPL_H_
+
+#include <memory>
+#include <string>
+
+#include "mip/logger_delegate.h"
+#include "async_log_sink.h"
+
+namespace sample {
+	namespace utils {
+
+		// Forwards SDK log messages to an AsyncLogSink so the SDK never writes logs on the caller's thread.
+		class LoggerDelegateImpl final : public mip::LoggerDelegate {
+		public:
+			explicit LoggerDelegateImpl(const std::shared_ptr<AsyncLogSink>& sink) : mSink(sink) {}
+
+			void Init(const std::string& storagePath, const std::string& logFileExtension) override;
+			void Flush() override;
+			void WriteToLog(const mip::LogMessageData& data) override;
+
+		private:
+			std::shared_ptr<AsyncLogSink> mSink;
+		};
+
+	} //  namespace utils
+} //  namespace sample
+
+#endif //  SAMPLES_UTILS_LOGGER_DELEGATE_IMPL_H_
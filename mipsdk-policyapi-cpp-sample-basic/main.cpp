@@ -25,9 +25,13 @@
 *
 */
 
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
 #include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <sstream>
 #include <vector>
@@ -36,6 +40,14 @@
 #include "mip/common_types.h"
 #include "utils.h"
 #include "execution_state_impl.h"
+#include "label_server.h"
+#include "labeling_pipeline.h"
+#include "metadata_reader.h"
+#include "metadata_writer.h"
+#include "results_report.h"
+#include "startup_benchmark.h"
+#include "trace_recorder.h"
+#include "workload_replayer.h"
 #include "mip/upe/metadata_action.h"
 #include "mip/upe/protect_by_template_action.h"
 #include "mip/upe/justify_action.h"
@@ -53,7 +65,17 @@ using std::vector;
 
 using sample::policy::Action;
 
-int main()
+static sample::policy::LabelServer* gServer = nullptr;
+
+static void StopServer(int /*signal*/)
+{
+	if (gServer != nullptr)
+	{
+		gServer->Stop();
+	}
+}
+
+int main(int argc, char* argv[])
 {
 	std::string newLabelId;
 	std::string currentLabelId;
@@ -69,31 +91,317 @@ int main()
 	// Create the mip::ApplicationInfo object. 		
 	mip::ApplicationInfo appInfo{ clientId, "MIP SDK Policy Sample for C++", "1.11.0" };
 
+	// Options may be given in any order. Each takes the number of values listed here.
+	static const std::map<string, int> kOptionValues = {
+		{ "--local-policy", 1 }, { "--shadow-rate", 1 }, { "--trace", 2 }, { "--record", 1 }, { "--label-properties", 1 },
+		{ "--memory-budget", 1 }, { "--results", 1 }, { "--report-summary", 1 }, { "--benchmark-startup", 1 },
+		{ "--serve", 1 }, { "--replay", 1 }, { "--speed", 1 }, { "--rate", 1 }, { "--label-directory", 2 },
+		{ "--write-back", 0 }, { "--compute-timeout", 1 }, { "--skip-noops", 0 },
+	};
+	std::map<string, vector<string>> arguments;
+	for (int i = 1; i < argc; ++i)
+	{
+		auto option = kOptionValues.find(argv[i]);
+		if (option == kOptionValues.end())
+		{
+			std::cerr << "Unknown option " << argv[i] << endl;
+			return 1;
+		}
+		if (i + option->second >= argc)
+		{
+			std::cerr << option->first << " needs " << option->second << " value(s)" << endl;
+			return 1;
+		}
+		vector<string>& values = arguments[option->first];
+		values.assign(argv + i + 1, argv + i + 1 + option->second);
+		i += option->second;
+	}
+	auto hasOption = [&](const char* name) { return arguments.count(name) > 0; };
+	auto optionValue = [&](const char* name, size_t index) -> const string& { return arguments.at(name)[index]; };
+
+	// --serve, --replay, --label-directory, --report-summary and --benchmark-startup each select what the sample does.
+	// Without one of them it runs interactively.
+	int modeCount = 0;
+	for (const char* mode : { "--serve", "--replay", "--label-directory", "--report-summary", "--benchmark-startup" })
+	{
+		modeCount += hasOption(mode) ? 1 : 0;
+	}
+	if (modeCount > 1)
+	{
+		std::cerr << "Only one of --serve, --replay, --label-directory, --report-summary and --benchmark-startup may be given" << endl;
+		return 1;
+	}
+	if ((hasOption("--speed") || hasOption("--rate")) && !hasOption("--replay"))
+	{
+		std::cerr << "--speed and --rate apply to --replay" << endl;
+		return 1;
+	}
+	if (hasOption("--write-back") && !hasOption("--label-directory"))
+	{
+		std::cerr << "--write-back applies to --label-directory" << endl;
+		return 1;
+	}
+
+	// Usage: --local-policy <policy.json> evaluates labels in-process from a JSON policy instead of the service.
+	// See local_policy_engine.h for the format.
+	std::string localPolicyPath;
+	if (hasOption("--local-policy"))
+	{
+		localPolicyPath = optionValue("--local-policy", 0);
+	}
+
+	// Usage: --shadow-rate <fraction> re-evaluates that fraction of local policy answers with the SDK engine in the
+	// background and reports any that differ.
+	double shadowSampleRate = 0;
+	if (hasOption("--shadow-rate"))
+	{
+		shadowSampleRate = std::atof(optionValue("--shadow-rate", 0).c_str());
+	}
+
+	// Usage: --trace <trace.json> <fraction> records timings of that fraction of requests, plus every engine load and
+	// token fetch, and writes them on exit in Chrome trace-event format for Perfetto or chrome://tracing.
+	std::string tracePath;
+	shared_ptr<sample::utils::TraceRecorder> tracer;
+	if (hasOption("--trace"))
+	{
+		tracePath = optionValue("--trace", 0);
+		sample::utils::TraceSettings traceSettings;
+		traceSettings.sampleRate = std::atof(optionValue("--trace", 1).c_str());
+		tracer = make_shared<sample::utils::TraceRecorder>(traceSettings);
+	}
+	auto exportTrace = [&]() {
+		if (tracer && !tracer->Export(tracePath))
+		{
+			std::cerr << "Unable to write trace " << tracePath << endl;
+		}
+	};
+
+	// Usage: --record <workload file> saves every evaluation request, with content IDs anonymized, so the load can be
+	// replayed later with --replay.
+	shared_ptr<sample::policy::WorkloadRecorder> workloadRecorder;
+	if (hasOption("--record"))
+	{
+		workloadRecorder = make_shared<sample::policy::WorkloadRecorder>(optionValue("--record", 0));
+	}
+
+	// Usage: --label-properties <properties.json> passes the extended properties listed for each label, and those
+	// inherited from its parents, with every evaluation of that label.
+	std::string labelPropertiesPath;
+	if (hasOption("--label-properties"))
+	{
+		labelPropertiesPath = optionValue("--label-properties", 0);
+	}
+
+	// Usage: --memory-budget <megabytes> clears the no-op and classification caches when the engines, label tables and
+	// caches together hold more than this.
+	size_t memoryBudgetBytes = 0;
+	if (hasOption("--memory-budget"))
+	{
+		memoryBudgetBytes = static_cast<size_t>(std::atof(optionValue("--memory-budget", 0).c_str()) * 1024 * 1024);
+	}
+
+	// Usage: --results <results file> stores the outcome of every item evaluated with --label-directory in a compact
+	// columnar file, which --report-summary aggregates.
+	shared_ptr<sample::policy::ResultsWriter> resultsWriter;
+	if (hasOption("--results"))
+	{
+		resultsWriter = make_shared<sample::policy::ResultsWriter>(optionValue("--results", 0));
+	}
+
+	// Usage: --report-summary <results file> prints totals per action type, requested label and label change.
+	// No engine is loaded.
+	if (hasOption("--report-summary"))
+	{
+		sample::policy::PrintResultsSummary(sample::policy::SummarizeResults(optionValue("--report-summary", 0)));
+		return 0;
+	}
+
+	// Usage: --benchmark-startup <policy.xml> compares cold and warm engine load times for each cache storage type,
+	// using a local policy file as a stand-in for the service.
+	if (hasOption("--benchmark-startup"))
+	{
+		sample::policy::ActionOptions benchmarkOptions;
+		benchmarkOptions.policyDataXmlPath = optionValue("--benchmark-startup", 0);
+		benchmarkOptions.cachePath = "mip_data_benchmark";
+		benchmarkOptions.generateAuditEvents = false;
+		auto results = sample::policy::RunStartupBenchmark(appInfo, userName, password, benchmarkOptions, 5);
+		sample::policy::PrintStartupBenchmark(results);
+		return 0;
+	}
+
 	// All actions for this tutorial project are implemented in samples::file::Action
 	// Source files are Action.h/cpp.
 	// "File" was chosen because this example is specifically for the MIP SDK File API. 
 	// Action's constructor takes in the mip::ApplicationInfo object and uses the client ID for auth.
-	// Final param enables or disable audit event generation.
-	Action action = Action(appInfo, userName, password, true);
+	// ActionOptions enables or disables audit event generation and sets where the label snapshot is kept.
+	sample::policy::ActionOptions actionOptions;
+	actionOptions.generateAuditEvents = true;
+	actionOptions.labelSnapshotPath = "label_snapshot.bin";
+	actionOptions.localPolicyPath = localPolicyPath;
+	actionOptions.shadowVerification.sampleRate = shadowSampleRate;
+	actionOptions.tracer = tracer;
+	actionOptions.workloadRecorder = workloadRecorder;
+	actionOptions.memoryBudgetBytes = memoryBudgetBytes;
+	actionOptions.labelPropertiesPath = labelPropertiesPath;
+
+	// Batch labeling shouldn't stop for a prompt. Downgrades that need a justification are set aside for a later pass.
+	bool isBatch = hasOption("--label-directory");
+	bool isReplay = hasOption("--replay");
+	auto deferredJustifications = make_shared<sample::policy::DeferredJustificationProvider>();
+	if (isBatch || isReplay)
+	{
+		actionOptions.justificationProvider = deferredJustifications;
+	}
+	if (isBatch)
+	{
+		// A single hung evaluation must not hold up the batch.
+		actionOptions.computeTimeout = std::chrono::seconds(10);
+		// Relabel sweeps revisit many files that already carry the label.
+		actionOptions.skipNoOpEvaluations = true;
+	}
+
+	// Usage: --compute-timeout <seconds> abandons evaluations that take longer, running them on a pool of compute threads.
+	// Zero evaluates inline without a deadline. Batch runs default to 10 seconds, everything else to zero.
+	if (hasOption("--compute-timeout"))
+	{
+		actionOptions.computeTimeout = std::chrono::milliseconds(static_cast<int64_t>(std::atof(optionValue("--compute-timeout", 0).c_str()) * 1000));
+	}
+
+	// Usage: --skip-noops answers requests the content's label already satisfies without an evaluation. Batch runs
+	// always do. Replays default to evaluating everything, like --serve, so pass it to replay a server that skips.
+	if (hasOption("--skip-noops"))
+	{
+		actionOptions.skipNoOpEvaluations = true;
+	}
+	Action action = Action(appInfo, userName, password, actionOptions);
+
+	// Start loading the engine in the background. Label IDs can be validated against the snapshot from a previous run meanwhile.
+	action.StartEngineLoad();
+
+	// Usage: --serve <socket path> keeps this process and its engine resident and answers requests over a Unix domain socket.
+	// Stop it with Ctrl+C or SIGTERM.
+	if (hasOption("--serve"))
+	{
+		sample::policy::LabelServerSettings serverSettings;
+		serverSettings.socketPath = optionValue("--serve", 0);
+		sample::policy::LabelServer server(action, serverSettings);
+		gServer = &server;
+		std::signal(SIGINT, StopServer);
+		std::signal(SIGTERM, StopServer);
+		server.Run();
+		gServer = nullptr;
+		action.GetLogSink()->Flush();
+		exportTrace();
+		return 0;
+	}
+
+	// Usage: --replay <workload file> [--speed <factor> | --rate <requests per second>] replays a recorded workload at the
+	// recorded pace, a multiple of it, or at a fixed arrival rate, and reports latency under that load.
+	if (isReplay)
+	{
+		sample::policy::WorkloadReplaySettings replaySettings;
+		if (hasOption("--speed"))
+		{
+			replaySettings.speed = std::atof(optionValue("--speed", 0).c_str());
+		}
+		if (hasOption("--rate"))
+		{
+			replaySettings.pacing = sample::policy::ReplayPacing::FixedRate;
+			replaySettings.arrivalRate = std::atof(optionValue("--rate", 0).c_str());
+		}
+		auto items = sample::policy::ReadWorkload(optionValue("--replay", 0));
+		cout << "Replaying " << items.size() << " requests. Compute timeout: " << actionOptions.computeTimeout.count() << " ms"
+			<< ", no-op skipping: " << (actionOptions.skipNoOpEvaluations ? "on" : "off")
+			<< ", audit events: " << (replaySettings.sendAuditEvents ? "on" : "off") << endl;
+		sample::policy::WorkloadReplayer replayer(action, replaySettings);
+		auto stats = replayer.Run(items);
+		action.GetLogSink()->Flush();
+		cout << "Requests: " << stats.requests << ", failed: " << stats.failures << ", seconds: " << stats.seconds
+			<< ", offered/achieved per second: " << stats.offeredRate << "/" << stats.achievedRate << endl;
+		cout << "Latency ms p50/p90/p99/p99.9/max: " << stats.p50Ms << "/" << stats.p90Ms << "/" << stats.p99Ms << "/"
+			<< stats.p999Ms << "/" << stats.maxMs << ", service time p99: " << stats.serviceP99Ms << endl;
+		exportTrace();
+		return 0;
+	}
+
+	// Usage: --label-directory <directory> <label ID> [--write-back] evaluates the label for every file under directory.
+	// With --write-back the resulting metadata is written to a sidecar next to each file.
+	if (isBatch)
+	{
+		sample::policy::LabelingPipelineSettings pipelineSettings;
+		if (hasOption("--write-back"))
+		{
+			pipelineSettings.metadataWriter = make_shared<sample::policy::MetadataWriter>();
+		}
+		pipelineSettings.resultsWriter = resultsWriter;
+		sample::policy::LabelingPipeline pipeline(action, pipelineSettings);
+		auto stats = pipeline.Run(optionValue("--label-directory", 0), optionValue("--label-directory", 1));
+		action.GetLogSink()->Flush();
+		cout << "Directories: " << stats.crawl.directories << ", files: " << stats.crawl.files
+			<< ", evaluated: " << stats.evaluated << ", need actions: " << stats.withActions
+			<< ", failed: " << stats.failed << ", awaiting justification: " << stats.deferred
+			<< ", seconds: " << stats.seconds << endl;
+
+		// Downgrades set aside during the run are justified on the console now that no worker is waiting on them.
+		if (deferredJustifications->GetDeferredCount() > 0)
+		{
+			cout << deferredJustifications->GetDeferredCount() << " item(s) need a justification";
+			if (deferredJustifications->GetDeniedCount() > 0)
+			{
+				cout << ", " << deferredJustifications->GetDeniedCount() << " more were denied because too many were waiting";
+			}
+			cout << endl;
+			sample::policy::InteractiveJustificationProvider prompt(action.GetLogSink());
+			auto retryStats = pipeline.RetryDeferred(*deferredJustifications, prompt);
+			action.GetLogSink()->Flush();
+			cout << "Justification pass: evaluated: " << retryStats.evaluated << ", need actions: " << retryStats.withActions
+				<< ", failed: " << retryStats.failed << ", not justified: " << retryStats.deferred << endl;
+		}
+		action.FlushShadowVerification();
+		auto actionStats = action.GetStats();
+		cout << "Timeouts: engine load " << actionStats.engineLoadTimeouts << ", token " << actionStats.tokenTimeouts
+			<< ", compute " << actionStats.computeTimeouts << " (" << actionStats.computeRejections << " refused)" << endl;
+		cout << "Already labeled, not evaluated: " << actionStats.noOpSkips << endl;
+		cout << "Memory:";
+		for (const auto& usage : actionStats.memory)
+		{
+			cout << " " << usage.name << " " << usage.bytes / 1024 << " KB" << (usage.evictable ? "" : " (fixed)") << ",";
+		}
+		cout << " evictions " << actionStats.memoryEvictions << endl;
+		if (shadowSampleRate > 0)
+		{
+			action.GetLogSink()->Flush();
+			cout << "Shadow checks: " << actionStats.shadow.sampled << " sampled, " << actionStats.shadow.verified << " matched, "
+				<< actionStats.shadow.mismatches << " mismatched, " << actionStats.shadow.dropped << " dropped, "
+				<< actionStats.shadow.errors << " failed" << endl;
+			for (const auto& mismatch : action.GetShadowMismatches())
+			{
+				cout << "  " << mismatch.options.contentIdentifier << endl;
+			}
+		}
+		if (pipelineSettings.metadataWriter)
+		{
+			auto writeStats = pipelineSettings.metadataWriter->GetStats();
+			cout << "Files written: " << writeStats.filesWritten << ", bytes: " << writeStats.bytesWritten
+				<< ", coalesced: " << writeStats.patchesCoalesced << ", failed: " << writeStats.failures
+				<< ", batches: " << writeStats.batches << ", syncs: " << writeStats.syncs
+				<< ", latency ms avg/p99/max: " << writeStats.averageLatencyMs << "/" << writeStats.p99LatencyMs
+				<< "/" << writeStats.maxLatencyMs << endl;
+		}
+		if (resultsWriter)
+		{
+			cout << "Results: " << resultsWriter->GetRowCount() << " rows, " << resultsWriter->GetBytesWritten() << " bytes" << endl;
+		}
+		exportTrace();
+		return 0;
+	}
 
 	// Call action.ListLabels() to display all available labels, then pause.
 	action.ListLabels();
 	system("pause");
 
-	// This label ID builds the initial execution state, simulating an existing label.
-	cout << endl << endl << "Enter a label ID: ";
-	cin >> currentLabelId;
-
-	// This label ID builds the new execution state, simulating an updated label.
-	cout << endl << "Enter a new label ID: ";
-	cin >> newLabelId;
-
 	// Set execution state options and provide to ComputeActions. 
 	sample::policy::ExecutionStateOptions options;
-
-	// Build execution state for "current label"
-	// This will be used to get metadata to feed to ComputeActions() function to simulate a label change.
-	options.newLabel = action.GetLabelById(currentLabelId);
 	options.actionSource = mip::ActionSource::MANUAL;
 	options.assignmentMethod = mip::AssignmentMethod::STANDARD;
 	options.contentFormat = mip::GetEmailContentFormat();	
@@ -101,35 +409,62 @@ int main()
 	options.dataState = mip::DataState::USE;	
 	options.isDowngradeJustified = false;
 	options.generateAuditEvent = true;
-		
-	// Compute Actions from the provided execution state
-	auto initialActions = action.ComputeAction(options);
 
-	// Fetch METADATA action, parse metadata, add to execution state.
-	for (const auto action : initialActions)
+	// Label metadata already stored with the file (extended attributes or a .mipmeta.json sidecar) describes the
+	// current label, so the label change can be evaluated with a single ComputeActions call.
+	sample::policy::MetadataReader metadataReader(sample::policy::MetadataReaderSettings(), action.GetLogSink());
+	bool hasExistingLabel = metadataReader.Read(options.contentIdentifier, options.metadata, &options.templateId) > 0;
+
+	if (!hasExistingLabel)
 	{
-		switch (action->GetType())
-		{
-		case mip::ActionType::METADATA:
+		// This label ID builds the initial execution state, simulating an existing label.
+		cout << endl << endl << "Enter a label ID: ";
+		cin >> currentLabelId;
+	}
+
+	// This label ID builds the new execution state, simulating an updated label.
+	cout << endl << "Enter a new label ID: ";
+	cin >> newLabelId;
+
+	if ((!hasExistingLabel && !action.IsValidLabel(currentLabelId)) || !action.IsValidLabel(newLabelId))
+	{
+		cout << "Label ID not found or not active." << endl;
+		return 1;
+	}
+
+	if (!hasExistingLabel)
+	{
+		// Build execution state for "current label"
+		// This will be used to get metadata to feed to ComputeActions() function to simulate a label change.
+		options.newLabel = action.GetLabelById(currentLabelId);
+
+		// Compute Actions from the provided execution state
+		sample::policy::ActionResults initialActions(action.ComputeAction(options));
+
+		// Fetch METADATA action, parse metadata, add to execution state.
+		for (const auto& result : initialActions)
 		{
-			options.metadata.clear();
-			auto derivedAction = static_cast<mip::MetadataAction*>(action.get());
-			for (const mip::MetadataEntry& prop : derivedAction->GetMetadataToAdd())
+			switch (sample::policy::GetResultType(result))
 			{
-				options.metadata[prop.GetKey()] = prop.GetValue();
+			case mip::ActionType::METADATA:
+			{
+				options.metadata.clear();
+				for (const auto& prop : std::get<sample::policy::MetadataResult>(result).entriesToAdd)
+				{
+					options.metadata[std::string(prop.key)].assign(prop.value);
+				}
+				break;
 			}
-			break;
-		}
 
-		case mip::ActionType::PROTECT_BY_TEMPLATE: {
-			auto derivedAction = static_cast<mip::ProtectByTemplateAction*>(action.get());
-			options.templateId = derivedAction->GetTemplateId();			
-			break;
-		}
-		default:
-		{
+			case mip::ActionType::PROTECT_BY_TEMPLATE: {
+				options.templateId = std::get<sample::policy::ProtectByTemplateResult>(result).templateId;
+				break;
+			}
+			default:
+			{
 
-		}
+			}
+			}
 		}
 	}
 
@@ -137,8 +472,20 @@ int main()
 	options.newLabel = action.GetLabelById(newLabelId);
 	
 	// Provide desired execution state 
-	auto result = action.ComputeActionLoop(options);	
-	
+	sample::policy::MetadataPatch patch;
+	auto result = action.ComputeActionLoop(options, &patch);	
+
+	// Store the new label metadata with the file, where the next run picks it up.
+	if (result && sample::utils::FileExists(options.contentIdentifier.c_str()))
+	{
+		sample::policy::MetadataWriter metadataWriter;
+		metadataWriter.Submit(std::move(patch));
+		metadataWriter.Flush();
+	}
+
+	// Action output is written asynchronously. Make sure it's all on screen before pausing.
+	action.GetLogSink()->Flush();
+	exportTrace();
 	system("pause");
 
 	return 0;
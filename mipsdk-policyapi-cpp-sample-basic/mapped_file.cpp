@@ -0,0 +1,183 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "mapped_file.h"
+
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using std::runtime_error;
+using std::string;
+
+namespace sample {
+	namespace utils {
+
+#if defined(_WIN32) || defined(_WIN64)
+		MappedFile::MappedFile(const string& path)
+		{
+			// FILE_SHARE_DELETE lets another process replace the file, such as a newer label snapshot, while it is mapped here.
+			HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				throw runtime_error("Unable to open " + path);
+			}
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(file, &size))
+			{
+				CloseHandle(file);
+				throw runtime_error("Unable to read size of " + path);
+			}
+
+			mFileHandle = file;
+			mSize = static_cast<size_t>(size.QuadPart);
+			mIsOpen = true;
+			if (mSize == 0)
+			{
+				return;
+			}
+
+			mMappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mMappingHandle == nullptr)
+			{
+				Close();
+				throw runtime_error("Unable to map " + path);
+			}
+
+			mData = static_cast<const char*>(MapViewOfFile(mMappingHandle, FILE_MAP_READ, 0, 0, 0));
+			if (mData == nullptr)
+			{
+				Close();
+				throw runtime_error("Unable to map " + path);
+			}
+		}
+
+		void MappedFile::Close()
+		{
+			if (mData != nullptr)
+			{
+				UnmapViewOfFile(mData);
+			}
+			if (mMappingHandle != nullptr)
+			{
+				CloseHandle(mMappingHandle);
+			}
+			if (mFileHandle != nullptr)
+			{
+				CloseHandle(mFileHandle);
+			}
+			mData = nullptr;
+			mMappingHandle = nullptr;
+			mFileHandle = nullptr;
+			mSize = 0;
+			mIsOpen = false;
+		}
+#else
+		MappedFile::MappedFile(const string& path)
+		{
+			int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+			{
+				throw runtime_error("Unable to open " + path);
+			}
+
+			struct stat info;
+			if (fstat(fd, &info) != 0)
+			{
+				close(fd);
+				throw runtime_error("Unable to read size of " + path);
+			}
+
+			mSize = static_cast<size_t>(info.st_size);
+			mIsOpen = true;
+			if (mSize > 0)
+			{
+				void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (data == MAP_FAILED)
+				{
+					close(fd);
+					mSize = 0;
+					mIsOpen = false;
+					throw runtime_error("Unable to map " + path);
+				}
+				mData = static_cast<const char*>(data);
+			}
+
+			// The mapping keeps its own reference to the file.
+			close(fd);
+		}
+
+		void MappedFile::Close()
+		{
+			if (mData != nullptr)
+			{
+				munmap(const_cast<char*>(mData), mSize);
+			}
+			mData = nullptr;
+			mSize = 0;
+			mIsOpen = false;
+		}
+#endif
+
+		MappedFile::~MappedFile()
+		{
+			Close();
+		}
+
+		MappedFile::MappedFile(MappedFile&& other) noexcept
+		{
+			*this = std::move(other);
+		}
+
+		MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Close();
+				std::swap(mData, other.mData);
+				std::swap(mSize, other.mSize);
+				std::swap(mIsOpen, other.mIsOpen);
+#if defined(_WIN32) || defined(_WIN64)
+				std::swap(mFileHandle, other.mFileHandle);
+				std::swap(mMappingHandle, other.mMappingHandle);
+#endif
+			}
+			return *this;
+		}
+
+	} //  namespace utils
+} //  namespace sample
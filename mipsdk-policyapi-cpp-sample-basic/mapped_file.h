@@ -0,0 +1,73 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UTILS_MAPPED_FILE_H_
+#define SAMPLES_UTILS_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+namespace sample {
+	namespace utils {
+
+		/**
+		 * @brief Read-only memory mapping of a whole file.
+		 * The mapping is released when the object is destroyed. Empty files are valid and map to a null pointer
+		 * with a size of zero.
+		 */
+		class MappedFile final {
+		public:
+			MappedFile() = default;
+			explicit MappedFile(const std::string& path);
+			~MappedFile();
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			MappedFile(MappedFile&& other) noexcept;
+			MappedFile& operator=(MappedFile&& other) noexcept;
+
+			const char* GetData() const { return mData; }
+			size_t GetSize() const { return mSize; }
+			bool IsOpen() const { return mIsOpen; }
+
+		private:
+			void Close();
+
+			const char* mData = nullptr;
+			size_t mSize = 0;
+			bool mIsOpen = false;
+#if defined(_WIN32) || defined(_WIN64)
+			void* mFileHandle = nullptr;
+			void* mMappingHandle = nullptr;
+#endif
+		};
+
+	} //  namespace utils
+} //  namespace sample
+
+#endif //  SAMPLES_UTILS_MAPPED_FILE_H_
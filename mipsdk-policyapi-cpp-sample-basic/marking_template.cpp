@@ -0,0 +1,233 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "marking_template.h"
+
+#include <cctype>
+#include <mutex>
+
+using std::string;
+using std::string_view;
+
+namespace {
+	const string_view kVariableStart = "${";
+	const string_view kIfApplicationPrefix = "If.App.";
+
+	bool EqualsIgnoreCase(string_view a, string_view b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < a.size(); ++i)
+		{
+			if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool ContainsIgnoreCase(string_view letters, char letter)
+	{
+		for (char c : letters)
+		{
+			if (std::toupper(static_cast<unsigned char>(c)) == letter)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+namespace sample {
+	namespace policy {
+
+		char GetMarkingApplication(string_view extension)
+		{
+			struct ExtensionApplication {
+				string_view extension;
+				char application;
+			};
+			static const ExtensionApplication kApplications[] = {
+				{ ".doc", 'W' }, { ".docm", 'W' }, { ".docx", 'W' }, { ".dot", 'W' }, { ".dotx", 'W' },
+				{ ".xls", 'X' }, { ".xlsb", 'X' }, { ".xlsm", 'X' }, { ".xlsx", 'X' }, { ".xltx", 'X' },
+				{ ".pot", 'P' }, { ".potx", 'P' }, { ".ppt", 'P' }, { ".pptm", 'P' }, { ".pptx", 'P' },
+				{ ".eml", 'O' }, { ".msg", 'O' },
+			};
+			for (const auto& entry : kApplications)
+			{
+				if (EqualsIgnoreCase(extension, entry.extension))
+				{
+					return entry.application;
+				}
+			}
+			return 0;
+		}
+
+		MarkingTemplate::MarkingTemplate(string text)
+			: mText(std::move(text))
+		{
+			struct Variable {
+				string_view name;
+				TokenType type;
+			};
+			static const Variable kVariables[] = {
+				{ "Item.Label", TokenType::LabelName },
+				{ "Item.Name", TokenType::ItemName },
+				{ "Item.Location", TokenType::ItemLocation },
+				{ "User.Name", TokenType::UserName },
+				{ "User.PrincipalName", TokenType::UserPrincipalName },
+				{ "Event.DateTime", TokenType::EventDateTime },
+				{ "If.End", TokenType::EndIf },
+			};
+
+			string_view source(mText);
+			size_t literalStart = 0;
+			size_t position = 0;
+			for (;;)
+			{
+				size_t open = source.find(kVariableStart, position);
+				if (open == string_view::npos)
+				{
+					break;
+				}
+				size_t close = source.find('}', open + kVariableStart.size());
+				if (close == string_view::npos)
+				{
+					break;
+				}
+
+				size_t nameStart = open + kVariableStart.size();
+				string_view name = source.substr(nameStart, close - nameStart);
+				Token token = { TokenType::Literal, 0, 0 };
+				if (name.size() > kIfApplicationPrefix.size() && EqualsIgnoreCase(name.substr(0, kIfApplicationPrefix.size()), kIfApplicationPrefix))
+				{
+					token = { TokenType::IfApplication, static_cast<uint32_t>(nameStart + kIfApplicationPrefix.size()),
+						static_cast<uint32_t>(name.size() - kIfApplicationPrefix.size()) };
+				}
+				else
+				{
+					for (const auto& variable : kVariables)
+					{
+						if (EqualsIgnoreCase(name, variable.name))
+						{
+							token.type = variable.type;
+							break;
+						}
+					}
+				}
+
+				// Unknown variables stay part of the surrounding literal.
+				if (token.type == TokenType::Literal)
+				{
+					position = nameStart;
+					continue;
+				}
+
+				AddLiteral(literalStart, open - literalStart);
+				mTokens.push_back(token);
+				literalStart = position = close + 1;
+			}
+			AddLiteral(literalStart, source.size() - literalStart);
+		}
+
+		void MarkingTemplate::AddLiteral(size_t offset, size_t length)
+		{
+			if (length == 0)
+			{
+				return;
+			}
+			mTokens.push_back(Token{ TokenType::Literal, static_cast<uint32_t>(offset), static_cast<uint32_t>(length) });
+			mLiteralLength += length;
+		}
+
+		void MarkingTemplate::Render(const MarkingContext& context, string& output) const
+		{
+			output.clear();
+			output.reserve(mLiteralLength + context.labelName.size() + context.itemLocation.size() + context.userPrincipalName.size());
+
+			bool skipping = false;
+			for (const auto& token : mTokens)
+			{
+				if (token.type == TokenType::EndIf)
+				{
+					skipping = false;
+					continue;
+				}
+				if (skipping)
+				{
+					continue;
+				}
+
+				switch (token.type)
+				{
+				case TokenType::Literal: output.append(mText, token.offset, token.length); break;
+				case TokenType::LabelName: output.append(context.labelName); break;
+				case TokenType::ItemName: output.append(context.itemName); break;
+				case TokenType::ItemLocation: output.append(context.itemLocation); break;
+				case TokenType::UserName: output.append(context.userName); break;
+				case TokenType::UserPrincipalName: output.append(context.userPrincipalName); break;
+				case TokenType::EventDateTime: output.append(context.eventDateTime); break;
+				case TokenType::IfApplication:
+					skipping = context.application == 0 || !ContainsIgnoreCase(string_view(mText).substr(token.offset, token.length), context.application);
+					break;
+				default:
+					break;
+				}
+			}
+		}
+
+		std::shared_ptr<const MarkingTemplate> MarkingTemplateCache::Get(const string& labelId, mip::ActionType type, std::string_view text)
+		{
+			thread_local string key;
+			key.assign(labelId);
+			key += '/';
+			key += std::to_string(static_cast<unsigned int>(type));
+
+			{
+				std::shared_lock<std::shared_mutex> lock(mMutex);
+				auto it = mTemplates.find(key);
+				if (it != mTemplates.end() && it->second->GetText() == text)
+				{
+					return it->second;
+				}
+			}
+
+			// New label, or the policy changed the text since it was compiled.
+			auto compiled = std::make_shared<const MarkingTemplate>(string(text));
+			mCompiles.fetch_add(1, std::memory_order_relaxed);
+			std::unique_lock<std::shared_mutex> lock(mMutex);
+			mTemplates[key] = compiled;
+			return compiled;
+		}
+
+	} //  namespace policy
+} //  namespace sample
@@ -0,0 +1,117 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_MARKING_TEMPLATE_H_
+#define SAMPLES_UPE_MARKING_TEMPLATE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mip/upe/action.h"
+
+namespace sample {
+	namespace policy {
+
+		// Values substituted for the ${...} variables of a marking.
+		struct MarkingContext {
+			std::string_view labelName;			// ${Item.Label}
+			std::string_view itemName;			// ${Item.Name}
+			std::string_view itemLocation;		// ${Item.Location}
+			std::string_view userName;			// ${User.Name}
+			std::string_view userPrincipalName;	// ${User.PrincipalName}
+			std::string_view eventDateTime;		// ${Event.DateTime}
+			char application = 0;				// W, X, P or O for ${If.App.<apps>} sections. 0 matches no section.
+		};
+
+		// Office application letter for ${If.App.<apps>} sections, from a file extension such as ".docx". 0 if none applies.
+		char GetMarkingApplication(std::string_view extension);
+
+		/**
+		 * @brief Header, footer or watermark text compiled into literal and variable tokens.
+		 * Literal tokens point into the template's copy of the source text, so rendering is a single pass of appends.
+		 * Unknown variables are kept as literal text. ${If.App.<apps>} ... ${If.End} sections are rendered only for
+		 * the listed applications.
+		 */
+		class MarkingTemplate final {
+		public:
+			explicit MarkingTemplate(std::string text);
+
+			void Render(const MarkingContext& context, std::string& output) const;	// Replaces the contents of output
+			const std::string& GetText() const { return mText; }
+
+		private:
+			enum class TokenType : uint8_t {
+				Literal,
+				LabelName,
+				ItemName,
+				ItemLocation,
+				UserName,
+				UserPrincipalName,
+				EventDateTime,
+				IfApplication,	// Offset and length are the application letters
+				EndIf
+			};
+
+			struct Token {
+				TokenType type;
+				uint32_t offset;
+				uint32_t length;
+			};
+
+			void AddLiteral(size_t offset, size_t length);
+
+			const std::string mText;
+			std::vector<Token> mTokens;
+			size_t mLiteralLength = 0;	// Used to size the output before rendering
+		};
+
+		/**
+		 * @brief Compiled marking templates, one per label and marking action type.
+		 * A template is compiled the first time its label's marking is seen and reused while the text is unchanged.
+		 */
+		class MarkingTemplateCache final {
+		public:
+			std::shared_ptr<const MarkingTemplate> Get(const std::string& labelId, mip::ActionType type, std::string_view text);
+			uint64_t GetCompileCount() const { return mCompiles; }
+
+		private:
+			mutable std::shared_mutex mMutex;
+			std::unordered_map<std::string, std::shared_ptr<const MarkingTemplate>> mTemplates;	// Keyed by label ID and action type
+			std::atomic<uint64_t> mCompiles{ 0 };
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_MARKING_TEMPLATE_H_
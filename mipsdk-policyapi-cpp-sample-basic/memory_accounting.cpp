@@ -0,0 +1,127 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "memory_accounting.h"
+
+#include <algorithm>
+
+namespace sample {
+	namespace utils {
+
+		MemoryBudget::MemoryBudget(size_t limitBytes, std::shared_ptr<AsyncLogSink> log)
+			: mLimit(limitBytes),
+			mLog(std::move(log))
+		{
+		}
+
+		void MemoryBudget::Register(const std::string& name, const MemoryAccount* account, std::function<void()> evict)
+		{
+			mConsumers.push_back(Consumer{ name, account, std::move(evict) });
+		}
+
+		int64_t MemoryBudget::GetTotalBytes() const
+		{
+			int64_t fixedBytes;
+			int64_t evictableBytes;
+			Measure(fixedBytes, evictableBytes);
+			return fixedBytes + evictableBytes;
+		}
+
+		void MemoryBudget::Measure(int64_t& fixedBytes, int64_t& evictableBytes) const
+		{
+			fixedBytes = 0;
+			evictableBytes = 0;
+			for (const auto& consumer : mConsumers)
+			{
+				(consumer.evict ? evictableBytes : fixedBytes) += consumer.account->GetBytes();
+			}
+		}
+
+		// Evicting can only bring the evictable consumers down, so they get whatever the fixed ones leave of the limit.
+		// When the fixed consumers alone exceed it, that is nothing and caches are emptied whenever they hold anything.
+		bool MemoryBudget::Enforce()
+		{
+			if (mLimit == 0)
+			{
+				return false;
+			}
+			int64_t fixedBytes;
+			int64_t evictableBytes;
+			Measure(fixedBytes, evictableBytes);
+			int64_t allowance = std::max<int64_t>(static_cast<int64_t>(mLimit) - fixedBytes, 0);
+			if (evictableBytes <= allowance)
+			{
+				return false;
+			}
+
+			// Another thread is already evicting. Its eviction will bring the total down for this caller too.
+			std::unique_lock<std::mutex> lock(mEvictMutex, std::try_to_lock);
+			if (!lock.owns_lock())
+			{
+				return false;
+			}
+
+			if (allowance == 0 && mLog && !mFixedOverLimit.exchange(true))
+			{
+				mLog->Log(mip::LogLevel::Warning, "Memory held outside the caches (%lld KB) exceeds the budget of %zu KB. Caches will be kept empty.",
+					static_cast<long long>(fixedBytes / 1024), mLimit / 1024);
+			}
+
+			bool evicted = false;
+			for (const auto& consumer : mConsumers)
+			{
+				if (evictableBytes <= allowance)
+				{
+					break;
+				}
+				int64_t bytes = consumer.account->GetBytes();
+				if (!consumer.evict || bytes <= 0)
+				{
+					continue;
+				}
+				consumer.evict();
+				mEvictions.fetch_add(1, std::memory_order_relaxed);
+				evicted = true;
+				evictableBytes -= bytes - consumer.account->GetBytes();
+			}
+			return evicted;
+		}
+
+		std::vector<MemoryUsage> MemoryBudget::GetUsage() const
+		{
+			std::vector<MemoryUsage> usage;
+			usage.reserve(mConsumers.size());
+			for (const auto& consumer : mConsumers)
+			{
+				usage.push_back(MemoryUsage{ consumer.name, consumer.account->GetBytes(), static_cast<bool>(consumer.evict) });
+			}
+			return usage;
+		}
+
+	} //  namespace utils
+} //  namespace sample
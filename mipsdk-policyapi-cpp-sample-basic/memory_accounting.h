@@ -0,0 +1,153 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UTILS_MEMORY_ACCOUNTING_H_
+#define SAMPLES_UTILS_MEMORY_ACCOUNTING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "async_log_sink.h"
+
+namespace sample {
+	namespace utils {
+
+		// Bytes currently held by one consumer. Updated by CountingAllocator or by the consumer's own estimate.
+		class MemoryAccount final {
+		public:
+			void Allocated(size_t bytes) { mBytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed); }
+			void Released(size_t bytes) { mBytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed); }
+			int64_t GetBytes() const { return mBytes.load(std::memory_order_relaxed); }
+
+		private:
+			std::atomic<int64_t> mBytes{ 0 };
+		};
+
+		/**
+		 * @brief Allocator that charges every allocation to a MemoryAccount.
+		 * Wrap it in std::scoped_allocator_adaptor so strings and vectors inside a container are charged too.
+		 * A null account charges nothing, which suits temporaries such as lookup keys.
+		 */
+		template<typename T>
+		class CountingAllocator {
+		public:
+			typedef T value_type;
+
+			explicit CountingAllocator(MemoryAccount* account = nullptr) noexcept : mAccount(account) {}
+			template<typename U>
+			CountingAllocator(const CountingAllocator<U>& other) noexcept : mAccount(other.GetAccount()) {}
+
+			T* allocate(size_t count)
+			{
+				T* memory = std::allocator<T>().allocate(count);
+				if (mAccount != nullptr)
+				{
+					mAccount->Allocated(count * sizeof(T));
+				}
+				return memory;
+			}
+
+			void deallocate(T* memory, size_t count) noexcept
+			{
+				std::allocator<T>().deallocate(memory, count);
+				if (mAccount != nullptr)
+				{
+					mAccount->Released(count * sizeof(T));
+				}
+			}
+
+			MemoryAccount* GetAccount() const noexcept { return mAccount; }
+
+		private:
+			MemoryAccount* mAccount;
+		};
+
+		template<typename T, typename U>
+		bool operator==(const CountingAllocator<T>& a, const CountingAllocator<U>& b) noexcept { return a.GetAccount() == b.GetAccount(); }
+		template<typename T, typename U>
+		bool operator!=(const CountingAllocator<T>& a, const CountingAllocator<U>& b) noexcept { return a.GetAccount() != b.GetAccount(); }
+
+		typedef std::basic_string<char, std::char_traits<char>, CountingAllocator<char>> CountedString;
+
+		struct CountedStringHash {
+			size_t operator()(const CountedString& value) const { return std::hash<std::string_view>()(std::string_view(value.data(), value.size())); }
+		};
+
+		struct MemoryUsage {
+			std::string name;
+			int64_t bytes = 0;
+			bool evictable = false;
+		};
+
+		/**
+		 * @brief Reports what each registered consumer holds and evicts consumers when the total exceeds a limit.
+		 * Only evictable consumers are budgeted, against what the limit leaves after the fixed ones. They are evicted in
+		 * the order they were registered, so register the cheapest to rebuild first.
+		 * Register everything before Enforce is first called. Enforce is safe to call from any thread.
+		 */
+		class MemoryBudget final {
+		public:
+			explicit MemoryBudget(size_t limitBytes = 0, std::shared_ptr<AsyncLogSink> log = nullptr);	// Zero reports usage without evicting
+
+			void Register(const std::string& name, const MemoryAccount* account, std::function<void()> evict = nullptr);
+			bool Enforce();		// True if anything was evicted
+
+			std::vector<MemoryUsage> GetUsage() const;
+			int64_t GetTotalBytes() const;
+			uint64_t GetEvictionCount() const { return mEvictions; }
+			size_t GetLimit() const { return mLimit; }
+
+		private:
+			struct Consumer {
+				std::string name;
+				const MemoryAccount* account;
+				std::function<void()> evict;
+			};
+
+			void Measure(int64_t& fixedBytes, int64_t& evictableBytes) const;
+
+			const size_t mLimit;
+			std::shared_ptr<AsyncLogSink> mLog;
+			std::vector<Consumer> mConsumers;
+			std::mutex mEvictMutex;
+			std::atomic<uint64_t> mEvictions{ 0 };
+			std::atomic<bool> mFixedOverLimit{ false };		// Logged once
+		};
+
+	} //  namespace utils
+} //  namespace sample
+
+#endif //  SAMPLES_UTILS_MEMORY_ACCOUNTING_H_
@@ -0,0 +1,243 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "metadata_reader.h"
+
+#include <cerrno>
+#include <vector>
+
+#if defined(_WIN32) || defined(_WIN64)
+#elif defined(__APPLE__)
+#include <sys/xattr.h>
+#else
+#include <sys/types.h>
+#include <sys/xattr.h>
+#endif
+
+#include "json_reader.h"
+#include "mapped_file.h"
+#include "utils.h"
+
+using mip::LogLevel;
+using std::string;
+using std::string_view;
+using std::unordered_map;
+
+namespace {
+	const string_view kLabelKeyPrefix = "MSIP_Label_";
+#if defined(_WIN32) || defined(_WIN64)
+	const char* kMetadataStream = ":MSIP_Label.json";
+#else
+	const string_view kAttributePrefix = "user.";
+
+	ssize_t ListAttributes(const char* path, char* buffer, size_t size)
+	{
+#if defined(__APPLE__)
+		return listxattr(path, buffer, size, 0);
+#else
+		return listxattr(path, buffer, size);
+#endif
+	}
+
+	ssize_t GetAttribute(const char* path, const char* name, void* buffer, size_t size)
+	{
+#if defined(__APPLE__)
+		return getxattr(path, name, buffer, size, 0, 0);
+#else
+		return getxattr(path, name, buffer, size);
+#endif
+	}
+#endif
+}
+
+namespace sample {
+	namespace policy {
+
+		const char* const MetadataReader::kTemplateIdKey = "ProtectionTemplateId";
+
+		MetadataReader::MetadataReader(const MetadataReaderSettings& settings, std::shared_ptr<utils::AsyncLogSink> log)
+			: mSettings(settings),
+			mLog(std::move(log))
+		{
+		}
+
+		bool MetadataReader::IsLabelMetadataKey(string_view key)
+		{
+			return key.size() > kLabelKeyPrefix.size() && key.compare(0, kLabelKeyPrefix.size(), kLabelKeyPrefix) == 0;
+		}
+
+		size_t MetadataReader::Read(const string& path, unordered_map<string, string>& metadata, string* templateId) const
+		{
+			size_t count = 0;
+			if (mSettings.readExtendedAttributes)
+			{
+#if defined(_WIN32) || defined(_WIN64)
+				count += ReadJson(path + kMetadataStream, metadata, templateId);
+#else
+				count += ReadExtendedAttributes(path, metadata, templateId);
+#endif
+			}
+			// Extended attributes travel with the file, so they win over a sidecar that may be stale.
+			if (mSettings.readSidecar && count == 0)
+			{
+				count += ReadJson(path + mSettings.sidecarSuffix, metadata, templateId);
+			}
+			return count;
+		}
+
+		size_t MetadataReader::ReadJson(const string& path, unordered_map<string, string>& metadata, string* templateId) const
+		{
+			if (!utils::FileExists(path.c_str()))
+			{
+				return 0;
+			}
+
+			size_t count = 0;
+			try
+			{
+				utils::MappedFile file(path);
+				if (file.GetSize() == 0)
+				{
+					return 0;
+				}
+				utils::JsonDocument document(string_view(file.GetData(), file.GetSize()));
+				const auto& root = document.GetRoot();
+				if (!root.IsObject())
+				{
+					return 0;
+				}
+
+				for (const auto& member : root.GetObject())
+				{
+					bool isTemplateId = templateId != nullptr && member.first == kTemplateIdKey;
+					if (!isTemplateId && !IsLabelMetadataKey(member.first))
+					{
+						continue;
+					}
+					const auto& value = member.second;
+					string_view text;
+					if (value.IsString())
+					{
+						text = value.GetString();
+					}
+					else if (value.GetType() == utils::JsonValue::Type::Bool)
+					{
+						text = value.GetBool() ? "true" : "false";
+					}
+					else
+					{
+						continue;
+					}
+					if (isTemplateId)
+					{
+						templateId->assign(text);
+						continue;
+					}
+					metadata.insert_or_assign(string(member.first), string(text));
+					++count;
+				}
+			}
+			catch (const std::exception& ex)
+			{
+				if (mLog)
+				{
+					mLog->Log(LogLevel::Warning, "Ignoring label metadata in %s: %s", path.c_str(), ex.what());
+				}
+				return 0;
+			}
+			return count;
+		}
+
+		size_t MetadataReader::ReadExtendedAttributes(const string& path, unordered_map<string, string>& metadata, string* templateId) const
+		{
+#if defined(_WIN32) || defined(_WIN64)
+			return 0;
+#else
+			thread_local std::vector<char> names(4096);
+			thread_local std::vector<char> value(1024);
+
+			ssize_t namesSize = ListAttributes(path.c_str(), names.data(), names.size());
+			if (namesSize < 0 && errno == ERANGE)
+			{
+				namesSize = ListAttributes(path.c_str(), nullptr, 0);
+				if (namesSize > 0)
+				{
+					names.resize(static_cast<size_t>(namesSize));
+					namesSize = ListAttributes(path.c_str(), names.data(), names.size());
+				}
+			}
+			if (namesSize <= 0)
+			{
+				return 0;
+			}
+
+			size_t count = 0;
+			// The list is a sequence of NUL terminated names.
+			for (const char* name = names.data(); name < names.data() + namesSize; name += string_view(name).size() + 1)
+			{
+				string_view attribute(name);
+				if (attribute.compare(0, kAttributePrefix.size(), kAttributePrefix) != 0)
+				{
+					continue;
+				}
+				string_view key = attribute.substr(kAttributePrefix.size());
+				bool isTemplateId = templateId != nullptr && key == kTemplateIdKey;
+				if (!isTemplateId && !IsLabelMetadataKey(key))
+				{
+					continue;
+				}
+
+				ssize_t valueSize = GetAttribute(path.c_str(), name, value.data(), value.size());
+				if (valueSize < 0 && errno == ERANGE)
+				{
+					valueSize = GetAttribute(path.c_str(), name, nullptr, 0);
+					if (valueSize > 0)
+					{
+						value.resize(static_cast<size_t>(valueSize));
+						valueSize = GetAttribute(path.c_str(), name, value.data(), value.size());
+					}
+				}
+				if (valueSize < 0)
+				{
+					continue;
+				}
+
+				if (isTemplateId)
+				{
+					templateId->assign(value.data(), static_cast<size_t>(valueSize));
+					continue;
+				}
+				metadata.insert_or_assign(string(key), string(value.data(), static_cast<size_t>(valueSize)));
+				++count;
+			}
+			return count;
+#endif
+		}
+
+	} //  namespace policy
+} //  namespace sample
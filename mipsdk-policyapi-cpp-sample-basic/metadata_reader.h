@@ -0,0 +1,82 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_METADATA_READER_H_
+#define SAMPLES_UPE_METADATA_READER_H_
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "async_log_sink.h"
+
+namespace sample {
+	namespace policy {
+
+		struct MetadataReaderSettings {
+			bool readExtendedAttributes = true;			// user.MSIP_Label_* xattrs on POSIX, the :MSIP_Label.json stream on NTFS
+			bool readSidecar = true;
+			std::string sidecarSuffix = ".mipmeta.json";	// Sidecar for "a.txt" is "a.txt.mipmeta.json"
+		};
+
+		/**
+		 * @brief Reads the MSIP_Label_* metadata already stored with a file, and the protection template MetadataWriter
+		 * stored with it under kTemplateIdKey.
+		 * Sidecars are memory mapped and parsed in place, and extended attributes are read into per-thread buffers, so
+		 * the only copies made are the entries handed back. Safe to call from several threads.
+		 */
+		class MetadataReader final {
+		public:
+			explicit MetadataReader(const MetadataReaderSettings& settings = MetadataReaderSettings(),
+				std::shared_ptr<utils::AsyncLogSink> log = nullptr);	// Malformed sources are reported to log
+
+			MetadataReader(const MetadataReader&) = delete;
+			MetadataReader& operator=(const MetadataReader&) = delete;
+
+			// Adds the label metadata found for path to metadata and returns the number of entries added. Unreadable or
+			// malformed sources are skipped. If templateId is given, a stored protection template is assigned to it; it
+			// isn't counted in the result.
+			size_t Read(const std::string& path, std::unordered_map<std::string, std::string>& metadata, std::string* templateId = nullptr) const;
+
+			static bool IsLabelMetadataKey(std::string_view key);
+
+			static const char* const kTemplateIdKey;	// "ProtectionTemplateId", stored next to the label keys
+
+		private:
+			size_t ReadJson(const std::string& path, std::unordered_map<std::string, std::string>& metadata, std::string* templateId) const;
+			size_t ReadExtendedAttributes(const std::string& path, std::unordered_map<std::string, std::string>& metadata, std::string* templateId) const;
+
+			MetadataReaderSettings mSettings;
+			std::shared_ptr<utils::AsyncLogSink> mLog;
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_METADATA_READER_H_
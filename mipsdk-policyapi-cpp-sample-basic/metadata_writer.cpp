@@ -0,0 +1,722 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "metadata_writer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <memory>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+#endif
+
+#include "json_reader.h"
+#include "mapped_file.h"
+#include "metadata_reader.h"
+#include "utils.h"
+
+using sample::policy::MetadataReader;
+using std::string;
+
+namespace {
+#if defined(_WIN32) || defined(_WIN64)
+	const char* kMetadataStream = ":MSIP_Label.json";
+	typedef HANDLE FileHandle;
+	const FileHandle kInvalidHandle = INVALID_HANDLE_VALUE;
+#else
+	const char* kAttributePrefix = "user.";
+#if defined(__APPLE__)
+	const int kMissingAttributeError = ENOATTR;
+#else
+	const int kMissingAttributeError = ENODATA;
+#endif
+	typedef int FileHandle;
+	const FileHandle kInvalidHandle = -1;
+#endif
+
+	// A file being committed as part of a directory batch.
+	struct FileWrite {
+		const sample::policy::MetadataPatch* patch = nullptr;
+		std::chrono::steady_clock::time_point submitted;
+		string target;		// Sidecar, stream or the file itself for xattrs
+		string temp;		// Written and synced before it is renamed over target. Empty when target is written in place.
+		FileHandle handle = kInvalidHandle;
+		size_t bytes = 0;
+		bool ok = true;
+	};
+
+#if !defined(__linux__)
+	// File syncs of one batch, handed out to whichever threads join.
+	struct SyncBatch {
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::vector<FileWrite*> writes;
+		bool fullSync = false;	// fsync rather than fdatasync
+		size_t next = 0;
+		size_t running = 0;		// Syncs taken and not yet finished
+	};
+#endif
+
+	string GetDirectory(const string& path)
+	{
+		auto pos = path.find_last_of("/\\");
+		if (pos == string::npos)
+		{
+			return ".";
+		}
+		return pos == 0 ? path.substr(0, 1) : path.substr(0, pos);
+	}
+
+	void AppendJsonString(string& output, const string& value)
+	{
+		output += '"';
+		for (char c : value)
+		{
+			switch (c)
+			{
+			case '"': output += "\\\""; break;
+			case '\\': output += "\\\\"; break;
+			case '\n': output += "\\n"; break;
+			case '\r': output += "\\r"; break;
+			case '\t': output += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					char escape[8];
+					snprintf(escape, sizeof(escape), "\\u%04x", c);
+					output += escape;
+				}
+				else
+				{
+					output += c;
+				}
+			}
+		}
+		output += '"';
+	}
+
+	// Existing JSON metadata with the patch applied.
+	string BuildMetadataJson(const string& existingPath, const sample::policy::MetadataPatch& patch)
+	{
+		std::map<string, string> entries;
+		if (sample::utils::FileExists(existingPath.c_str()))
+		{
+			try
+			{
+				sample::utils::MappedFile file(existingPath);
+				if (file.GetSize() > 0)
+				{
+					sample::utils::JsonDocument document(std::string_view(file.GetData(), file.GetSize()));
+					for (const auto& member : document.GetRoot().GetObject())
+					{
+						if (member.second.IsString())
+						{
+							entries.emplace(string(member.first), string(member.second.GetString()));
+						}
+						else if (member.second.GetType() == sample::utils::JsonValue::Type::Bool)
+						{
+							entries.emplace(string(member.first), member.second.GetBool() ? "true" : "false");
+						}
+					}
+				}
+			}
+			catch (const std::exception&)
+			{
+				// A corrupt file is replaced by the patch contents.
+				entries.clear();
+			}
+		}
+
+		for (const auto& key : patch.keysToRemove)
+		{
+			entries.erase(key);
+		}
+		for (const auto& entry : patch.keysToSet)
+		{
+			entries[entry.first] = entry.second;
+		}
+		if (patch.protectionChanged)
+		{
+			if (patch.templateId.empty())
+			{
+				entries.erase(MetadataReader::kTemplateIdKey);
+			}
+			else
+			{
+				entries[MetadataReader::kTemplateIdKey] = patch.templateId;
+			}
+		}
+
+		string json = "{";
+		for (const auto& entry : entries)
+		{
+			if (json.size() > 1)
+			{
+				json += ",\n";
+			}
+			AppendJsonString(json, entry.first);
+			json += ':';
+			AppendJsonString(json, entry.second);
+		}
+		json += "}\n";
+		return json;
+	}
+
+	void CloseHandleIfOpen(FileHandle& handle)
+	{
+		if (handle == kInvalidHandle)
+		{
+			return;
+		}
+#if defined(_WIN32) || defined(_WIN64)
+		CloseHandle(handle);
+#else
+		close(handle);
+#endif
+		handle = kInvalidHandle;
+	}
+
+	FileHandle CreateForWrite(const string& path)
+	{
+#if defined(_WIN32) || defined(_WIN64)
+		return CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+		return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+	}
+
+	bool WriteAll(FileHandle handle, const string& data)
+	{
+		size_t offset = 0;
+		while (offset < data.size())
+		{
+#if defined(_WIN32) || defined(_WIN64)
+			DWORD written = 0;
+			if (!WriteFile(handle, data.data() + offset, static_cast<DWORD>(data.size() - offset), &written, nullptr))
+			{
+				return false;
+			}
+#else
+			ssize_t written = write(handle, data.data() + offset, data.size() - offset);
+			if (written < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+#endif
+			offset += static_cast<size_t>(written);
+		}
+		return true;
+	}
+
+	bool SyncHandle(FileHandle handle)
+	{
+#if defined(_WIN32) || defined(_WIN64)
+		return FlushFileBuffers(handle) != 0;
+#elif defined(__linux__)
+		return fdatasync(handle) == 0;
+#else
+		return fsync(handle) == 0;
+#endif
+	}
+
+	bool ReplaceFile(const string& from, const string& to)
+	{
+#if defined(_WIN32) || defined(_WIN64)
+		return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		return rename(from.c_str(), to.c_str()) == 0;
+#endif
+	}
+
+#if !defined(__linux__)
+	// A write is only touched after it is taken, and the committing thread waits for those, so a pool thread that starts
+	// after the batch is done touches nothing but batch.
+	void SyncWrites(const std::shared_ptr<SyncBatch>& batch)
+	{
+		for (;;)
+		{
+			FileWrite* write;
+			{
+				std::lock_guard<std::mutex> lock(batch->mutex);
+				if (batch->next >= batch->writes.size())
+				{
+					return;
+				}
+				write = batch->writes[batch->next++];
+				++batch->running;
+			}
+
+#if defined(_WIN32) || defined(_WIN64)
+			write->ok = SyncHandle(write->handle);
+#else
+			write->ok = batch->fullSync ? fsync(write->handle) == 0 : SyncHandle(write->handle);
+#endif
+
+			bool done;
+			{
+				std::lock_guard<std::mutex> lock(batch->mutex);
+				--batch->running;
+				done = batch->running == 0 && batch->next >= batch->writes.size();
+			}
+			if (done)
+			{
+				batch->finished.notify_all();
+			}
+		}
+	}
+#endif
+
+#if !defined(_WIN32) && !defined(_WIN64)
+	bool ApplyExtendedAttributes(int fd, const sample::policy::MetadataPatch& patch, size_t& bytes)
+	{
+		auto setAttribute = [&](const string& key, const string& value) {
+			string name = kAttributePrefix + key;
+#if defined(__APPLE__)
+			int result = fsetxattr(fd, name.c_str(), value.data(), value.size(), 0, 0);
+#else
+			int result = fsetxattr(fd, name.c_str(), value.data(), value.size(), 0);
+#endif
+			bytes += value.size();
+			return result == 0;
+		};
+		auto removeAttribute = [&](const string& key) {
+			string name = kAttributePrefix + key;
+#if defined(__APPLE__)
+			int result = fremovexattr(fd, name.c_str(), 0);
+#else
+			int result = fremovexattr(fd, name.c_str());
+#endif
+			return result == 0 || errno == kMissingAttributeError;
+		};
+
+		for (const auto& key : patch.keysToRemove)
+		{
+			if (!removeAttribute(key))
+			{
+				return false;
+			}
+		}
+		for (const auto& entry : patch.keysToSet)
+		{
+			if (!setAttribute(entry.first, entry.second))
+			{
+				return false;
+			}
+		}
+		if (patch.protectionChanged)
+		{
+			return patch.templateId.empty() ? removeAttribute(MetadataReader::kTemplateIdKey) : setAttribute(MetadataReader::kTemplateIdKey, patch.templateId);
+		}
+		return true;
+	}
+#endif
+}
+
+namespace sample {
+	namespace policy {
+
+		void MetadataPatch::AddResult(const ActionResult& result)
+		{
+			if (const auto* metadata = std::get_if<MetadataResult>(&result))
+			{
+				for (auto key : metadata->keysToRemove)
+				{
+					string name(key);
+					keysToSet.erase(name);
+					keysToRemove.insert(std::move(name));
+				}
+				for (const auto& entry : metadata->entriesToAdd)
+				{
+					string name(entry.key);
+					keysToRemove.erase(name);
+					keysToSet[std::move(name)] = string(entry.value);
+				}
+			}
+			else if (const auto* protect = std::get_if<ProtectByTemplateResult>(&result))
+			{
+				protectionChanged = true;
+				templateId.assign(protect->templateId.data(), protect->templateId.size());
+			}
+			else if (std::holds_alternative<RemoveProtectionResult>(result))
+			{
+				protectionChanged = true;
+				templateId.clear();
+			}
+		}
+
+		void MetadataPatch::Merge(const MetadataPatch& later)
+		{
+			for (const auto& key : later.keysToRemove)
+			{
+				keysToSet.erase(key);
+				keysToRemove.insert(key);
+			}
+			for (const auto& entry : later.keysToSet)
+			{
+				keysToRemove.erase(entry.first);
+				keysToSet[entry.first] = entry.second;
+			}
+			if (later.protectionChanged)
+			{
+				protectionChanged = true;
+				templateId = later.templateId;
+			}
+		}
+
+		MetadataWriter::MetadataWriter(const MetadataWriterSettings& settings) : mSettings(settings)
+		{
+			unsigned int threadCount = std::max(1u, mSettings.threadCount);
+#if !defined(__linux__)
+			// Each commit thread syncs too, so the pool supplies the rest of syncThreads for every thread that commits.
+			unsigned int syncThreads = std::max(1u, mSettings.syncThreads);
+			if (syncThreads > 1)
+			{
+				mSyncPool.reset(new utils::WorkerPool((syncThreads - 1) * threadCount, (syncThreads - 1) * threadCount * 2));
+			}
+#endif
+			for (unsigned int i = 0; i < threadCount; ++i)
+			{
+				mThreads.emplace_back(&MetadataWriter::Run, this);
+			}
+		}
+
+		MetadataWriter::~MetadataWriter()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mStopping = true;
+			}
+			mWorkAvailable.notify_all();
+			for (auto& thread : mThreads)
+			{
+				thread.join();
+			}
+		}
+
+		void MetadataWriter::Submit(MetadataPatch patch)
+		{
+			if (patch.IsEmpty())
+			{
+				return;
+			}
+
+			auto now = std::chrono::steady_clock::now();
+			auto directory = GetDirectory(patch.contentIdentifier);
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				++mStats.patchesSubmitted;
+				auto& batch = mPending[directory];
+				if (batch.files.empty())
+				{
+					batch.opened = now;
+				}
+				auto existing = batch.files.find(patch.contentIdentifier);
+				if (existing != batch.files.end())
+				{
+					existing->second.patch.Merge(patch);
+					++mStats.patchesCoalesced;
+					return;
+				}
+				string path = patch.contentIdentifier;
+				batch.files.emplace(std::move(path), PendingPatch{ std::move(patch), now });
+				++mOutstanding;
+			}
+			mWorkAvailable.notify_one();
+		}
+
+		void MetadataWriter::Flush()
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			++mFlushWaiters;
+			mWorkAvailable.notify_all();
+			mIdle.wait(lock, [this]() { return mOutstanding == 0; });
+			--mFlushWaiters;
+		}
+
+		MetadataWriterStats MetadataWriter::GetStats() const
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			MetadataWriterStats stats = mStats;
+			uint64_t count = 0;
+			for (auto bucket : mLatencyBuckets)
+			{
+				count += bucket;
+			}
+			if (count > 0)
+			{
+				stats.averageLatencyMs = mTotalLatencyMs / count;
+				uint64_t threshold = (count * 99 + 99) / 100;
+				uint64_t seen = 0;
+				for (size_t i = 0; i < mLatencyBuckets.size(); ++i)
+				{
+					seen += mLatencyBuckets[i];
+					if (seen >= threshold)
+					{
+						stats.p99LatencyMs = std::min(static_cast<double>(1ull << i) / 1000.0, stats.maxLatencyMs);
+						break;
+					}
+				}
+			}
+			return stats;
+		}
+
+		void MetadataWriter::RecordLatency(std::chrono::steady_clock::duration latency)
+		{
+			auto micros = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+			size_t bucket = 0;
+			while (bucket + 1 < mLatencyBuckets.size() && (1ll << bucket) <= micros)
+			{
+				++bucket;
+			}
+			++mLatencyBuckets[bucket];
+			double ms = micros / 1000.0;
+			mTotalLatencyMs += ms;
+			mStats.maxLatencyMs = std::max(mStats.maxLatencyMs, ms);
+		}
+
+		void MetadataWriter::Run()
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			for (;;)
+			{
+				auto now = std::chrono::steady_clock::now();
+				auto wakeAt = std::chrono::steady_clock::time_point::max();
+				auto ready = mPending.end();
+				for (auto it = mPending.begin(); it != mPending.end(); ++it)
+				{
+					// A directory is committed by one thread at a time so writes to the same file stay ordered.
+					if (mInFlight.count(it->first) != 0)
+					{
+						continue;
+					}
+					auto due = it->second.opened + mSettings.batchDelay;
+					if (mStopping || mFlushWaiters > 0 || it->second.files.size() >= mSettings.maxBatchSize || due <= now)
+					{
+						ready = it;
+						break;
+					}
+					wakeAt = std::min(wakeAt, due);
+				}
+
+				if (ready != mPending.end())
+				{
+					string directory = ready->first;
+					DirectoryBatch batch = std::move(ready->second);
+					mPending.erase(ready);
+					mInFlight.insert(directory);
+
+					lock.unlock();
+					Commit(directory, batch);
+					lock.lock();
+
+					mInFlight.erase(directory);
+					mOutstanding -= batch.files.size();
+					if (mOutstanding == 0)
+					{
+						mIdle.notify_all();
+					}
+					// Patches for this directory that arrived during the commit can be picked up now.
+					mWorkAvailable.notify_all();
+					continue;
+				}
+
+				if (mStopping && mPending.empty())
+				{
+					return;
+				}
+				if (wakeAt == std::chrono::steady_clock::time_point::max())
+				{
+					mWorkAvailable.wait(lock);
+				}
+				else
+				{
+					mWorkAvailable.wait_until(lock, wakeAt);
+				}
+			}
+		}
+
+		void MetadataWriter::Commit(const string& directory, DirectoryBatch& batch)
+		{
+			std::vector<FileWrite> writes;
+			writes.reserve(batch.files.size());
+			uint64_t syncs = 0;
+
+			// Write every file of the batch before syncing any of them, so the device sees one burst of writes.
+			for (auto& entry : batch.files)
+			{
+				FileWrite write;
+				write.patch = &entry.second.patch;
+				write.submitted = entry.second.submitted;
+				const string& path = entry.first;
+				if (!utils::FileExists(path.c_str()))
+				{
+					write.ok = false;
+					writes.push_back(std::move(write));
+					continue;
+				}
+
+				if (mSettings.useExtendedAttributes)
+				{
+#if defined(_WIN32) || defined(_WIN64)
+					// Alternate data streams can't be renamed into place, so the stream is rewritten directly.
+					write.target = path + kMetadataStream;
+					auto json = BuildMetadataJson(write.target, *write.patch);
+					write.handle = CreateForWrite(write.target);
+					write.ok = write.handle != kInvalidHandle && WriteAll(write.handle, json);
+					write.bytes = json.size();
+#else
+					write.target = path;
+					write.handle = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+					write.ok = write.handle != kInvalidHandle && ApplyExtendedAttributes(write.handle, *write.patch, write.bytes);
+#endif
+				}
+				else
+				{
+					write.target = path + mSettings.sidecarSuffix;
+					write.temp = write.target + ".tmp";
+					auto json = BuildMetadataJson(write.target, *write.patch);
+					write.handle = CreateForWrite(write.temp);
+					write.ok = write.handle != kInvalidHandle && WriteAll(write.handle, json);
+					write.bytes = json.size();
+				}
+				writes.push_back(std::move(write));
+			}
+
+#if defined(__linux__)
+			// syncfs writes back and commits everything dirty on the file system, including extended attributes, so the
+			// batch needs one journal commit and one device flush. It also writes back other processes' dirty data on
+			// the same file system, which costs time but not correctness.
+			auto written = std::find_if(writes.begin(), writes.end(), [](const FileWrite& write) { return write.ok; });
+			if (written != writes.end())
+			{
+				bool synced = syncfs(written->handle) == 0;
+				++syncs;
+				for (auto& write : writes)
+				{
+					write.ok = write.ok && synced;
+				}
+			}
+#else
+			// Issue the syncs of the batch concurrently; each thread blocks in its own sync, so they overlap.
+			auto syncBatch = std::make_shared<SyncBatch>();
+#if !defined(_WIN32) && !defined(_WIN64)
+			// Extended attributes are inode metadata, which fdatasync doesn't cover.
+			syncBatch->fullSync = mSettings.useExtendedAttributes;
+#endif
+			for (auto& write : writes)
+			{
+				if (write.ok)
+				{
+					syncBatch->writes.push_back(&write);
+				}
+			}
+			if (mSyncPool && !syncBatch->writes.empty())
+			{
+				size_t helperCount = std::min<size_t>(mSettings.syncThreads - 1, syncBatch->writes.size() - 1);
+				for (size_t i = 0; i < helperCount; ++i)
+				{
+					std::function<void()> helper = [syncBatch]() { SyncWrites(syncBatch); };
+					if (!mSyncPool->TrySubmit(helper))
+					{
+						break;
+					}
+				}
+			}
+			SyncWrites(syncBatch);
+			{
+				std::unique_lock<std::mutex> lock(syncBatch->mutex);
+				syncBatch->finished.wait(lock, [&syncBatch]() { return syncBatch->running == 0; });
+			}
+			syncs += syncBatch->writes.size();
+#endif
+
+			bool renamed = false;
+			for (auto& write : writes)
+			{
+				CloseHandleIfOpen(write.handle);
+				if (!write.temp.empty())
+				{
+					if (write.ok)
+					{
+						write.ok = ReplaceFile(write.temp, write.target);
+						renamed = renamed || write.ok;
+					}
+					if (!write.ok)
+					{
+						std::remove(write.temp.c_str());
+					}
+				}
+			}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+			// One directory sync makes every rename of the batch durable.
+			if (renamed)
+			{
+				int directoryHandle = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+				if (directoryHandle >= 0)
+				{
+					fsync(directoryHandle);
+					close(directoryHandle);
+					++syncs;
+				}
+			}
+#else
+			(void)directory;
+			(void)renamed;
+#endif
+
+			auto now = std::chrono::steady_clock::now();
+			std::lock_guard<std::mutex> lock(mMutex);
+			++mStats.batches;
+			mStats.syncs += syncs;
+			for (const auto& write : writes)
+			{
+				if (!write.ok)
+				{
+					++mStats.failures;
+					continue;
+				}
+				++mStats.filesWritten;
+				mStats.bytesWritten += write.bytes;
+				RecordLatency(now - write.submitted);
+			}
+		}
+
+	} //  namespace policy
+} //  namespace sample
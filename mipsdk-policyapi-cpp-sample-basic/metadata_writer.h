@@ -0,0 +1,147 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_METADATA_WRITER_H_
+#define SAMPLES_UPE_METADATA_WRITER_H_
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "action_results.h"
+#include "worker_pool.h"
+
+namespace sample {
+	namespace policy {
+
+		/**
+		 * @brief Metadata and protection changes to make to one file.
+		 * Built from the actions ComputeActions returns. Later changes override earlier ones, so several patches for
+		 * the same file can be merged into one write.
+		 */
+		struct MetadataPatch {
+			std::string contentIdentifier;				// Path of the file the patch applies to
+			std::set<std::string> keysToRemove;
+			std::map<std::string, std::string> keysToSet;
+			bool protectionChanged = false;
+			std::string templateId;						// Template to protect with when protectionChanged. Empty removes protection. Stored under MetadataReader::kTemplateIdKey.
+
+			void AddResult(const ActionResult& result);	// Record METADATA, PROTECT_BY_TEMPLATE and REMOVE_PROTECTION results
+			void Merge(const MetadataPatch& later);
+			bool IsEmpty() const { return keysToRemove.empty() && keysToSet.empty() && !protectionChanged; }
+		};
+
+		struct MetadataWriterSettings {
+			unsigned int threadCount = 2;				// I/O threads. Zero uses one.
+			size_t maxBatchSize = 256;					// Files of one directory committed with a single directory sync
+			std::chrono::milliseconds batchDelay{ 20 };	// How long a directory collects patches before it is committed
+			bool useExtendedAttributes = false;			// Write user.* xattrs (the :MSIP_Label.json stream on NTFS) instead of sidecars
+			std::string sidecarSuffix = ".mipmeta.json";
+			unsigned int syncThreads = 8;				// File syncs of one batch in flight at once where there is no syncfs. Zero uses one.
+		};
+
+		struct MetadataWriterStats {
+			uint64_t patchesSubmitted = 0;
+			uint64_t patchesCoalesced = 0;	// Patches merged into one already waiting for the same file
+			uint64_t filesWritten = 0;
+			uint64_t failures = 0;
+			uint64_t bytesWritten = 0;
+			uint64_t batches = 0;			// Directory group commits
+			uint64_t syncs = 0;				// File, file system and directory sync calls
+			double averageLatencyMs = 0;	// From Submit() until the change is durable
+			double p99LatencyMs = 0;		// Upper bound of the power of two bucket holding the 99th percentile
+			double maxLatencyMs = 0;
+		};
+
+		/**
+		 * @brief Applies metadata patches on a pool of I/O threads.
+		 * Patches are grouped by directory. Patches for a file that is still waiting are merged, and each directory
+		 * batch is written, synced and then renamed into place with one directory sync. On Linux the whole batch is
+		 * synced with one syncfs, so it costs one journal commit and one device flush instead of one per file. Elsewhere
+		 * the file syncs of a batch are issued concurrently on a shared pool, so they overlap instead of queueing.
+		 * Files follow the MetadataReader conventions, so a reader sees the changes once Flush() returns.
+		 */
+		class MetadataWriter final {
+		public:
+			explicit MetadataWriter(const MetadataWriterSettings& settings = MetadataWriterSettings());
+			~MetadataWriter();	// Commits everything still pending
+
+			MetadataWriter(const MetadataWriter&) = delete;
+			MetadataWriter& operator=(const MetadataWriter&) = delete;
+
+			void Submit(MetadataPatch patch);
+			void Flush();		// Wait until every patch submitted so far is durable or has failed
+			MetadataWriterStats GetStats() const;
+
+		private:
+			struct PendingPatch {
+				MetadataPatch patch;
+				std::chrono::steady_clock::time_point submitted;
+			};
+
+			struct DirectoryBatch {
+				std::unordered_map<std::string, PendingPatch> files;
+				std::chrono::steady_clock::time_point opened;
+			};
+
+			void Run();
+			void Commit(const std::string& directory, DirectoryBatch& batch);
+			void RecordLatency(std::chrono::steady_clock::duration latency);
+
+			MetadataWriterSettings mSettings;
+			std::unique_ptr<utils::WorkerPool> mSyncPool;	// Helps commit threads sync where there is no syncfs
+			std::vector<std::thread> mThreads;
+
+			mutable std::mutex mMutex;
+			std::condition_variable mWorkAvailable;
+			std::condition_variable mIdle;
+			std::unordered_map<std::string, DirectoryBatch> mPending;	// Keyed by directory
+			std::unordered_set<std::string> mInFlight;					// Directories being committed
+			size_t mOutstanding = 0;									// Files pending or in flight
+			int mFlushWaiters = 0;
+			bool mStopping = false;
+
+			MetadataWriterStats mStats;
+			std::array<uint64_t, 40> mLatencyBuckets{};					// Bucket i counts latencies below 2^i microseconds
+			double mTotalLatencyMs = 0;
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_METADATA_WRITER_H_
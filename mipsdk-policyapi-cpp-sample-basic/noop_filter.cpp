@@ -0,0 +1,151 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "noop_filter.h"
+
+#include <algorithm>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "label_metadata.h"
+
+using std::string;
+using std::string_view;
+
+namespace sample {
+	namespace policy {
+
+		NoOpFilter::NoOpFilter(size_t maxSignatures, std::shared_ptr<utils::MemoryAccount> memory)
+			: mMaxSignatures(maxSignatures),
+			mMemory(std::move(memory)),
+			mSignatures(0, utils::CountedStringHash(), std::equal_to<utils::CountedString>(), SignatureSet::allocator_type(mMemory.get()))
+		{
+		}
+
+		bool NoOpFilter::BuildSignature(const ExecutionStateOptions& options, utils::CountedString& signature)
+		{
+			const auto& label = options.newLabel;
+			// Properties the caller supplies aren't a function of the label ID, so they would need to be part of the signature.
+			if (!label || !label->IsActive() || !label->GetChildren().empty() || options.classifier || options.content ||
+				options.newLabelExtendedProperties)
+			{
+				return false;
+			}
+
+			const string& labelId = label->GetId();
+			if (FindEnabledLabelId(options.metadata) != labelId)
+			{
+				return false;
+			}
+
+			// unordered_map order differs between equal maps, so the entries are sorted before they are appended.
+			std::vector<std::pair<string_view, string_view>> entries;
+			entries.reserve(8);
+			string_view prefix(kLabelMetadataPrefix);
+			for (const auto& entry : options.metadata)
+			{
+				if (entry.first.compare(0, prefix.size(), prefix) != 0)
+				{
+					continue;
+				}
+				if (!IsLabelMetadataKeyFor(entry.first, labelId))
+				{
+					return false;	// Another label's entries would be cleaned up
+				}
+				if (!IsVolatileLabelMetadataKey(entry.first))
+				{
+					entries.emplace_back(entry.first, entry.second);
+				}
+			}
+			std::sort(entries.begin(), entries.end());
+
+			signature.clear();
+			signature += labelId;
+			signature += '\n';
+			signature += options.templateId;
+			signature += '\n';
+			signature += options.contentFormat;
+			signature += '\n';
+			signature += std::to_string(static_cast<int>(options.assignmentMethod));
+			signature += ',';
+			signature += std::to_string(static_cast<int>(options.actionSource));
+			signature += ',';
+			signature += std::to_string(static_cast<int>(options.dataState));
+			signature += ',';
+			signature += std::to_string(static_cast<unsigned int>(options.supportedActions));
+			for (const auto& entry : entries)
+			{
+				signature += '\n';
+				signature.append(entry.first.data(), entry.first.size());
+				signature += '=';
+				signature.append(entry.second.data(), entry.second.size());
+			}
+			return true;
+		}
+
+		bool NoOpFilter::IsNoOp(const ExecutionStateOptions& options) const
+		{
+			thread_local utils::CountedString signature;
+			if (!BuildSignature(options, signature))
+			{
+				return false;
+			}
+			std::shared_lock<std::shared_mutex> lock(mMutex);
+			return mSignatures.count(signature) != 0;
+		}
+
+		void NoOpFilter::RecordNoOp(const ExecutionStateOptions& options)
+		{
+			utils::CountedString signature;
+			if (!BuildSignature(options, signature))
+			{
+				return;
+			}
+			std::unique_lock<std::shared_mutex> lock(mMutex);
+			if (mSignatures.size() < mMaxSignatures)
+			{
+				mSignatures.insert(std::move(signature));
+			}
+		}
+
+		void NoOpFilter::Clear()
+		{
+			std::unique_lock<std::shared_mutex> lock(mMutex);
+			SignatureSet(0, utils::CountedStringHash(), std::equal_to<utils::CountedString>(), mSignatures.get_allocator()).swap(mSignatures);
+		}
+
+		size_t NoOpFilter::GetSignatureCount() const
+		{
+			std::shared_lock<std::shared_mutex> lock(mMutex);
+			return mSignatures.size();
+		}
+
+	} //  namespace policy
+} //  namespace sample
@@ -0,0 +1,79 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_NOOP_FILTER_H_
+#define SAMPLES_UPE_NOOP_FILTER_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <scoped_allocator>
+#include <shared_mutex>
+#include <string>
+#include <unordered_set>
+
+#include "execution_state_impl.h"
+#include "memory_accounting.h"
+
+namespace sample {
+	namespace policy {
+
+		/**
+		 * @brief Recognizes label requests that are already satisfied, so they can be answered without an evaluation.
+		 * A state is eligible when its new label is an active leaf of the hierarchy, its MSIP_Label_* metadata has that
+		 * label enabled and describes no other label, and nothing content-dependent (classifier, content) or caller-supplied
+		 * extended properties are attached.
+		 * Its signature is the label, protection template, assignment method, format and the label's metadata apart from
+		 * per-write values. Once the engine has answered an eligible state with no actions, every state with the same
+		 * signature is a no-op under the same policy.
+		 */
+		class NoOpFilter final {
+		public:
+			explicit NoOpFilter(size_t maxSignatures = 4096, std::shared_ptr<utils::MemoryAccount> memory = nullptr);	// Signatures are charged to memory
+
+			bool IsNoOp(const ExecutionStateOptions& options) const;
+			void RecordNoOp(const ExecutionStateOptions& options);	// The engine returned no actions for options.
+			void Clear();	// Forget every signature. They are learned again from later evaluations.
+			size_t GetSignatureCount() const;
+
+		private:
+			typedef std::unordered_set<utils::CountedString, utils::CountedStringHash, std::equal_to<utils::CountedString>,
+				std::scoped_allocator_adaptor<utils::CountingAllocator<utils::CountedString>>> SignatureSet;
+
+			static bool BuildSignature(const ExecutionStateOptions& options, utils::CountedString& signature);
+
+			const size_t mMaxSignatures;
+			std::shared_ptr<utils::MemoryAccount> mMemory;	// Declared before mSignatures, which releases into it
+			mutable std::shared_mutex mMutex;
+			SignatureSet mSignatures;
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_NOOP_FILTER_H_
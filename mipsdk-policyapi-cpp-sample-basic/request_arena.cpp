@@ -0,0 +1,122 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+#include "request_arena.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <optional>
+
+namespace {
+	const size_t kInitialArenaBytes = 16 * 1024;
+	const size_t kMaxArenaBytes = 1024 * 1024;	// Larger requests take the rest from the heap, and it is freed after each one
+
+	// Counts what the arena had to take beyond its buffer, so the buffer can grow to fit the thread's requests.
+	class OverflowResource final : public std::pmr::memory_resource {
+	public:
+		size_t GetBytes() const { return mBytes; }
+		void Reset() { mBytes = 0; }
+
+	private:
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			mBytes += bytes;
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* memory, size_t bytes, size_t alignment) override
+		{
+			std::pmr::new_delete_resource()->deallocate(memory, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+		size_t mBytes = 0;
+	};
+
+	struct ThreadArena {
+		std::unique_ptr<std::byte[]> buffer;
+		size_t size = 0;
+		OverflowResource overflow;
+		std::optional<std::pmr::monotonic_buffer_resource> resource;
+		int depth = 0;
+
+		void Reset()
+		{
+			// A request that overflowed the buffer will likely recur, so the next buffer holds all of it, up to kMaxArenaBytes.
+			if (!resource || (overflow.GetBytes() > 0 && size < kMaxArenaBytes))
+			{
+				resource.reset();
+				size = size == 0 ? kInitialArenaBytes : std::min(size + overflow.GetBytes(), kMaxArenaBytes);
+				buffer.reset(new std::byte[size]);
+				overflow.Reset();
+				resource.emplace(buffer.get(), size, &overflow);
+			}
+			else
+			{
+				resource->release();
+				overflow.Reset();
+			}
+		}
+	};
+
+	thread_local ThreadArena tArena;
+}
+
+namespace sample {
+	namespace utils {
+
+		RequestArenaScope::RequestArenaScope()
+		{
+			if (tArena.depth++ == 0 && !tArena.resource)
+			{
+				tArena.Reset();
+			}
+		}
+
+		RequestArenaScope::~RequestArenaScope()
+		{
+			if (--tArena.depth == 0)
+			{
+				tArena.Reset();
+			}
+		}
+
+		std::pmr::memory_resource* GetRequestResource()
+		{
+			if (tArena.depth == 0)
+			{
+				return std::pmr::get_default_resource();
+			}
+			return &*tArena.resource;
+		}
+
+	} //  namespace utils
+} //  namespace sample
@@ -0,0 +1,60 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+#ifndef SAMPLES_UTILS_REQUEST_ARENA_H_
+#define SAMPLES_UTILS_REQUEST_ARENA_H_
+
+#include <memory_resource>
+
+namespace sample {
+	namespace utils {
+
+		/**
+		 * @brief Marks the calling thread as serving one request until destroyed. Memory taken from GetRequestResource
+		 * during the request is released all at once when the outermost scope ends, and the thread reuses it for its next request.
+		 * The per-thread buffer grows to fit past requests up to a cap; beyond it a request's allocations come from the heap.
+		 * A scope started while another is active on the thread joins the outer one.
+		 */
+		class RequestArenaScope final {
+		public:
+			RequestArenaScope();
+			~RequestArenaScope();
+
+			RequestArenaScope(const RequestArenaScope&) = delete;
+			RequestArenaScope& operator=(const RequestArenaScope&) = delete;
+		};
+
+		// The calling thread's arena while a RequestArenaScope is active, otherwise the default resource.
+		// Objects allocated from it must not outlive the scope.
+		std::pmr::memory_resource* GetRequestResource();
+
+	} //  namespace utils
+} //  namespace sample
+
+#endif //  SAMPLES_UTILS_REQUEST_ARENA_H_
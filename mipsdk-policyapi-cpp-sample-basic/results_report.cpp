@@ -0,0 +1,643 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+#include "results_report.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+#include "content_hash.h"
+#include "label_metadata.h"
+#include "metadata_writer.h"
+#include "utils.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+	const char kMagic[8] = { 'M', 'I', 'P', 'R', 'S', 'L', 'T', '2' };
+
+	void AppendVarint(string& output, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			output += static_cast<char>((value & 0x7F) | 0x80);
+			value >>= 7;
+		}
+		output += static_cast<char>(value);
+	}
+
+	// (run length, value) pairs. Bulk results repeat the same few values for long stretches.
+	void AppendRuns(string& output, const vector<uint32_t>& values)
+	{
+		for (size_t i = 0; i < values.size();)
+		{
+			size_t end = i + 1;
+			while (end < values.size() && values[end] == values[i])
+			{
+				++end;
+			}
+			AppendVarint(output, end - i);
+			AppendVarint(output, values[i]);
+			i = end;
+		}
+	}
+
+	void AppendVarints(string& output, const vector<uint32_t>& values)
+	{
+		for (uint32_t value : values)
+		{
+			AppendVarint(output, value);
+		}
+	}
+
+	// Each string is stored as the length it shares with the previous one, then the rest. Paths from one crawl share most of their bytes.
+	void AppendFrontCoded(string& output, const vector<string>& values)
+	{
+		std::string_view previous;
+		for (const auto& value : values)
+		{
+			size_t shared = 0;
+			size_t limit = std::min(previous.size(), value.size());
+			while (shared < limit && previous[shared] == value[shared])
+			{
+				++shared;
+			}
+			AppendVarint(output, shared);
+			AppendVarint(output, value.size() - shared);
+			output.append(value, shared, string::npos);
+			previous = value;
+		}
+	}
+
+	void AppendColumn(string& output, const string& column)
+	{
+		AppendVarint(output, column.size());
+		output += column;
+	}
+
+	class ResultsParser {
+	public:
+		ResultsParser(const char* data, size_t size) : mData(data), mSize(size) {}
+
+		bool AtEnd() const { return mPosition == mSize; }
+		size_t GetPosition() const { return mPosition; }
+
+		uint64_t ReadVarint()
+		{
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				if (mPosition >= mSize)
+				{
+					Fail();
+				}
+				uint8_t byte = static_cast<uint8_t>(mData[mPosition++]);
+				value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0)
+				{
+					return value;
+				}
+			}
+			Fail();
+			return 0;
+		}
+
+		std::string_view ReadBytes(uint64_t length)
+		{
+			if (length > mSize - mPosition)
+			{
+				Fail();
+			}
+			std::string_view value(mData + mPosition, static_cast<size_t>(length));
+			mPosition += static_cast<size_t>(length);
+			return value;
+		}
+
+		void ReadRuns(vector<uint32_t>& values, size_t rows)
+		{
+			values.clear();
+			values.reserve(rows);
+			while (!AtEnd())
+			{
+				uint64_t run = ReadVarint();
+				uint64_t value = ReadVarint();
+				if (run > rows - values.size())
+				{
+					Fail();
+				}
+				values.insert(values.end(), static_cast<size_t>(run), static_cast<uint32_t>(value));
+			}
+			if (values.size() != rows)
+			{
+				Fail();
+			}
+		}
+
+		void ReadVarints(vector<uint32_t>& values, size_t count)
+		{
+			values.clear();
+			values.reserve(count);
+			while (!AtEnd())
+			{
+				values.push_back(static_cast<uint32_t>(ReadVarint()));
+			}
+			if (values.size() != count)
+			{
+				Fail();
+			}
+		}
+
+		void ReadFrontCoded(vector<string>& values, size_t count)
+		{
+			values.clear();
+			values.reserve(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				uint64_t shared = ReadVarint();
+				uint64_t rest = ReadVarint();
+				if (shared > (i == 0 ? 0 : values.back().size()))
+				{
+					Fail();
+				}
+				string value = i == 0 ? string() : values.back().substr(0, static_cast<size_t>(shared));
+				auto suffix = ReadBytes(rest);
+				value.append(suffix.data(), suffix.size());
+				values.push_back(std::move(value));
+			}
+			if (!AtEnd())
+			{
+				Fail();
+			}
+		}
+
+		ResultsParser ReadColumn()
+		{
+			auto column = ReadBytes(ReadVarint());
+			return ResultsParser(column.data(), column.size());
+		}
+
+		[[noreturn]] void Fail() const
+		{
+			throw std::runtime_error("Results file is truncated or corrupt");
+		}
+
+	private:
+		const char* mData;
+		size_t mSize;
+		size_t mPosition = 0;
+	};
+
+	// A chunk is framed as its varint length, the chunk, then the chunk's XXH64 in little-endian order. False if the frame
+	// runs past size or the checksum doesn't match, which is how a chunk cut short by a crash looks.
+	bool ReadFrame(const char* data, size_t size, std::string_view& body, size_t& frameSize)
+	{
+		ResultsParser frame(data, size);
+		uint64_t checksum = 0;
+		try
+		{
+			body = frame.ReadBytes(frame.ReadVarint());
+			auto trailer = frame.ReadBytes(sizeof(checksum));
+			for (size_t i = 0; i < sizeof(checksum); ++i)
+			{
+				checksum |= static_cast<uint64_t>(static_cast<uint8_t>(trailer[i])) << (8 * i);
+			}
+		}
+		catch (const std::runtime_error&)
+		{
+			return false;
+		}
+		frameSize = frame.GetPosition();
+		return sample::utils::HashContent(body.data(), body.size()) == checksum;
+	}
+}
+
+namespace sample {
+	namespace policy {
+
+		ResultsWriter::ResultsWriter(const string& path, const ResultsWriterSettings& settings)
+			: mSettings(settings),
+			mFile(path, std::ios::binary | std::ios::trunc)
+		{
+			if (!mFile)
+			{
+				throw std::runtime_error("Unable to create results file " + path);
+			}
+			mFile.write(kMagic, sizeof(kMagic));
+			mBytesWritten = sizeof(kMagic);
+		}
+
+		ResultsWriter::~ResultsWriter()
+		{
+			Flush();
+		}
+
+		uint32_t ResultsWriter::Intern(const string& value)
+		{
+			if (value.empty())
+			{
+				return 0;
+			}
+			auto result = mDictionary.emplace(value, static_cast<uint32_t>(mDictionary.size()));
+			if (result.second)
+			{
+				mNewEntries.push_back(&result.first->first);
+			}
+			return result.first->second + 1;
+		}
+
+		void ResultsWriter::Record(const ExecutionStateOptions& options, const ActionResults& actions, ResultOutcome outcome)
+		{
+			uint32_t actionBits = static_cast<uint32_t>(actions.GetTypes());
+			MetadataPatch patch;
+			for (const auto& result : actions)
+			{
+				patch.AddResult(result);
+			}
+			string currentLabelId = FindEnabledLabelId(options.metadata);
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			mActions.push_back(actionBits);
+			mOutcomes.push_back(static_cast<uint32_t>(outcome));
+			mCurrentLabels.push_back(Intern(currentLabelId));
+			mNewLabels.push_back(Intern(options.newLabel ? options.newLabel->GetId() : string()));
+			mTemplates.push_back(Intern(patch.protectionChanged ? patch.templateId : string()));
+			mContentIds.push_back(options.contentIdentifier);
+			mPatchCounts.push_back(static_cast<uint32_t>(patch.keysToRemove.size() + patch.keysToSet.size()));
+			for (const auto& key : patch.keysToRemove)
+			{
+				mPatchKeys.push_back(Intern(key) * 2 + 1);
+			}
+			for (const auto& entry : patch.keysToSet)
+			{
+				mPatchKeys.push_back(Intern(entry.first) * 2);
+				mPatchValues.push_back(entry.second);
+			}
+			++mRows;
+
+			if (mActions.size() >= mSettings.rowsPerChunk)
+			{
+				WriteChunk();
+			}
+		}
+
+		void ResultsWriter::WriteChunk()
+		{
+			if (mActions.empty())
+			{
+				return;
+			}
+
+			string chunk;
+			AppendVarint(chunk, mActions.size());
+			AppendVarint(chunk, mNewEntries.size());
+			for (const string* entry : mNewEntries)
+			{
+				AppendVarint(chunk, entry->size());
+				chunk += *entry;
+			}
+			mNewEntries.clear();
+
+			string column;
+			auto flushColumn = [&]() {
+				AppendColumn(chunk, column);
+				column.clear();
+			};
+			AppendRuns(column, mActions);
+			flushColumn();
+			AppendRuns(column, mOutcomes);
+			flushColumn();
+			AppendRuns(column, mCurrentLabels);
+			flushColumn();
+			AppendRuns(column, mNewLabels);
+			flushColumn();
+			AppendRuns(column, mTemplates);
+			flushColumn();
+			AppendFrontCoded(column, mContentIds);
+			flushColumn();
+			AppendRuns(column, mPatchCounts);
+			flushColumn();
+			AppendVarints(column, mPatchKeys);
+			flushColumn();
+			AppendFrontCoded(column, mPatchValues);
+			flushColumn();
+
+			string frame;
+			AppendVarint(frame, chunk.size());
+			frame += chunk;
+			uint64_t checksum = utils::HashContent(chunk.data(), chunk.size());
+			for (size_t i = 0; i < sizeof(checksum); ++i)
+			{
+				frame += static_cast<char>(checksum >> (8 * i));
+			}
+			mFile.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+			mBytesWritten += frame.size();
+
+			mActions.clear();
+			mOutcomes.clear();
+			mCurrentLabels.clear();
+			mNewLabels.clear();
+			mTemplates.clear();
+			mContentIds.clear();
+			mPatchCounts.clear();
+			mPatchKeys.clear();
+			mPatchValues.clear();
+		}
+
+		void ResultsWriter::Flush()
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			WriteChunk();
+			mFile.flush();
+		}
+
+		uint64_t ResultsWriter::GetRowCount() const
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			return mRows;
+		}
+
+		uint64_t ResultsWriter::GetBytesWritten() const
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			return mBytesWritten;
+		}
+
+		ResultsReader::ResultsReader(const string& path)
+			: mPosition(sizeof(kMagic))
+		{
+			if (!utils::FileExists(path.c_str()))
+			{
+				throw std::runtime_error("Results file " + path + " not found");
+			}
+			mFile = utils::MappedFile(path);
+			if (mFile.GetSize() < sizeof(kMagic) || std::memcmp(mFile.GetData(), kMagic, sizeof(kMagic)) != 0)
+			{
+				throw std::runtime_error(path + " is not a results file");
+			}
+		}
+
+		bool ResultsReader::ReadChunk(ResultChunk& chunk, unsigned columns)
+		{
+			if (mPosition == mFile.GetSize())
+			{
+				return false;
+			}
+
+			std::string_view body;
+			size_t frameSize = 0;
+			if (!ReadFrame(mFile.GetData() + mPosition, mFile.GetSize() - mPosition, body, frameSize))
+			{
+				// The writer stopped partway through this chunk. Everything before it is complete.
+				mTruncated = true;
+				mPosition = mFile.GetSize();
+				return false;
+			}
+
+			ResultsParser parser(body.data(), body.size());
+			chunk = ResultChunk();
+			chunk.rows = static_cast<size_t>(parser.ReadVarint());
+			uint64_t newEntries = parser.ReadVarint();
+			for (uint64_t i = 0; i < newEntries; ++i)
+			{
+				auto entry = parser.ReadBytes(parser.ReadVarint());
+				mDictionary.emplace_back(entry.data(), entry.size());
+			}
+
+			auto actions = parser.ReadColumn();
+			auto outcomes = parser.ReadColumn();
+			auto currentLabels = parser.ReadColumn();
+			auto newLabels = parser.ReadColumn();
+			auto templates = parser.ReadColumn();
+			auto contentIds = parser.ReadColumn();
+			auto patchCounts = parser.ReadColumn();
+			auto patchKeys = parser.ReadColumn();
+			auto patchValues = parser.ReadColumn();
+			mPosition += frameSize;
+
+			if (columns & kResultActions)
+			{
+				actions.ReadRuns(chunk.actions, chunk.rows);
+			}
+			if (columns & kResultOutcomes)
+			{
+				outcomes.ReadRuns(chunk.outcomes, chunk.rows);
+			}
+			if (columns & kResultCurrentLabels)
+			{
+				currentLabels.ReadRuns(chunk.currentLabels, chunk.rows);
+			}
+			if (columns & kResultNewLabels)
+			{
+				newLabels.ReadRuns(chunk.newLabels, chunk.rows);
+			}
+			if (columns & kResultTemplates)
+			{
+				templates.ReadRuns(chunk.templates, chunk.rows);
+			}
+			if (columns & kResultContentIds)
+			{
+				contentIds.ReadFrontCoded(chunk.contentIds, chunk.rows);
+			}
+			if (columns & (kResultPatchOffsets | kResultPatchEntries))
+			{
+				vector<uint32_t> counts;
+				patchCounts.ReadRuns(counts, chunk.rows);
+				chunk.patchOffsets.reserve(chunk.rows + 1);
+				chunk.patchOffsets.push_back(0);
+				for (uint32_t count : counts)
+				{
+					chunk.patchOffsets.push_back(chunk.patchOffsets.back() + count);
+				}
+			}
+			if (columns & kResultPatchEntries)
+			{
+				patchKeys.ReadVarints(chunk.patchKeys, chunk.patchOffsets.back());
+				vector<string> values;
+				size_t setKeys = 0;
+				for (uint32_t key : chunk.patchKeys)
+				{
+					setKeys += (key & 1) == 0 ? 1 : 0;
+				}
+				patchValues.ReadFrontCoded(values, setKeys);
+				chunk.patchValues.resize(chunk.patchKeys.size());
+				size_t next = 0;
+				for (size_t i = 0; i < chunk.patchKeys.size(); ++i)
+				{
+					if ((chunk.patchKeys[i] & 1) == 0)
+					{
+						chunk.patchValues[i] = std::move(values[next++]);
+					}
+					chunk.patchKeys[i] >>= 1;
+				}
+			}
+			if (!(columns & kResultPatchOffsets))
+			{
+				chunk.patchOffsets.clear();
+			}
+			return true;
+		}
+
+		const string& ResultsReader::Lookup(uint32_t reference) const
+		{
+			static const string kEmpty;
+			if (reference == 0)
+			{
+				return kEmpty;
+			}
+			if (reference > mDictionary.size())
+			{
+				throw std::runtime_error("Results file refers to an unknown dictionary entry");
+			}
+			return mDictionary[reference - 1];
+		}
+
+		ResultsSummary SummarizeResults(const string& path)
+		{
+			ResultsReader reader(path);
+			ResultsSummary summary;
+			ResultChunk chunk;
+
+			// Counts are kept by dictionary reference and only turned into strings at the end.
+			vector<uint64_t> newLabels;
+			vector<uint64_t> templates;
+			std::map<std::pair<uint32_t, uint32_t>, uint64_t> transitions;
+			auto countReference = [](vector<uint64_t>& counts, uint32_t reference) {
+				if (reference >= counts.size())
+				{
+					counts.resize(reference + 1);
+				}
+				++counts[reference];
+			};
+
+			unsigned columns = kResultActions | kResultOutcomes | kResultCurrentLabels | kResultNewLabels | kResultTemplates | kResultPatchOffsets;
+			while (reader.ReadChunk(chunk, columns))
+			{
+				++summary.chunks;
+				summary.rows += chunk.rows;
+				summary.metadataEntries += chunk.patchOffsets.back();
+				for (size_t i = 0; i < chunk.rows; ++i)
+				{
+					if (chunk.outcomes[i] < 3)
+					{
+						++summary.outcomes[chunk.outcomes[i]];
+					}
+					countReference(newLabels, chunk.newLabels[i]);
+					if (chunk.templates[i] != 0)
+					{
+						countReference(templates, chunk.templates[i]);
+					}
+					uint32_t bits = chunk.actions[i];
+					if (bits == 0)
+					{
+						continue;
+					}
+					++summary.withActions;
+					++transitions[std::make_pair(chunk.currentLabels[i], chunk.newLabels[i])];
+					for (uint32_t bit = 1; bit != 0; bit <<= 1)
+					{
+						if (bits & bit)
+						{
+							++summary.actionTypes[bit];
+						}
+					}
+				}
+			}
+
+			for (size_t i = 0; i < newLabels.size(); ++i)
+			{
+				if (newLabels[i] > 0)
+				{
+					summary.newLabels[reader.Lookup(static_cast<uint32_t>(i))] = newLabels[i];
+				}
+			}
+			for (size_t i = 0; i < templates.size(); ++i)
+			{
+				if (templates[i] > 0)
+				{
+					summary.templates[reader.Lookup(static_cast<uint32_t>(i))] = templates[i];
+				}
+			}
+			for (const auto& transition : transitions)
+			{
+				summary.transitions[std::make_pair(reader.Lookup(transition.first.first), reader.Lookup(transition.first.second))] = transition.second;
+			}
+			summary.truncated = reader.IsTruncated();
+			return summary;
+		}
+
+		void PrintResultsSummary(const ResultsSummary& summary)
+		{
+			printf("Rows: %" PRIu64 " in %" PRIu64 " chunk(s), evaluated: %" PRIu64 ", awaiting justification: %" PRIu64 ", failed: %" PRIu64 "\n",
+				summary.rows, summary.chunks, summary.outcomes[static_cast<int>(ResultOutcome::Evaluated)],
+				summary.outcomes[static_cast<int>(ResultOutcome::Deferred)], summary.outcomes[static_cast<int>(ResultOutcome::Failed)]);
+			if (summary.truncated)
+			{
+				printf("The file ends with an incomplete chunk, probably from an interrupted run. Only complete chunks are counted.\n");
+			}
+			printf("Need actions: %" PRIu64 ", metadata entries changed: %" PRIu64 "\n", summary.withActions, summary.metadataEntries);
+			for (const auto& actionType : summary.actionTypes)
+			{
+				const char* name = GetActionTypeName(static_cast<mip::ActionType>(actionType.first));
+				if (name != nullptr)
+				{
+					printf("  %-24s %12" PRIu64 "\n", name, actionType.second);
+				}
+				else
+				{
+					printf("  0x%-22x %12" PRIu64 "\n", actionType.first, actionType.second);
+				}
+			}
+			printf("Requested labels:\n");
+			for (const auto& label : summary.newLabels)
+			{
+				printf("  %-40s %12" PRIu64 "\n", label.first.c_str(), label.second);
+			}
+			printf("Label changes:\n");
+			for (const auto& transition : summary.transitions)
+			{
+				printf("  %-40s -> %-40s %12" PRIu64 "\n", transition.first.first.empty() ? "(none)" : transition.first.first.c_str(),
+					transition.first.second.empty() ? "(none)" : transition.first.second.c_str(), transition.second);
+			}
+			if (!summary.templates.empty())
+			{
+				printf("Protection templates:\n");
+				for (const auto& templateCount : summary.templates)
+				{
+					printf("  %-40s %12" PRIu64 "\n", templateCount.first.c_str(), templateCount.second);
+				}
+			}
+		}
+
+	} //  namespace policy
+} //  namespace sample
@@ -0,0 +1,167 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+#ifndef SAMPLES_UPE_RESULTS_REPORT_H_
+#define SAMPLES_UPE_RESULTS_REPORT_H_
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "action_results.h"
+#include "execution_state_impl.h"
+#include "mapped_file.h"
+
+namespace sample {
+	namespace policy {
+
+		enum class ResultOutcome : uint8_t {
+			Evaluated = 0,
+			Deferred = 1,		// A justification was deferred or denied
+			Failed = 2			// ComputeAction threw
+		};
+
+		struct ResultsWriterSettings {
+			size_t rowsPerChunk = 64 * 1024;	// Rows buffered before a chunk is encoded and written
+		};
+
+		/**
+		 * @brief Writes one row per bulk ComputeAction outcome to a compact columnar file.
+		 * Rows are buffered and written in chunks with one column after another. Within a chunk, action type bitmaps,
+		 * outcomes and dictionary-encoded label and template IDs are run-length encoded, content identifiers are front
+		 * coded, and metadata patches are stored as per-row entry counts over shared key and value columns. Each column
+		 * is length-prefixed, so a reader can skip the columns it doesn't need. Each chunk is framed by its length and followed
+		 * by a checksum, so a file cut short by a crash still reads up to its last complete chunk. Thread safe.
+		 */
+		class ResultsWriter final {
+		public:
+			explicit ResultsWriter(const std::string& path, const ResultsWriterSettings& settings = ResultsWriterSettings());
+			~ResultsWriter();	// Flushes
+
+			ResultsWriter(const ResultsWriter&) = delete;
+			ResultsWriter& operator=(const ResultsWriter&) = delete;
+
+			void Record(const ExecutionStateOptions& options, const ActionResults& actions, ResultOutcome outcome);
+			void Flush();
+			uint64_t GetRowCount() const;
+			uint64_t GetBytesWritten() const;
+
+		private:
+			uint32_t Intern(const std::string& value);	// 0 for the empty string, otherwise dictionary index + 1
+			void WriteChunk();
+
+			const ResultsWriterSettings mSettings;
+			mutable std::mutex mMutex;
+			std::ofstream mFile;
+			std::unordered_map<std::string, uint32_t> mDictionary;
+			std::vector<const std::string*> mNewEntries;	// Dictionary entries not yet written
+			std::vector<uint32_t> mActions;
+			std::vector<uint32_t> mOutcomes;
+			std::vector<uint32_t> mCurrentLabels;
+			std::vector<uint32_t> mNewLabels;
+			std::vector<uint32_t> mTemplates;
+			std::vector<std::string> mContentIds;
+			std::vector<uint32_t> mPatchCounts;
+			std::vector<uint32_t> mPatchKeys;		// Dictionary reference * 2, plus 1 for a removed key
+			std::vector<std::string> mPatchValues;	// One per key that is set
+			uint64_t mRows = 0;
+			uint64_t mBytesWritten = 0;
+		};
+
+		enum ResultColumn : unsigned {
+			kResultActions = 1 << 0,
+			kResultOutcomes = 1 << 1,
+			kResultCurrentLabels = 1 << 2,
+			kResultNewLabels = 1 << 3,
+			kResultTemplates = 1 << 4,
+			kResultContentIds = 1 << 5,
+			kResultPatchOffsets = 1 << 6,
+			kResultPatchEntries = 1 << 7,	// Keys and values. Needs kResultPatchOffsets to be matched to rows.
+			kResultAllColumns = (1 << 8) - 1
+		};
+
+		// One decoded chunk. Columns not requested are left empty. Label and template columns hold dictionary references.
+		struct ResultChunk {
+			size_t rows = 0;
+			std::vector<uint32_t> actions;			// mip::ActionType bits of every action returned
+			std::vector<uint32_t> outcomes;			// ResultOutcome
+			std::vector<uint32_t> currentLabels;
+			std::vector<uint32_t> newLabels;
+			std::vector<uint32_t> templates;
+			std::vector<std::string> contentIds;
+			std::vector<uint32_t> patchOffsets;		// Row i's entries are [patchOffsets[i], patchOffsets[i + 1])
+			std::vector<uint32_t> patchKeys;
+			std::vector<std::string> patchValues;	// Indexed by entry, empty for removed keys
+		};
+
+		// Reads a file written by ResultsWriter one chunk at a time. Throws std::runtime_error if it is missing or malformed.
+		// A chunk cut short or failing its checksum ends the file instead, and IsTruncated reports it.
+		class ResultsReader final {
+		public:
+			explicit ResultsReader(const std::string& path);
+
+			bool ReadChunk(ResultChunk& chunk, unsigned columns = kResultAllColumns);	// False at the end of the file
+			const std::string& Lookup(uint32_t reference) const;	// Dictionary string for a label, template or key column value
+			bool IsTruncated() const { return mTruncated; }
+
+		private:
+			utils::MappedFile mFile;
+			size_t mPosition;
+			std::vector<std::string> mDictionary;
+			bool mTruncated = false;
+		};
+
+		struct ResultsSummary {
+			uint64_t rows = 0;
+			uint64_t chunks = 0;
+			uint64_t outcomes[3] = {};				// Indexed by ResultOutcome
+			uint64_t withActions = 0;
+			uint64_t metadataEntries = 0;
+			std::map<uint32_t, uint64_t> actionTypes;	// Rows per mip::ActionType bit
+			std::map<std::string, uint64_t> newLabels;
+			std::map<std::string, uint64_t> templates;
+			std::map<std::pair<std::string, std::string>, uint64_t> transitions;	// Rows per (current label, new label) with actions
+			bool truncated = false;					// The file ends with an incomplete chunk, which isn't counted
+		};
+
+		// Aggregates a results file without decoding content identifiers or metadata entries.
+		ResultsSummary SummarizeResults(const std::string& path);
+		void PrintResultsSummary(const ResultsSummary& summary);
+
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_RESULTS_REPORT_H_
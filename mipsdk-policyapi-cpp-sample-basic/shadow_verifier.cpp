@@ -0,0 +1,225 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "shadow_verifier.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "mip/upe/metadata_action.h"
+#include "mip/upe/protect_by_template_action.h"
+
+#include "action_results.h"
+#include "label_metadata.h"
+
+using mip::LogLevel;
+using std::string;
+using std::vector;
+
+namespace {
+	string JoinLines(const vector<string>& lines)
+	{
+		string joined;
+		for (const auto& line : lines)
+		{
+			if (!joined.empty())
+			{
+				joined += "; ";
+			}
+			joined += line;
+		}
+		return joined.empty() ? "(none)" : joined;
+	}
+}
+
+namespace sample {
+	namespace policy {
+
+		ShadowVerifier::ShadowVerifier(ReferenceFunction reference, const ShadowVerifierSettings& settings, std::shared_ptr<utils::AsyncLogSink> log)
+			: mReference(std::move(reference)),
+			mSettings(settings),
+			mLog(std::move(log)),
+			mQueue(settings.queueCapacity)
+		{
+			mWorker = std::thread(&ShadowVerifier::WorkerThread, this);
+		}
+
+		ShadowVerifier::~ShadowVerifier()
+		{
+			mQueue.Close();
+			mWorker.join();
+		}
+
+		// Spreads samples evenly: item n is checked when n * sampleRate crosses a whole number.
+		bool ShadowVerifier::ShouldSample()
+		{
+			if (mSettings.sampleRate <= 0)
+			{
+				return false;
+			}
+			if (mSettings.sampleRate >= 1)
+			{
+				return true;
+			}
+			uint64_t n = mSubmitted.fetch_add(1, std::memory_order_relaxed);
+			return std::floor((n + 1) * mSettings.sampleRate) > std::floor(n * mSettings.sampleRate);
+		}
+
+		void ShadowVerifier::Submit(const ExecutionStateOptions& options, const vector<std::shared_ptr<mip::Action>>& actions)
+		{
+			if (!ShouldSample())
+			{
+				return;
+			}
+
+			mSampled.fetch_add(1, std::memory_order_relaxed);
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				++mPending;
+			}
+			Sample sample{ options, actions };
+			if (!mQueue.TryPush(sample))
+			{
+				mDropped.fetch_add(1, std::memory_order_relaxed);
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (--mPending == 0)
+				{
+					mIdle.notify_all();
+				}
+			}
+		}
+
+		void ShadowVerifier::Flush()
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mIdle.wait(lock, [this]() { return mPending == 0; });
+		}
+
+		void ShadowVerifier::WorkerThread()
+		{
+			Sample sample;
+			while (mQueue.Pop(sample))
+			{
+				Verify(sample);
+				sample = Sample();
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (--mPending == 0)
+				{
+					mIdle.notify_all();
+				}
+			}
+		}
+
+		void ShadowVerifier::Verify(const Sample& sample)
+		{
+			vector<string> referenceActions;
+			try
+			{
+				referenceActions = DescribeActions(mReference(sample.options));
+			}
+			catch (const std::exception& ex)
+			{
+				mErrors.fetch_add(1, std::memory_order_relaxed);
+				mLog->Log(LogLevel::Warning, "Shadow evaluation of %s failed: %s", sample.options.contentIdentifier.c_str(), ex.what());
+				return;
+			}
+
+			auto fastActions = DescribeActions(sample.actions);
+			if (fastActions == referenceActions)
+			{
+				mVerified.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			mMismatches.fetch_add(1, std::memory_order_relaxed);
+			mLog->Log(LogLevel::Warning, "Shadow mismatch for %s: fast path [%s], SDK [%s]", sample.options.contentIdentifier.c_str(),
+				JoinLines(fastActions).c_str(), JoinLines(referenceActions).c_str());
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mMismatchRecords.size() < mSettings.maxRecordedMismatches)
+			{
+				mMismatchRecords.push_back(ShadowMismatch{ sample.options, std::move(fastActions), std::move(referenceActions) });
+			}
+		}
+
+		ShadowVerifierStats ShadowVerifier::GetStats() const
+		{
+			ShadowVerifierStats stats;
+			stats.sampled = mSampled;
+			stats.verified = mVerified;
+			stats.mismatches = mMismatches;
+			stats.dropped = mDropped;
+			stats.errors = mErrors;
+			return stats;
+		}
+
+		vector<ShadowMismatch> ShadowVerifier::GetMismatches() const
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			return vector<ShadowMismatch>(mMismatchRecords.begin(), mMismatchRecords.end());
+		}
+
+		vector<string> ShadowVerifier::DescribeActions(const vector<std::shared_ptr<mip::Action>>& actions)
+		{
+			vector<string> lines;
+			for (const auto& action : actions)
+			{
+				const char* knownName = GetActionTypeName(action->GetType());
+				string name = knownName != nullptr ? knownName : "OTHER";
+				switch (action->GetType())
+				{
+				case mip::ActionType::METADATA: {
+					auto metadataAction = static_cast<const mip::MetadataAction*>(action.get());
+					for (const auto& key : metadataAction->GetMetadataToRemove())
+					{
+						lines.push_back(name + " remove " + key);
+					}
+					for (const auto& entry : metadataAction->GetMetadataToAdd())
+					{
+						lines.push_back(name + " add " + entry.GetKey() + "=" +
+							(IsVolatileLabelMetadataKey(entry.GetKey()) ? string("*") : entry.GetValue()));
+					}
+					break;
+				}
+				case mip::ActionType::PROTECT_BY_TEMPLATE:
+					lines.push_back(name + " " + static_cast<const mip::ProtectByTemplateAction*>(action.get())->GetTemplateId());
+					break;
+				default:
+					if (name == "OTHER")
+					{
+						name += " " + std::to_string(static_cast<unsigned int>(action->GetType()));
+					}
+					lines.push_back(std::move(name));
+				}
+			}
+			std::sort(lines.begin(), lines.end());
+			return lines;
+		}
+
+	} //  namespace policy
+} //  namespace sample
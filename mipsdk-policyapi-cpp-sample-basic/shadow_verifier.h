@@ -0,0 +1,128 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_SHADOW_VERIFIER_H_
+#define SAMPLES_UPE_SHADOW_VERIFIER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mip/upe/action.h"
+
+#include "async_log_sink.h"
+#include "bounded_queue.h"
+#include "execution_state_impl.h"
+
+namespace sample {
+	namespace policy {
+
+		struct ShadowVerifierSettings {
+			double sampleRate = 0;				// Fraction of fast-path answers checked against the SDK. 0 disables, 1 checks every one.
+			size_t queueCapacity = 1024;		// Samples waiting for the reference evaluation. Further samples are dropped.
+			size_t maxRecordedMismatches = 100;	// Mismatches kept for GetMismatches(). All of them are counted and logged.
+		};
+
+		struct ShadowVerifierStats {
+			uint64_t sampled = 0;		// Answers selected for verification
+			uint64_t verified = 0;		// Samples the reference evaluation agreed with
+			uint64_t mismatches = 0;	// Samples the reference evaluation disagreed with
+			uint64_t dropped = 0;		// Samples discarded because the queue was full
+			uint64_t errors = 0;		// Samples the reference evaluation failed on
+		};
+
+		struct ShadowMismatch {
+			ExecutionStateOptions options;				// State the fast path answered
+			std::vector<std::string> fastActions;		// DescribeActions() of the fast-path answer
+			std::vector<std::string> referenceActions;	// DescribeActions() of the SDK's answer
+		};
+
+		/**
+		 * @brief Checks a sample of answers produced without the SDK against the SDK's own evaluation.
+		 * Submit is cheap for unsampled answers and never blocks. Sampled states are evaluated by the reference function
+		 * on a background thread, and its action types and payloads are compared with the fast path's.
+		 */
+		class ShadowVerifier final {
+		public:
+			typedef std::function<std::vector<std::shared_ptr<mip::Action>>(const ExecutionStateOptions&)> ReferenceFunction;
+
+			ShadowVerifier(ReferenceFunction reference, const ShadowVerifierSettings& settings, std::shared_ptr<utils::AsyncLogSink> log);
+			~ShadowVerifier();	// Verifies the samples already queued, then stops.
+
+			ShadowVerifier(const ShadowVerifier&) = delete;
+			ShadowVerifier& operator=(const ShadowVerifier&) = delete;
+
+			void Submit(const ExecutionStateOptions& options, const std::vector<std::shared_ptr<mip::Action>>& actions);
+			void Flush();		// Wait until every sample submitted so far has been checked.
+
+			ShadowVerifierStats GetStats() const;
+			std::vector<ShadowMismatch> GetMismatches() const;
+
+			// One sorted line per action and payload item. Label entries that differ on every evaluation are compared by key only.
+			static std::vector<std::string> DescribeActions(const std::vector<std::shared_ptr<mip::Action>>& actions);
+
+		private:
+			struct Sample {
+				ExecutionStateOptions options;
+				std::vector<std::shared_ptr<mip::Action>> actions;
+			};
+
+			bool ShouldSample();
+			void Verify(const Sample& sample);
+			void WorkerThread();
+
+			const ReferenceFunction mReference;
+			const ShadowVerifierSettings mSettings;
+			std::shared_ptr<utils::AsyncLogSink> mLog;
+			utils::BoundedQueue<Sample> mQueue;
+
+			std::atomic<uint64_t> mSubmitted{ 0 };
+			std::atomic<uint64_t> mSampled{ 0 };
+			std::atomic<uint64_t> mVerified{ 0 };
+			std::atomic<uint64_t> mMismatches{ 0 };
+			std::atomic<uint64_t> mDropped{ 0 };
+			std::atomic<uint64_t> mErrors{ 0 };
+
+			mutable std::mutex mMutex;					// Guards mPending and mMismatchRecords
+			std::condition_variable mIdle;
+			uint64_t mPending = 0;
+			std::deque<ShadowMismatch> mMismatchRecords;
+			std::thread mWorker;
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_SHADOW_VERIFIER_H_
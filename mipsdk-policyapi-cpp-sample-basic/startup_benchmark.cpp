@@ -0,0 +1,122 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "startup_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+using std::string;
+using std::vector;
+
+namespace {
+	const mip::CacheStorageType kStorageTypes[] = {
+		mip::CacheStorageType::InMemory,
+		mip::CacheStorageType::OnDisk,
+		mip::CacheStorageType::OnDiskEncrypted
+	};
+
+	const char* GetStorageTypeName(mip::CacheStorageType storageType)
+	{
+		switch (storageType)
+		{
+		case mip::CacheStorageType::InMemory: return "InMemory";
+		case mip::CacheStorageType::OnDisk: return "OnDisk";
+		case mip::CacheStorageType::OnDiskEncrypted: return "OnDiskEncrypted";
+		default: return "Unknown";
+		}
+	}
+
+	double Median(vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return values.empty() ? 0.0 : values[values.size() / 2];
+	}
+
+	// Time from constructing Action to a usable engine. The Action is destroyed afterwards so its context shuts down.
+	double TimeEngineLoad(
+		const mip::ApplicationInfo& appInfo,
+		const string& username,
+		const string& password,
+		const sample::policy::ActionOptions& options)
+	{
+		auto start = std::chrono::steady_clock::now();
+		sample::policy::Action action(appInfo, username, password, options);
+		action.LoadEngine();
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		return std::chrono::duration<double, std::milli>(elapsed).count();
+	}
+}
+
+namespace sample {
+	namespace policy {
+
+		vector<StartupBenchmarkResult> RunStartupBenchmark(
+			const mip::ApplicationInfo& appInfo,
+			const string& username,
+			const string& password,
+			const ActionOptions& baseOptions,
+			int iterations)
+		{
+			vector<StartupBenchmarkResult> results;
+
+			for (auto storageType : kStorageTypes)
+			{
+				ActionOptions options = baseOptions;
+				options.cacheStorageType = storageType;
+				options.cachePath = baseOptions.cachePath + "_" + GetStorageTypeName(storageType);
+				options.labelSnapshotPath.clear();
+
+				vector<double> cold;
+				vector<double> warm;
+				for (int i = 0; i < iterations; ++i)
+				{
+					std::filesystem::remove_all(options.cachePath);
+					cold.push_back(TimeEngineLoad(appInfo, username, password, options));
+					warm.push_back(TimeEngineLoad(appInfo, username, password, options));
+				}
+
+				results.push_back({ storageType, Median(cold), Median(warm) });
+			}
+
+			return results;
+		}
+
+		void PrintStartupBenchmark(const vector<StartupBenchmarkResult>& results)
+		{
+			printf("%-16s %12s %12s\n", "Storage", "Cold (ms)", "Warm (ms)");
+			for (const auto& result : results)
+			{
+				printf("%-16s %12.1f %12.1f\n", GetStorageTypeName(result.storageType), result.coldMilliseconds, result.warmMilliseconds);
+			}
+		}
+
+	} //  namespace policy
+} //  namespace sample
@@ -0,0 +1,64 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_STARTUP_BENCHMARK_H_
+#define SAMPLES_UPE_STARTUP_BENCHMARK_H_
+
+#include <string>
+#include <vector>
+
+#include "mip/common_types.h"
+#include "action.h"
+
+namespace sample {
+	namespace policy {
+
+		struct StartupBenchmarkResult {
+			mip::CacheStorageType storageType;
+			double coldMilliseconds;	// Median profile and engine load time with an empty cache directory
+			double warmMilliseconds;	// Median load time reusing the cache left by the previous run
+		};
+
+		/**
+		 * @brief Measures profile and engine load time for each cache storage type.
+		 * Each mode uses its own cache directory derived from baseOptions.cachePath, which is deleted before every cold
+		 * run. baseOptions.policyDataXmlPath should point at a local policy so the results don't depend on the service.
+		 */
+		std::vector<StartupBenchmarkResult> RunStartupBenchmark(
+			const mip::ApplicationInfo& appInfo,
+			const std::string& username,
+			const std::string& password,
+			const ActionOptions& baseOptions,
+			int iterations);
+
+		void PrintStartupBenchmark(const std::vector<StartupBenchmarkResult>& results);
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_STARTUP_BENCHMARK_H_
@@ -0,0 +1,297 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "trace_recorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <set>
+#include <utility>
+
+using std::string;
+
+namespace {
+	std::atomic<uint64_t> gNextRecorderId(1);
+
+	// Request the calling thread is serving. 0 when there is none or it isn't sampled.
+	thread_local uint64_t tCurrentRequest = 0;
+	thread_local int tRequestDepth = 0;
+
+	void AppendJsonName(string& output, const char* name)
+	{
+		output += '"';
+		for (const char* c = name; *c != '\0'; ++c)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				output += '\\';
+			}
+			if (static_cast<unsigned char>(*c) >= 0x20)
+			{
+				output += *c;
+			}
+		}
+		output += '"';
+	}
+}
+
+namespace sample {
+	namespace utils {
+
+		TraceRecorder::TraceRecorder(const TraceSettings& settings)
+			: mRecorderId(gNextRecorderId.fetch_add(1)),
+			mStart(std::chrono::steady_clock::now()),
+			mSampleRate(settings.sampleRate),
+			mStore(std::make_shared<Store>(settings))
+		{
+		}
+
+		uint64_t TraceRecorder::SampleRequest()
+		{
+			uint64_t n = mRequests.fetch_add(1, std::memory_order_relaxed);
+			if (mSampleRate <= 0)
+			{
+				return 0;
+			}
+			if (mSampleRate < 1 && std::floor((n + 1) * mSampleRate) <= std::floor(n * mSampleRate))
+			{
+				return 0;
+			}
+			return n + 1;
+		}
+
+		// Called with mutex held. Drops the oldest chunks once more than maxEvents spans are kept.
+		void TraceRecorder::Store::Keep(std::unique_ptr<Chunk> chunk)
+		{
+			keptEvents += chunk->count.load(std::memory_order_relaxed);
+			kept.push_back(std::move(chunk));
+			while (keptEvents > settings.maxEvents && kept.size() > 1)
+			{
+				size_t count = kept.front()->count.load(std::memory_order_relaxed);
+				keptEvents -= count;
+				dropped.fetch_add(count, std::memory_order_relaxed);
+				spare = std::move(kept.front());
+				kept.pop_front();
+			}
+		}
+
+		TraceRecorder::Chunk* TraceRecorder::Store::Rotate(Chunk* full)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = std::find_if(active.begin(), active.end(), [full](const std::unique_ptr<Chunk>& chunk) { return chunk.get() == full; });
+			std::unique_ptr<Chunk> next;
+			if (spare)
+			{
+				next = std::move(spare);
+				next->count.store(0, std::memory_order_relaxed);
+				next->threadIndex = full->threadIndex;
+			}
+			else
+			{
+				next.reset(new Chunk(std::max<size_t>(settings.eventsPerChunk, 1), full->threadIndex));
+			}
+			Keep(std::move(*it));
+			*it = std::move(next);
+			return it->get();
+		}
+
+		void TraceRecorder::Store::Retire(Chunk* chunk)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = std::find_if(active.begin(), active.end(), [chunk](const std::unique_ptr<Chunk>& entry) { return entry.get() == chunk; });
+			std::unique_ptr<Chunk> retired = std::move(*it);
+			active.erase(it);
+			if (retired->count.load(std::memory_order_relaxed) > 0)
+			{
+				Keep(std::move(retired));
+			}
+		}
+
+		TraceRecorder::ThreadChunks::~ThreadChunks()
+		{
+			for (const auto& entry : entries)
+			{
+				if (auto store = entry.store.lock())
+				{
+					store->Retire(entry.chunk);
+				}
+			}
+		}
+
+		TraceRecorder::Chunk*& TraceRecorder::GetThreadChunk()
+		{
+			// A thread usually records into one recorder, so the scan is short.
+			thread_local ThreadChunks chunks;
+			for (auto& entry : chunks.entries)
+			{
+				if (entry.recorderId == mRecorderId)
+				{
+					return entry.chunk;
+				}
+			}
+
+			// Entries of recorders that were destroyed are dropped here.
+			chunks.entries.erase(std::remove_if(chunks.entries.begin(), chunks.entries.end(),
+				[](const ThreadChunks::Entry& entry) { return entry.store.expired(); }), chunks.entries.end());
+
+			Chunk* chunk;
+			{
+				std::lock_guard<std::mutex> lock(mStore->mutex);
+				mStore->active.emplace_back(new Chunk(std::max<size_t>(mStore->settings.eventsPerChunk, 1), mStore->nextThreadIndex++));
+				chunk = mStore->active.back().get();
+			}
+			chunks.entries.push_back(ThreadChunks::Entry{ mRecorderId, chunk, mStore });
+			return chunks.entries.back().chunk;
+		}
+
+		void TraceRecorder::Record(const char* name, uint64_t requestId, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+		{
+			Chunk*& chunk = GetThreadChunk();
+			size_t index = chunk->count.load(std::memory_order_relaxed);
+			if (index >= chunk->events.size())
+			{
+				chunk = mStore->Rotate(chunk);
+				index = 0;
+			}
+
+			Event& event = chunk->events[index];
+			event.name = name;
+			event.requestId = requestId;
+			event.startMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(start - mStart).count();
+			event.durationMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+			chunk->count.store(index + 1, std::memory_order_release);
+		}
+
+		bool TraceRecorder::Export(const string& path) const
+		{
+			string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+			bool first = true;
+			auto separate = [&]() {
+				if (!first)
+				{
+					json += ",\n";
+				}
+				first = false;
+			};
+
+			std::set<uint32_t> namedThreads;
+			auto appendChunk = [&](const Chunk& chunk) {
+				string threadId = std::to_string(chunk.threadIndex);
+				if (namedThreads.insert(chunk.threadIndex).second)
+				{
+					separate();
+					json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + threadId + ",\"args\":{\"name\":\"thread " + threadId + "\"}}";
+				}
+
+				size_t count = chunk.count.load(std::memory_order_acquire);
+				for (size_t i = 0; i < count; ++i)
+				{
+					const Event& event = chunk.events[i];
+					separate();
+					json += "{\"name\":";
+					AppendJsonName(json, event.name);
+					json += ",\"cat\":\"mip\",\"ph\":\"X\",\"pid\":1,\"tid\":" + threadId;
+					json += ",\"ts\":" + std::to_string(event.startMicroseconds);
+					json += ",\"dur\":" + std::to_string(event.durationMicroseconds);
+					if (event.requestId != 0)
+					{
+						json += ",\"args\":{\"request\":" + std::to_string(event.requestId) + "}";
+					}
+					json += '}';
+				}
+			};
+
+			{
+				std::lock_guard<std::mutex> lock(mStore->mutex);
+				for (const auto& chunk : mStore->kept)
+				{
+					appendChunk(*chunk);
+				}
+				for (const auto& chunk : mStore->active)
+				{
+					appendChunk(*chunk);
+				}
+			}
+			json += "]}\n";
+
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			file.write(json.data(), static_cast<std::streamsize>(json.size()));
+			return static_cast<bool>(file);
+		}
+
+		TraceRequest::TraceRequest(TraceRecorder* recorder)
+		{
+			if (recorder == nullptr)
+			{
+				return;
+			}
+			mEntered = true;
+			if (tRequestDepth++ == 0)
+			{
+				tCurrentRequest = recorder->SampleRequest();
+			}
+		}
+
+		TraceRequest::~TraceRequest()
+		{
+			if (mEntered && --tRequestDepth == 0)
+			{
+				tCurrentRequest = 0;
+			}
+		}
+
+		TraceSpan::TraceSpan(TraceRecorder* recorder, const char* name, bool always)
+			: mName(name)
+		{
+			if (recorder != nullptr && (always || tCurrentRequest != 0))
+			{
+				mRecorder = recorder;
+				mRequestId = tCurrentRequest;
+				mStart = std::chrono::steady_clock::now();
+			}
+		}
+
+		TraceSpan::~TraceSpan()
+		{
+			if (mRecorder != nullptr)
+			{
+				mRecorder->Record(mName, mRequestId, mStart, std::chrono::steady_clock::now());
+			}
+		}
+
+		void TraceSpan::RecordSince(TraceRecorder* recorder, const char* name, std::chrono::steady_clock::time_point start)
+		{
+			if (recorder != nullptr && tCurrentRequest != 0)
+			{
+				recorder->Record(name, tCurrentRequest, start, std::chrono::steady_clock::now());
+			}
+		}
+
+	} //  namespace utils
+} //  namespace sample
@@ -0,0 +1,164 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UTILS_TRACE_RECORDER_H_
+#define SAMPLES_UTILS_TRACE_RECORDER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sample {
+	namespace utils {
+
+		struct TraceSettings {
+			double sampleRate = 0.01;			// Fraction of requests traced. Spans marked always are recorded regardless.
+			size_t eventsPerChunk = 1 << 12;	// Spans a thread records before handing them to the recorder
+			size_t maxEvents = 1 << 19;			// Spans kept in handed-over chunks. The oldest are dropped and counted.
+		};
+
+		/**
+		 * @brief Records timed spans into per-thread buffers and exports them as Chrome trace-event JSON.
+		 * Each thread appends to its own chunk, so recording takes no lock. A full chunk is handed to the recorder, which
+		 * keeps the most recent maxEvents spans, and a thread's chunk is handed over when the thread exits. Export can run
+		 * while threads are recording. It sees every kept span completed before it started. The file opens in Perfetto or
+		 * chrome://tracing.
+		 * Span names must be string literals or otherwise outlive the recorder.
+		 */
+		class TraceRecorder final {
+		public:
+			explicit TraceRecorder(const TraceSettings& settings = TraceSettings());
+
+			TraceRecorder(const TraceRecorder&) = delete;
+			TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+			void Record(const char* name, uint64_t requestId, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+			bool Export(const std::string& path) const;	// False if the file can't be written
+			uint64_t GetDroppedCount() const { return mStore->dropped; }	// Oldest spans discarded to stay within maxEvents
+
+			uint64_t SampleRequest();	// ID for a new request, or 0 if it isn't sampled
+
+		private:
+			struct Event {
+				const char* name;
+				uint64_t requestId;
+				int64_t startMicroseconds;
+				int64_t durationMicroseconds;
+			};
+
+			// Written only by the thread filling it. count is published after each event is complete. Once handed over,
+			// a chunk doesn't change until it is dropped and reused.
+			struct Chunk {
+				Chunk(size_t capacity, uint32_t threadIndex) : events(capacity), threadIndex(threadIndex) {}
+				std::vector<Event> events;
+				std::atomic<size_t> count{ 0 };
+				uint32_t threadIndex;
+			};
+
+			// Shared with the threads' chunk caches, so a thread exiting after the recorder is gone can tell.
+			struct Store {
+				explicit Store(const TraceSettings& settings) : settings(settings) {}
+				Chunk* Rotate(Chunk* full);		// Hands over a full chunk and returns the thread's next one
+				void Retire(Chunk* chunk);		// Hands over the chunk of an exiting thread
+				void Keep(std::unique_ptr<Chunk> chunk);
+
+				const TraceSettings settings;
+				std::mutex mutex;								// Guards the members below. Taken once per chunk, and by Export.
+				std::vector<std::unique_ptr<Chunk>> active;		// Being filled, one per thread
+				std::deque<std::unique_ptr<Chunk>> kept;		// Handed over, oldest first
+				size_t keptEvents = 0;
+				std::unique_ptr<Chunk> spare;					// Last dropped chunk, reused by the next rotation
+				uint32_t nextThreadIndex = 1;
+				std::atomic<uint64_t> dropped{ 0 };
+			};
+
+			// Per-thread cache of the chunk being filled for each recorder. Hands the chunks over when the thread exits.
+			struct ThreadChunks {
+				struct Entry {
+					uint64_t recorderId;
+					Chunk* chunk;
+					std::weak_ptr<Store> store;
+				};
+				~ThreadChunks();
+				std::vector<Entry> entries;
+			};
+
+			Chunk*& GetThreadChunk();
+
+			const uint64_t mRecorderId;						// Distinguishes recorders in the per-thread chunk cache
+			const std::chrono::steady_clock::time_point mStart;
+			const double mSampleRate;
+			std::atomic<uint64_t> mRequests{ 0 };
+			const std::shared_ptr<Store> mStore;
+		};
+
+		/**
+		 * @brief Marks the calling thread as serving one request until destroyed, and decides whether it is traced.
+		 * A request started while another is active on the thread joins the outer one.
+		 */
+		class TraceRequest final {
+		public:
+			explicit TraceRequest(TraceRecorder* recorder);
+			~TraceRequest();
+
+			TraceRequest(const TraceRequest&) = delete;
+			TraceRequest& operator=(const TraceRequest&) = delete;
+
+		private:
+			bool mEntered = false;	// Counted in the thread's request depth
+		};
+
+		// Records the time from construction to destruction if the thread's request is sampled, or always if asked to.
+		class TraceSpan final {
+		public:
+			TraceSpan(TraceRecorder* recorder, const char* name, bool always = false);
+			~TraceSpan();
+
+			TraceSpan(const TraceSpan&) = delete;
+			TraceSpan& operator=(const TraceSpan&) = delete;
+
+			// Record a span that started before the current scope, such as time spent waiting in a queue.
+			static void RecordSince(TraceRecorder* recorder, const char* name, std::chrono::steady_clock::time_point start);
+
+		private:
+			TraceRecorder* mRecorder = nullptr;	// Null if the span isn't recorded
+			const char* mName;
+			uint64_t mRequestId = 0;
+			std::chrono::steady_clock::time_point mStart;
+		};
+
+	} //  namespace utils
+} //  namespace sample
+
+#endif //  SAMPLES_UTILS_TRACE_RECORDER_H_
@@ -27,55 +27,257 @@
 
 
 #include "utils.h"
+#include <algorithm>
 #include <fstream>
-#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 #include <sstream>
 
 #if defined(_WIN32) || defined(_WIN64)
-#define POPEN _popen
-#define PCLOSE _pclose
+#include <windows.h>
 #else
-#define POPEN popen
-#define PCLOSE pclose
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
 #endif
 
-using std::function;
 using std::ifstream;
 using std::runtime_error;
 using std::string;
-using std::unique_ptr;
 using std::vector;
 
-template<typename T>
-using custom_unique_ptr = unique_ptr<T, function<void(T*)>>;
-
 static const char kPathSeparatorWindows = '\\';
 static const char kPathSeparatorUnix = '/';
 static const char kExtensionSeparator = '.';
 static const char kPathSeparatorCStringWindows[] = { kPathSeparatorWindows, '\0' };
 static const char kPathSeparatorCStringUnix[] = { kPathSeparatorUnix, '\0' };
 static const char kPathSeparatorsAll[] = { kPathSeparatorWindows, kPathSeparatorUnix, '\0' };
+static const size_t kProcessReadSize = 64 * 1024;
+
+namespace {
+	// Appends up to kProcessReadSize bytes read by readFn to output. Reading into a stack buffer keeps output within the
+	// capacity reserved for it until the process writes more, rather than growing it by a full read each time.
+	template<typename ReadFn>
+	long long ReadInto(string& output, ReadFn readFn) {
+		char buffer[kProcessReadSize];
+		long long count = readFn(buffer, sizeof(buffer));
+		if (count > 0)
+			output.append(buffer, static_cast<size_t>(count));
+		return count;
+	}
+
+#if defined(_WIN32) || defined(_WIN64)
+	// Quotes an argument so CommandLineToArgvW-compatible parsing in the child yields the original string.
+	void AppendQuotedArgument(string& commandLine, const string& arg) {
+		if (!commandLine.empty())
+			commandLine += ' ';
+		if (!arg.empty() && arg.find_first_of(" \t\n\v\"") == string::npos) {
+			commandLine += arg;
+			return;
+		}
+
+		commandLine += '"';
+		size_t backslashes = 0;
+		for (char c : arg) {
+			if (c == '\\') {
+				++backslashes;
+				continue;
+			}
+			if (c == '"')
+				commandLine.append(backslashes * 2 + 1, '\\');
+			else
+				commandLine.append(backslashes, '\\');
+			backslashes = 0;
+			commandLine += c;
+		}
+		commandLine.append(backslashes * 2, '\\');
+		commandLine += '"';
+	}
+#endif
+}
 
 namespace sample {	
 	namespace utils {
-		string Execute(const char* cmd) {
-			char buffer[128];
-			string result = "";
+#if defined(_WIN32) || defined(_WIN64)
+		ProcessResult RunProcess(const vector<string>& args, std::chrono::milliseconds timeout, size_t expectedOutputSize, const CancellationToken* cancellation) {
+			if (args.empty())
+				throw runtime_error("RunProcess requires a program name");
+
+			// A zero timeout waits for the process without a limit.
+			auto deadline = timeout.count() > 0 ? std::chrono::steady_clock::now() + timeout : std::chrono::steady_clock::time_point::max();
+			string commandLine;
+			for (const auto& arg : args)
+				AppendQuotedArgument(commandLine, arg);
+
+			// Both ends start out non-inheritable, so a process spawned concurrently by another thread can't pick up
+			// either of them. Only the write end is made inheritable, and the handle list below passes it to this child alone.
+			HANDLE readPipe = nullptr;
+			HANDLE writePipe = nullptr;
+			if (!CreatePipe(&readPipe, &writePipe, nullptr, static_cast<DWORD>(kProcessReadSize)))
+				throw runtime_error("CreatePipe() failed");
+			SetHandleInformation(writePipe, HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT);
 
-			custom_unique_ptr<FILE> pipe(POPEN(cmd, "r"), [](FILE* f) { PCLOSE(f); });
-			if (nullptr == pipe.get())
-				throw runtime_error("popen() failed");
+			SIZE_T attributeListSize = 0;
+			InitializeProcThreadAttributeList(nullptr, 1, 0, &attributeListSize);
+			std::unique_ptr<char[]> attributeListBuffer(new char[attributeListSize]);
+			auto attributeList = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributeListBuffer.get());
+			bool listReady = InitializeProcThreadAttributeList(attributeList, 1, 0, &attributeListSize) &&
+				UpdateProcThreadAttribute(attributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, &writePipe, sizeof(writePipe), nullptr, nullptr);
 
-			while (!feof(pipe.get())) {
-				if (fgets(buffer, 128, pipe.get()) != NULL)
-					result += buffer;
+			STARTUPINFOEXA startupInfo = {};
+			startupInfo.StartupInfo.cb = sizeof(startupInfo);
+			startupInfo.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+			startupInfo.StartupInfo.hStdOutput = writePipe;
+			startupInfo.lpAttributeList = attributeList;
+
+			PROCESS_INFORMATION processInfo = {};
+			BOOL created = listReady && CreateProcessA(nullptr, &commandLine[0], nullptr, nullptr, TRUE, CREATE_NO_WINDOW | EXTENDED_STARTUPINFO_PRESENT,
+				nullptr, nullptr, &startupInfo.StartupInfo, &processInfo);
+			DeleteProcThreadAttributeList(attributeList);
+			CloseHandle(writePipe);
+			if (!created) {
+				CloseHandle(readPipe);
+				throw runtime_error("CreateProcess() failed for " + args[0]);
 			}
+			CloseHandle(processInfo.hThread);
+
+			ProcessResult result;
+			result.output.reserve(expectedOutputSize);
+			for (;;) {
+				DWORD available = 0;
+				if (!PeekNamedPipe(readPipe, nullptr, 0, nullptr, &available, nullptr))
+					break;	// Pipe closed: the child exited and everything has been read.
 
+				if (available > 0) {
+					ReadInto(result.output, [readPipe](char* buffer, size_t size) -> long long {
+						DWORD read = 0;
+						return ReadFile(readPipe, buffer, static_cast<DWORD>(size), &read, nullptr) ? read : -1;
+					});
+					continue;
+				}
+
+				auto now = std::chrono::steady_clock::now();
+				if (now >= deadline || (cancellation != nullptr && cancellation->IsCancelled())) {
+					TerminateProcess(processInfo.hProcess, 1);
+					result.timedOut = now >= deadline;
+					result.cancelled = !result.timedOut;
+					break;
+				}
+				auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+				WaitForSingleObject(processInfo.hProcess, static_cast<DWORD>(std::min<long long>(remaining, 10)));
+			}
+
+			WaitForSingleObject(processInfo.hProcess, INFINITE);
+			DWORD exitCode = 0;
+			GetExitCodeProcess(processInfo.hProcess, &exitCode);
+			result.exitCode = static_cast<int>(exitCode);
+			CloseHandle(processInfo.hProcess);
+			CloseHandle(readPipe);
+			return result;
+		}
+#else
+		ProcessResult RunProcess(const vector<string>& args, std::chrono::milliseconds timeout, size_t expectedOutputSize, const CancellationToken* cancellation) {
+			if (args.empty())
+				throw runtime_error("RunProcess requires a program name");
+
+			// A zero timeout waits for the process without a limit.
+			auto deadline = timeout.count() > 0 ? std::chrono::steady_clock::now() + timeout : std::chrono::steady_clock::time_point::max();
+			vector<char*> argv;
+			argv.reserve(args.size() + 1);
+			for (const auto& arg : args)
+				argv.push_back(const_cast<char*>(arg.c_str()));
+			argv.push_back(nullptr);
+
+			// Both ends are close-on-exec from the start, so a child spawned concurrently by another thread inherits neither
+			// and can't hold the write end open. dup2 onto the child's stdout clears the flag for that copy only.
+			int pipeFds[2];
+#if defined(__APPLE__)
+			if (pipe(pipeFds) != 0)
+				throw runtime_error("pipe() failed");
+			fcntl(pipeFds[0], F_SETFD, FD_CLOEXEC);
+			fcntl(pipeFds[1], F_SETFD, FD_CLOEXEC);
+#else
+			if (pipe2(pipeFds, O_CLOEXEC) != 0)
+				throw runtime_error("pipe2() failed");
+#endif
+
+			posix_spawn_file_actions_t fileActions;
+			posix_spawn_file_actions_init(&fileActions);
+			posix_spawn_file_actions_adddup2(&fileActions, pipeFds[1], STDOUT_FILENO);
+			posix_spawn_file_actions_addclose(&fileActions, pipeFds[1]);
+
+			pid_t pid = 0;
+			int spawnError = posix_spawnp(&pid, argv[0], &fileActions, nullptr, argv.data(), environ);
+			posix_spawn_file_actions_destroy(&fileActions);
+			close(pipeFds[1]);
+			if (spawnError != 0) {
+				close(pipeFds[0]);
+				throw runtime_error("posix_spawnp() failed for " + args[0]);
+			}
+
+			ProcessResult result;
+			result.output.reserve(expectedOutputSize);
+			int readFd = pipeFds[0];
+			for (;;) {
+				auto now = std::chrono::steady_clock::now();
+				if (now >= deadline || (cancellation != nullptr && cancellation->IsCancelled())) {
+					kill(pid, SIGKILL);
+					result.timedOut = now >= deadline;
+					result.cancelled = !result.timedOut;
+					break;
+				}
+
+				struct pollfd pollFd = { readFd, POLLIN, 0 };
+				auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+				long long pollLimit = cancellation != nullptr ? kCancellationPollInterval.count() : 1000;
+				int ready = poll(&pollFd, 1, static_cast<int>(std::min<long long>(remaining + 1, pollLimit)));
+				if (ready < 0 && errno != EINTR)
+					break;
+				if (ready <= 0)
+					continue;
+
+				long long count = ReadInto(result.output, [readFd](char* buffer, size_t size) -> long long {
+					return read(readFd, buffer, size);
+				});
+				if (count == 0 || (count < 0 && errno != EINTR))
+					break;	// End of stream: the child closed stdout.
+			}
+			close(readFd);
+
+			// The child may close stdout before it exits, so the deadline still applies while reaping it.
+			int status = 0;
+			for (;;) {
+				pid_t waited = waitpid(pid, &status, result.timedOut || result.cancelled ? 0 : WNOHANG);
+				if (waited == pid || (waited < 0 && errno != EINTR))
+					break;
+				if (waited == 0) {
+					if (std::chrono::steady_clock::now() >= deadline) {
+						kill(pid, SIGKILL);
+						result.timedOut = true;
+					}
+					else if (cancellation != nullptr && cancellation->IsCancelled()) {
+						kill(pid, SIGKILL);
+						result.cancelled = true;
+					}
+					else {
+						usleep(1000);
+					}
+				}
+			}
+			if (WIFEXITED(status))
+				result.exitCode = WEXITSTATUS(status);
+			else if (WIFSIGNALED(status))
+				result.exitCode = 128 + WTERMSIG(status);
 			return result;
 		}
+#endif
 
 		vector<string> SplitString(const string& str, char delim) {
 			vector<string> output;
@@ -26,12 +26,25 @@
 */
 
 
+#include <chrono>
 #include <string>
 #include <vector>
 
+#include "cancellation.h"
+
 namespace sample {
 	namespace utils {
-		std::string Execute(const char* cmd);
+		struct ProcessResult {
+			int exitCode = -1;			// Process exit code, or 128 + signal number if the process was killed by a signal
+			bool timedOut = false;		// Set if the deadline passed and the process was killed
+			bool cancelled = false;		// Set if the cancellation token fired and the process was killed
+			std::string output;			// Everything the process wrote to stdout
+		};
+
+		// Runs args[0] (searched on PATH) without a shell and captures stdout. The process is killed if it hasn't exited within timeout,
+		// or soon after cancellation fires. A zero timeout means no limit.
+		ProcessResult RunProcess(const std::vector<std::string>& args, std::chrono::milliseconds timeout, size_t expectedOutputSize = 4096,
+			const CancellationToken* cancellation = nullptr);
 		bool FileExists(const char* path);
 		std::vector<std::string> SplitString(const std::string& str, char delim);
 		std::string GetFileName(const std::string& filePath);
@@ -0,0 +1,82 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "worker_pool.h"
+
+#include <algorithm>
+
+namespace sample {
+	namespace utils {
+
+		WorkerPool::WorkerPool(unsigned int threadCount, size_t queueCapacity)
+			: mTasks(queueCapacity)
+		{
+			if (threadCount == 0)
+			{
+				threadCount = std::max(1u, std::thread::hardware_concurrency());
+			}
+			mThreads.reserve(threadCount);
+			for (unsigned int i = 0; i < threadCount; ++i)
+			{
+				mThreads.emplace_back(&WorkerPool::Run, this);
+			}
+		}
+
+		WorkerPool::~WorkerPool()
+		{
+			mTasks.Close();
+			for (auto& thread : mThreads)
+			{
+				thread.join();
+			}
+		}
+
+		bool WorkerPool::TrySubmit(std::function<void()>& task)
+		{
+			return mTasks.TryPush(task);
+		}
+
+		// Tasks report their own failures; an exception escaping one would otherwise end the process.
+		void WorkerPool::Run()
+		{
+			std::function<void()> task;
+			while (mTasks.Pop(task))
+			{
+				try
+				{
+					task();
+				}
+				catch (...)
+				{
+				}
+				task = nullptr;
+			}
+		}
+
+	} //  namespace utils
+} //  namespace sample
@@ -0,0 +1,69 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UTILS_WORKER_POOL_H_
+#define SAMPLES_UTILS_WORKER_POOL_H_
+
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+
+namespace sample {
+	namespace utils {
+
+		/**
+		 * @brief Fixed set of threads running queued tasks.
+		 * Threads are started once, so work that fans out per request doesn't create threads per request.
+		 * Tasks still queued when the pool is destroyed run before its threads exit.
+		 */
+		class WorkerPool final {
+		public:
+			WorkerPool(unsigned int threadCount, size_t queueCapacity);	// Zero threadCount uses one thread per core
+			~WorkerPool();
+
+			WorkerPool(const WorkerPool&) = delete;
+			WorkerPool& operator=(const WorkerPool&) = delete;
+
+			// Fails if the queue is full, leaving task unchanged.
+			bool TrySubmit(std::function<void()>& task);
+			unsigned int GetThreadCount() const { return static_cast<unsigned int>(mThreads.size()); }
+
+		private:
+			void Run();
+
+			BoundedQueue<std::function<void()>> mTasks;
+			std::vector<std::thread> mThreads;
+		};
+
+	} //  namespace utils
+} //  namespace sample
+
+#endif //  SAMPLES_UTILS_WORKER_POOL_H_
@@ -0,0 +1,287 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "workload_recorder.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+#include "content_hash.h"
+#include "mapped_file.h"
+#include "utils.h"
+
+using std::string;
+
+namespace {
+	const char kMagic[8] = { 'M', 'I', 'P', 'W', 'K', 'L', 'D', '1' };
+	const uint8_t kFlagDowngradeJustified = 1;
+	const uint8_t kFlagGenerateAuditEvent = 2;
+
+	void AppendVarint(string& output, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			output += static_cast<char>((value & 0x7F) | 0x80);
+			value >>= 7;
+		}
+		output += static_cast<char>(value);
+	}
+
+	class WorkloadParser {
+	public:
+		WorkloadParser(const char* data, size_t size) : mData(data), mSize(size) {}
+
+		bool AtEnd() const { return mPosition == mSize; }
+
+		uint8_t ReadByte()
+		{
+			if (mPosition >= mSize)
+			{
+				Fail();
+			}
+			return static_cast<uint8_t>(mData[mPosition++]);
+		}
+
+		uint64_t ReadVarint()
+		{
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				uint8_t byte = ReadByte();
+				value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0)
+				{
+					return value;
+				}
+			}
+			Fail();
+			return 0;
+		}
+
+		string ReadString()
+		{
+			uint64_t length = ReadVarint();
+			if (length > mSize - mPosition)
+			{
+				Fail();
+			}
+			string value(mData + mPosition, static_cast<size_t>(length));
+			mPosition += static_cast<size_t>(length);
+			return value;
+		}
+
+		// 0 is the empty string, n + 1 refers to entry n, and one past the end defines a new entry.
+		const string& ReadDictionaryString()
+		{
+			static const string kEmpty;
+			uint64_t reference = ReadVarint();
+			if (reference == 0)
+			{
+				return kEmpty;
+			}
+			if (reference == mDictionary.size() + 1)
+			{
+				mDictionary.push_back(ReadString());
+			}
+			if (reference > mDictionary.size())
+			{
+				Fail();
+			}
+			return mDictionary[static_cast<size_t>(reference - 1)];
+		}
+
+		[[noreturn]] void Fail() const
+		{
+			throw std::runtime_error("Workload file is truncated or corrupt at byte " + std::to_string(mPosition));
+		}
+
+	private:
+		const char* mData;
+		size_t mSize;
+		size_t mPosition = sizeof(kMagic);
+		std::vector<string> mDictionary;
+	};
+}
+
+namespace sample {
+	namespace policy {
+
+		WorkloadRecorder::WorkloadRecorder(const string& path, const WorkloadRecorderSettings& settings)
+			: mSettings(settings),
+			mSalt((static_cast<uint64_t>(std::random_device{}()) << 32) | std::random_device{}()),
+			mFile(path, std::ios::binary | std::ios::trunc),
+			mLastRecord(std::chrono::steady_clock::now())
+		{
+			if (!mFile)
+			{
+				throw std::runtime_error("Unable to create workload file " + path);
+			}
+			mBuffer.reserve(mSettings.bufferSize + 4096);
+			mBuffer.append(kMagic, sizeof(kMagic));
+		}
+
+		WorkloadRecorder::~WorkloadRecorder()
+		{
+			Flush();
+		}
+
+		void WorkloadRecorder::WriteString(const string& value)
+		{
+			AppendVarint(mBuffer, value.size());
+			mBuffer += value;
+		}
+
+		void WorkloadRecorder::WriteDictionaryString(const string& value)
+		{
+			if (value.empty())
+			{
+				AppendVarint(mBuffer, 0);
+				return;
+			}
+			auto result = mDictionary.emplace(value, static_cast<uint32_t>(mDictionary.size()));
+			AppendVarint(mBuffer, static_cast<uint64_t>(result.first->second) + 1);
+			if (result.second)
+			{
+				WriteString(value);
+			}
+		}
+
+		void WorkloadRecorder::Record(const ExecutionStateOptions& options, WorkloadCall call)
+		{
+			string contentId;
+			if (mSettings.anonymizeContentIds && !options.contentIdentifier.empty())
+			{
+				char hashed[24];
+				std::snprintf(hashed, sizeof(hashed), "item-%016" PRIx64,
+					utils::HashContent(options.contentIdentifier.data(), options.contentIdentifier.size(), mSalt));
+				contentId = hashed + utils::GetFileExtension(options.contentIdentifier);
+			}
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			auto now = std::chrono::steady_clock::now();
+			mBuffer += static_cast<char>(call);
+			AppendVarint(mBuffer, std::chrono::duration_cast<std::chrono::microseconds>(now - mLastRecord).count());
+			mLastRecord = now;
+
+			WriteDictionaryString(options.newLabel ? options.newLabel->GetId() : string());
+			WriteString(mSettings.anonymizeContentIds ? contentId : options.contentIdentifier);
+			WriteDictionaryString(options.contentFormat);
+			WriteDictionaryString(options.templateId);
+			mBuffer += static_cast<char>(options.actionSource);
+			mBuffer += static_cast<char>(options.dataState);
+			mBuffer += static_cast<char>(options.assignmentMethod);
+			mBuffer += static_cast<char>((options.isDowngradeJustified ? kFlagDowngradeJustified : 0) |
+				(options.generateAuditEvent ? kFlagGenerateAuditEvent : 0));
+			AppendVarint(mBuffer, static_cast<uint64_t>(options.supportedActions));
+			AppendVarint(mBuffer, options.metadata.size());
+			for (const auto& entry : options.metadata)
+			{
+				WriteDictionaryString(entry.first);
+				WriteString(entry.second);
+			}
+			++mRecords;
+
+			if (mBuffer.size() >= mSettings.bufferSize)
+			{
+				WriteBuffer();
+			}
+		}
+
+		void WorkloadRecorder::WriteBuffer()
+		{
+			mFile.write(mBuffer.data(), static_cast<std::streamsize>(mBuffer.size()));
+			mBuffer.clear();
+		}
+
+		void WorkloadRecorder::Flush()
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			WriteBuffer();
+			mFile.flush();
+		}
+
+		uint64_t WorkloadRecorder::GetRecordCount() const
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			return mRecords;
+		}
+
+		std::vector<WorkloadItem> ReadWorkload(const string& path)
+		{
+			if (!utils::FileExists(path.c_str()))
+			{
+				throw std::runtime_error("Workload file " + path + " not found");
+			}
+			utils::MappedFile file(path);
+			if (file.GetSize() < sizeof(kMagic) || std::memcmp(file.GetData(), kMagic, sizeof(kMagic)) != 0)
+			{
+				throw std::runtime_error(path + " is not a workload file");
+			}
+
+			WorkloadParser parser(file.GetData(), file.GetSize());
+			std::vector<WorkloadItem> items;
+			std::chrono::microseconds offset(0);
+			while (!parser.AtEnd())
+			{
+				WorkloadItem item;
+				uint8_t call = parser.ReadByte();
+				if (call > static_cast<uint8_t>(WorkloadCall::ComputeActionLoop))
+				{
+					parser.Fail();
+				}
+				item.call = static_cast<WorkloadCall>(call);
+				offset += std::chrono::microseconds(parser.ReadVarint());
+				item.offset = offset;
+
+				item.labelId = parser.ReadDictionaryString();
+				item.options.contentIdentifier = parser.ReadString();
+				item.options.contentFormat = parser.ReadDictionaryString();
+				item.options.templateId = parser.ReadDictionaryString();
+				item.options.actionSource = static_cast<mip::ActionSource>(parser.ReadByte());
+				item.options.dataState = static_cast<mip::DataState>(parser.ReadByte());
+				item.options.assignmentMethod = static_cast<mip::AssignmentMethod>(parser.ReadByte());
+				uint8_t flags = parser.ReadByte();
+				item.options.isDowngradeJustified = (flags & kFlagDowngradeJustified) != 0;
+				item.options.generateAuditEvent = (flags & kFlagGenerateAuditEvent) != 0;
+				item.options.supportedActions = static_cast<mip::ActionType>(parser.ReadVarint());
+				uint64_t metadataCount = parser.ReadVarint();
+				for (uint64_t i = 0; i < metadataCount; ++i)
+				{
+					const string& key = parser.ReadDictionaryString();
+					item.options.metadata[key] = parser.ReadString();
+				}
+				items.push_back(std::move(item));
+			}
+			return items;
+		}
+
+	} //  namespace policy
+} //  namespace sample
@@ -0,0 +1,102 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_WORKLOAD_RECORDER_H_
+#define SAMPLES_UPE_WORKLOAD_RECORDER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "execution_state_impl.h"
+
+namespace sample {
+	namespace policy {
+
+		enum class WorkloadCall : uint8_t {
+			ComputeAction = 0,
+			ComputeActionLoop = 1
+		};
+
+		// One recorded request. The label is kept by ID and resolved against the replaying engine.
+		struct WorkloadItem {
+			WorkloadCall call = WorkloadCall::ComputeAction;
+			std::chrono::microseconds offset{ 0 };	// Time since the recording started
+			std::string labelId;
+			ExecutionStateOptions options;			// newLabel, content and classifier are not recorded
+		};
+
+		struct WorkloadRecorderSettings {
+			bool anonymizeContentIds = true;	// Replace content IDs with a salted hash, keeping the extension
+			size_t bufferSize = 64 * 1024;		// Bytes collected before they are written to the file
+		};
+
+		/**
+		 * @brief Appends the execution states passed to Action to a compact binary file for later replay.
+		 * Records hold the time since the previous record, and label IDs, metadata keys, formats and template IDs are
+		 * written once and then referred to by index. Justification text is not recorded, only whether one was given.
+		 * Thread safe.
+		 */
+		class WorkloadRecorder final {
+		public:
+			explicit WorkloadRecorder(const std::string& path, const WorkloadRecorderSettings& settings = WorkloadRecorderSettings());
+			~WorkloadRecorder();	// Flushes
+
+			WorkloadRecorder(const WorkloadRecorder&) = delete;
+			WorkloadRecorder& operator=(const WorkloadRecorder&) = delete;
+
+			void Record(const ExecutionStateOptions& options, WorkloadCall call);
+			void Flush();
+			uint64_t GetRecordCount() const;
+
+		private:
+			void WriteString(const std::string& value);
+			void WriteDictionaryString(const std::string& value);
+			void WriteBuffer();
+
+			const WorkloadRecorderSettings mSettings;
+			const uint64_t mSalt;
+			mutable std::mutex mMutex;
+			std::ofstream mFile;
+			std::string mBuffer;
+			std::unordered_map<std::string, uint32_t> mDictionary;
+			std::chrono::steady_clock::time_point mLastRecord;
+			uint64_t mRecords = 0;
+		};
+
+		// Reads a file written by WorkloadRecorder. Throws std::runtime_error if it is missing or malformed.
+		std::vector<WorkloadItem> ReadWorkload(const std::string& path);
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_WORKLOAD_RECORDER_H_
@@ -0,0 +1,206 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include "workload_replayer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "bounded_queue.h"
+
+using mip::LogLevel;
+using std::string;
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+
+	struct ScheduledRequest {
+		size_t index = 0;
+		Clock::time_point due;
+	};
+
+	double Percentile(const std::vector<double>& sorted, double fraction)
+	{
+		if (sorted.empty())
+		{
+			return 0;
+		}
+		size_t rank = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+		return sorted[std::min(rank, sorted.size() - 1)];
+	}
+}
+
+namespace sample {
+	namespace policy {
+
+		WorkloadReplayer::WorkloadReplayer(Action& action, const WorkloadReplaySettings& settings)
+			: mAction(action),
+			mSettings(settings)
+		{
+		}
+
+		WorkloadReplayStats WorkloadReplayer::Run(const std::vector<WorkloadItem>& items)
+		{
+			WorkloadReplayStats stats;
+			if (items.empty())
+			{
+				return stats;
+			}
+
+			// Resolve labels up front so lookups aren't part of the measured latency.
+			// A request for a label missing from this policy would replay as a label removal, so it fails without being sent.
+			std::unordered_map<string, std::shared_ptr<mip::Label>> labels;
+			for (const auto& item : items)
+			{
+				if (!item.labelId.empty() && labels.find(item.labelId) == labels.end())
+				{
+					auto label = mAction.GetLabelById(item.labelId);
+					if (!label)
+					{
+						mAction.GetLogSink()->Log(LogLevel::Warning, "Label %s isn't in the policy. Its requests are counted as failures.", item.labelId.c_str());
+					}
+					labels.emplace(item.labelId, label);
+				}
+			}
+
+			// Each request's due time relative to the start of the replay.
+			std::vector<Clock::duration> schedule(items.size());
+			for (size_t i = 0; i < items.size(); ++i)
+			{
+				double seconds = mSettings.pacing == ReplayPacing::FixedRate
+					? i / std::max(mSettings.arrivalRate, 1e-6)
+					: std::chrono::duration<double>(items[i].offset - items.front().offset).count() / std::max(mSettings.speed, 1e-6);
+				schedule[i] = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+			}
+
+			unsigned int threadCount = mSettings.threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : mSettings.threads;
+			utils::BoundedQueue<ScheduledRequest> queue(items.size());
+			std::atomic<uint64_t> failures(0);
+			std::mutex resultsMutex;
+			std::vector<double> latencies;
+			std::vector<double> serviceTimes;
+			latencies.reserve(items.size());
+			serviceTimes.reserve(items.size());
+
+			std::vector<std::thread> workers;
+			for (unsigned int t = 0; t < threadCount; ++t)
+			{
+				workers.emplace_back([&]() {
+					std::vector<double> localLatencies;
+					std::vector<double> localServiceTimes;
+					ScheduledRequest request;
+					while (queue.Pop(request))
+					{
+						const auto& item = items[request.index];
+						ExecutionStateOptions options = item.options;
+						if (!item.labelId.empty())
+						{
+							options.newLabel = labels.find(item.labelId)->second;
+							if (!options.newLabel)
+							{
+								failures.fetch_add(1, std::memory_order_relaxed);
+								continue;
+							}
+						}
+						if (options.isDowngradeJustified)
+						{
+							options.downgradeJustification = "Replayed justification";
+						}
+						if (!mSettings.sendAuditEvents)
+						{
+							options.generateAuditEvent = false;
+						}
+
+						auto started = Clock::now();
+						try
+						{
+							if (item.call == WorkloadCall::ComputeActionLoop)
+							{
+								mAction.ComputeActionLoop(options);
+							}
+							else
+							{
+								mAction.ComputeAction(options);
+							}
+						}
+						catch (const std::exception& ex)
+						{
+							failures.fetch_add(1, std::memory_order_relaxed);
+							mAction.GetLogSink()->Log(LogLevel::Warning, "Replay of %s failed: %s", item.options.contentIdentifier.c_str(), ex.what());
+						}
+						auto finished = Clock::now();
+						localLatencies.push_back(std::chrono::duration<double, std::milli>(finished - request.due).count());
+						localServiceTimes.push_back(std::chrono::duration<double, std::milli>(finished - started).count());
+					}
+
+					std::lock_guard<std::mutex> lock(resultsMutex);
+					latencies.insert(latencies.end(), localLatencies.begin(), localLatencies.end());
+					serviceTimes.insert(serviceTimes.end(), localServiceTimes.begin(), localServiceTimes.end());
+				});
+			}
+
+			// The dispatcher never waits for a worker, so a slow evaluation can't delay the arrival of the next request.
+			auto start = Clock::now();
+			for (size_t i = 0; i < items.size(); ++i)
+			{
+				auto due = start + schedule[i];
+				std::this_thread::sleep_until(due);
+				queue.Push(ScheduledRequest{ i, due });
+			}
+			queue.Close();
+			for (auto& worker : workers)
+			{
+				worker.join();
+			}
+
+			stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			stats.requests = items.size();
+			stats.failures = failures;
+			double scheduledSeconds = std::chrono::duration<double>(schedule.back()).count();
+			stats.offeredRate = scheduledSeconds > 0 ? (items.size() - 1) / scheduledSeconds : 0;
+			stats.achievedRate = stats.seconds > 0 ? items.size() / stats.seconds : 0;
+
+			std::sort(latencies.begin(), latencies.end());
+			std::sort(serviceTimes.begin(), serviceTimes.end());
+			stats.p50Ms = Percentile(latencies, 0.5);
+			stats.p90Ms = Percentile(latencies, 0.9);
+			stats.p99Ms = Percentile(latencies, 0.99);
+			stats.p999Ms = Percentile(latencies, 0.999);
+			stats.maxMs = latencies.empty() ? 0 : latencies.back();
+			stats.serviceP99Ms = Percentile(serviceTimes, 0.99);
+			return stats;
+		}
+
+	} //  namespace policy
+} //  namespace sample
@@ -0,0 +1,90 @@
+/**
+ *
+ * Copyright (c) Microsoft Corporation.
+ * All rights reserved.
+ *
+ * This code is licensed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files(the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions :
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SAMPLES_UPE_WORKLOAD_REPLAYER_H_
+#define SAMPLES_UPE_WORKLOAD_REPLAYER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "action.h"
+#include "workload_recorder.h"
+
+namespace sample {
+	namespace policy {
+
+		enum class ReplayPacing {
+			Recorded,	// Requests arrive at their recorded times, divided by speed
+			FixedRate	// Requests arrive at arrivalRate per second, whatever the recording did
+		};
+
+		struct WorkloadReplaySettings {
+			ReplayPacing pacing = ReplayPacing::Recorded;
+			double speed = 1.0;				// With Recorded pacing, 2 replays twice as fast as recorded
+			double arrivalRate = 100;		// Requests per second with FixedRate pacing
+			unsigned int threads = 0;		// Concurrent evaluations. Zero uses one per hardware thread.
+			bool sendAuditEvents = false;	// Off: replayed requests aren't real label changes, so recorded audit requests are cleared
+		};
+
+		struct WorkloadReplayStats {
+			uint64_t requests = 0;
+			uint64_t failures = 0;		// Includes requests for labels missing from the policy, which aren't sent
+			double seconds = 0;
+			double offeredRate = 0;		// Requests per second the schedule asked for
+			double achievedRate = 0;	// Requests per second completed
+			// Latency from when each request was due to arrive until it completed, so time spent waiting behind
+			// slow requests is counted (corrected for coordinated omission).
+			double p50Ms = 0;
+			double p90Ms = 0;
+			double p99Ms = 0;
+			double p999Ms = 0;
+			double maxMs = 0;
+			double serviceP99Ms = 0;	// 99th percentile of the evaluation alone, which hides queueing
+		};
+
+		/**
+		 * @brief Drives recorded execution states against an Action open loop.
+		 * A dispatcher releases each request at its scheduled time whether or not earlier ones have finished, and a
+		 * pool of workers evaluates them. Latency is measured from the scheduled time, so a stall shows up in every
+		 * request that should have arrived during it.
+		 */
+		class WorkloadReplayer final {
+		public:
+			WorkloadReplayer(Action& action, const WorkloadReplaySettings& settings = WorkloadReplaySettings());
+
+			WorkloadReplayStats Run(const std::vector<WorkloadItem>& items);
+
+		private:
+			Action& mAction;
+			const WorkloadReplaySettings mSettings;
+		};
+
+	} //  namespace policy
+} //  namespace sample
+
+#endif //  SAMPLES_UPE_WORKLOAD_REPLAYER_H_